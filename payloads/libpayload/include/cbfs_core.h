@@ -60,6 +60,7 @@
 #define CBFS_COMPRESS_NONE  0
 #define CBFS_COMPRESS_LZMA  1
 #define CBFS_COMPRESS_LZ4   2
+#define CBFS_COMPRESS_ZSTD  3
 
 /** These are standard component types for well known
     components (i.e - those that coreboot needs to consume.
@@ -252,8 +253,9 @@ struct cbfs_media {
 void *cbfs_get_file_content(struct cbfs_media *media, const char *name,
 			    int type, size_t *sz);
 
-/* returns decompressed size on success, 0 on failure */
-int cbfs_decompress(int algo, void *src, void *dst, int len);
+/* Decompresses srcn bytes from src into at most dstn bytes at dst.
+ * returns decompressed size on success, 0 on failure */
+int cbfs_decompress(int algo, void *src, size_t srcn, void *dst, size_t dstn);
 
 /* returns a pointer to CBFS master header, or CBFS_HEADER_INVALID_ADDRESS
  *  on failure */
@@ -39,6 +39,10 @@
 #  include <lz4.h>
 #  define CBFS_CORE_WITH_LZ4
 # endif
+# if IS_ENABLED(CONFIG_LP_ZSTD)
+#  include <zstd.h>
+#  define CBFS_CORE_WITH_ZSTD
+# endif
 # define CBFS_MINI_BUILD
 #elif defined(__SMM__)
 # define CBFS_MINI_BUILD
@@ -114,8 +118,9 @@ void * cbfs_load_stage(struct cbfs_media *media, const char *name)
 	final_size = cbfs_decompress(stage->compression,
 				     ((unsigned char *) stage) +
 				     sizeof(struct cbfs_stage),
+				     stage->len,
 				     (void *) (uintptr_t) stage->load,
-				     stage->len);
+				     stage->memlen);
 	if (!final_size) {
 		entry = -1;
 		goto out;
@@ -32,10 +32,13 @@
  * target environment:
  *
  * CBFS_CORE_WITH_LZMA (must be #define)
- *      if defined, ulzma() must exist for decompression of data streams
+ *      if defined, ulzman() must exist for decompression of data streams
  *
  * CBFS_CORE_WITH_LZ4 (must be #define)
- *      if defined, ulz4f() must exist for decompression of data streams
+ *      if defined, ulz4fn() must exist for decompression of data streams
+ *
+ * CBFS_CORE_WITH_ZSTD (must be #define)
+ *      if defined, uzstdn() must exist for decompression of data streams
  *
  * ERROR(x...)
  *      print an error message x (in printf format)
@@ -256,7 +259,8 @@ void *cbfs_get_contents(struct cbfs_handle *handle, size_t *size, size_t limit)
 		return NULL;
 
 	ret = malloc(*size);
-	if (ret != NULL && !cbfs_decompress(algo, data, ret, *size)) {
+	if (ret != NULL &&
+	    !cbfs_decompress(algo, data, on_media_size, ret, *size)) {
 		free(ret);
 		ret = NULL;
 	}
@@ -321,23 +325,29 @@ void *cbfs_get_attr(struct cbfs_handle *handle, uint32_t tag)
 	return NULL;
 }
 
-int cbfs_decompress(int algo, void *src, void *dst, int len)
+int cbfs_decompress(int algo, void *src, size_t srcn, void *dst, size_t dstn)
 {
 	switch (algo) {
 		case CBFS_COMPRESS_NONE:
-			memcpy(dst, src, len);
-			return len;
+			if (srcn > dstn)
+				return 0;
+			memcpy(dst, src, srcn);
+			return srcn;
 #ifdef CBFS_CORE_WITH_LZMA
 		case CBFS_COMPRESS_LZMA:
-			return ulzma(src, dst);
+			return ulzman(src, srcn, dst, dstn);
 #endif
 #ifdef CBFS_CORE_WITH_LZ4
 		case CBFS_COMPRESS_LZ4:
-			return ulz4f(src, dst);
+			return ulz4fn(src, srcn, dst, dstn);
+#endif
+#ifdef CBFS_CORE_WITH_ZSTD
+		case CBFS_COMPRESS_ZSTD:
+			return uzstdn(src, srcn, dst, dstn);
 #endif
 		default:
-			ERROR("tried to decompress %d bytes with algorithm #%x,"
-			      "but that algorithm id is unsupported.\n", len,
+			ERROR("tried to decompress %zu bytes with algorithm #%x,"
+			      "but that algorithm id is unsupported.\n", srcn,
 			      algo);
 			return 0;
 	}
@@ -0,0 +1,261 @@
+/*
+ * Host side benchmark and stress test for libpayload's malloc(). The
+ * allocator is built straight from ../libc/malloc.c with its functions
+ * renamed, so it runs next to the host's own malloc() on a buffer from it.
+ */
+
+/* system headers */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* libpayload headers */
+#include <kconfig.h>
+
+/* Just enough of <libpayload.h> for malloc.c. */
+#define _LIBPAYLOAD_H
+#define ALIGN_UP(x,a)		(((x) + ((typeof(x))(a) - 1)) & ~((typeof(x))(a) - 1))
+#define ALIGN_DOWN(x,a)		((x) & ~((typeof(x))(a) - 1))
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef int32_t s32;
+#define log2			lp_log2
+static inline int log2(u32 x) { return 31 - __builtin_clz(x); }
+static inline int __ffs(u32 x) { return __builtin_ctz(x); }
+
+#define init_dma_memory		lp_init_dma_memory
+#define dma_initialized		lp_dma_initialized
+#define dma_coherent		lp_dma_coherent
+#define free			lp_free
+#define malloc			lp_malloc
+#define dma_malloc		lp_dma_malloc
+#define calloc			lp_calloc
+#define realloc			lp_realloc
+#define memalign		lp_memalign
+#define dma_memalign		lp_dma_memalign
+#define print_malloc_map	lp_print_malloc_map
+
+int dma_initialized(void);
+void *malloc(size_t size);
+char _heap, _eheap;
+
+#include "../libc/malloc.c"
+
+#undef free
+#undef malloc
+#undef realloc
+
+#define HEAP_SIZE	(64 << 20)
+#define DMA_SIZE	(4 << 20)
+#define MAX_LIVE	65536
+
+struct slot {
+	unsigned char *ptr;
+	size_t size;
+	int dma;
+};
+
+static struct slot slots[MAX_LIVE];
+static unsigned int seed = 1;
+
+static int fail(const char *str)
+{
+	fprintf(stderr, "%s", str);
+	exit(1);
+}
+
+static unsigned int rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+/* Mostly small objects, like USB transfer descriptors, some buffers. */
+static size_t random_size(void)
+{
+	switch (rnd() % 16) {
+	case 0:
+		return rnd() % (256 * 1024);
+	case 1: case 2: case 3:
+		return rnd() % 4096;
+	default:
+		return rnd() % 256 + 1;
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check_slot(struct slot *s, unsigned int i)
+{
+	size_t j;
+
+	for (j = 0; j < s->size; j++)
+		if (s->ptr[j] != (unsigned char)i)
+			fail("block contents were overwritten\n");
+}
+
+static void fill_slot(struct slot *s, unsigned int i)
+{
+	memset(s->ptr, (unsigned char)i, s->size);
+}
+
+static void release_slot(struct slot *s)
+{
+	lp_free(s->ptr);
+	s->ptr = NULL;
+}
+
+/*
+ * Keep about `live` blocks allocated while doing `ops` random operations on
+ * them. Returns nanoseconds per operation. With `verify` set the contents and
+ * alignment of every block are checked, which makes the timing meaningless.
+ */
+static double run(unsigned int live, unsigned int ops, int verify)
+{
+	unsigned int i, n;
+	double start;
+
+	start = now();
+	for (n = 0; n < ops; n++) {
+		struct slot *s;
+
+		i = rnd() % live;
+		s = &slots[i];
+		if (s->ptr != NULL) {
+			if (verify)
+				check_slot(s, i);
+			if (rnd() % 8 == 0) {
+				size_t size = random_size();
+				unsigned char *p = lp_realloc(s->ptr, size);
+
+				/* realloc(p, 0) frees p. */
+				if (p == NULL && size == 0)
+					s->ptr = NULL;
+				if (p == NULL)
+					continue;
+				s->ptr = p;
+				if (verify) {
+					size_t j, keep = size < s->size ?
+						size : s->size;
+
+					for (j = 0; j < keep; j++)
+						if (p[j] != (unsigned char)i)
+							fail("realloc lost data\n");
+				}
+				s->size = size;
+				if (verify)
+					fill_slot(s, i);
+				continue;
+			}
+			release_slot(s);
+			continue;
+		}
+
+		s->size = random_size();
+		s->dma = rnd() % 16 == 0;
+		if (rnd() % 8 == 0) {
+			size_t align = 16 << (rnd() % 9);
+
+			s->ptr = s->dma ? lp_dma_memalign(align, s->size) :
+				lp_memalign(align, s->size);
+			if (s->ptr && ((uintptr_t)s->ptr & (align - 1)))
+				fail("memalign returned unaligned memory\n");
+		} else {
+			s->ptr = s->dma ? lp_dma_malloc(s->size) :
+				lp_malloc(s->size);
+		}
+		if (s->ptr == NULL)
+			continue;
+		if ((uintptr_t)s->ptr & (TLSF_ALIGN - 1))
+			fail("malloc returned unaligned memory\n");
+		if (s->dma && !lp_dma_coherent(s->ptr))
+			fail("dma_malloc returned memory outside the DMA heap\n");
+		if (verify)
+			fill_slot(s, i);
+	}
+
+	return (now() - start) * 1e9 / ops;
+}
+
+static void release_all(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAX_LIVE; i++)
+		if (slots[i].ptr != NULL)
+			release_slot(&slots[i]);
+}
+
+/*
+ * Walk a region and check that everything but `used` blocks was given back
+ * and merged.
+ */
+static void check_empty(struct memory_type *type, unsigned int used)
+{
+	struct tlsf_block *b;
+	int was_free = 0;
+
+	for (b = type->pool.first; b != type->pool.last;
+	     b = tlsf_next_block(b)) {
+		if (tlsf_next_block(b)->prev_size != tlsf_block_size(b))
+			fail("block headers don't match\n");
+		if (tlsf_block_used(b)) {
+			if (used-- == 0)
+				fail("heap not empty after freeing everything\n");
+			was_free = 0;
+		} else {
+			if (was_free)
+				fail("free blocks were not merged\n");
+			was_free = 1;
+		}
+	}
+}
+
+int main(void)
+{
+	static const unsigned int live[] = { 64, 1024, 4096, 16384, MAX_LIVE };
+	unsigned char *mem = malloc(HEAP_SIZE + DMA_SIZE);
+	unsigned int i;
+
+	if (mem == NULL)
+		fail("could not allocate heap\n");
+
+	default_type.start = mem;
+	default_type.end = mem + HEAP_SIZE;
+	lp_init_dma_memory(mem + HEAP_SIZE, DMA_SIZE);
+	if (!lp_dma_initialized())
+		fail("DMA heap not initialized\n");
+
+	if (lp_malloc(0) != NULL || lp_memalign(24, 16) != NULL)
+		fail("invalid requests did not fail\n");
+	if (lp_malloc(HEAP_SIZE) != NULL)
+		fail("oversized request did not fail\n");
+	lp_free(mem);	/* not ours, must be ignored */
+
+	run(MAX_LIVE, 2000000, 1);
+	release_all();
+	/* The DMA heap's bookkeeping lives on the heap. */
+	check_empty(heap, 1);
+	check_empty(dma, 0);
+
+	printf("%10s %12s\n", "live", "ns/op");
+	for (i = 0; i < sizeof(live) / sizeof(live[0]); i++) {
+		run(live[i], 1000000, 0);
+		printf("%10u %12.1f\n", live[i], run(live[i], 4000000, 0));
+		release_all();
+	}
+	check_empty(heap, 1);
+	check_empty(dma, 0);
+
+	free(mem);
+	return 0;
+}
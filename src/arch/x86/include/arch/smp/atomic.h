@@ -79,5 +79,25 @@ static inline __attribute__((always_inline)) void atomic_dec(atomic_t *v)
 }
 
 
+/**
+ * atomic_inc_return - increment atomic variable and return the result
+ * @param v: pointer of type atomic_t
+ *
+ * Atomically increments v by 1 and returns the new value, so that
+ * concurrent callers each see a different result.  Note that the
+ * guaranteed useful range of an atomic_t is only 24 bits.
+ */
+static inline __attribute__((always_inline)) int atomic_inc_return(atomic_t *v)
+{
+	int i = 1;
+
+	__asm__ __volatile__(
+		"lock ; xaddl %0, %1"
+		: "+r" (i), "+m" (v->counter)
+		:
+		: "memory");
+	return i + 1;
+}
+
 
 #endif /* ARCH_SMP_ATOMIC_H */
@@ -61,6 +61,35 @@ static int cbfs_end(const struct region_device *cbfs, size_t offset)
 	return 0;
 }
 
+/* Read the file header at offset. Returns 0 on success, > 0 if there is no
+ * file header at offset and < 0 on error. */
+static int cbfs_file_at(const struct region_device *cbfs, size_t offset,
+			struct cbfsf *fh)
+{
+	struct cbfs_file file;
+	const size_t fsz = sizeof(file);
+
+	if (rdev_readat(cbfs, &file, offset, fsz) != fsz)
+		return -1;
+
+	if (memcmp(file.magic, CBFS_FILE_MAGIC, sizeof(file.magic)))
+		return 1;
+
+	file.len = read_be32(&file.len);
+	file.offset = read_be32(&file.offset);
+
+	DEBUG("File @ offset %zx size %x\n", offset, file.len);
+
+	/* Keep track of both the metadata and the data for the file. */
+	if (rdev_chain(&fh->metadata, cbfs, offset, file.offset))
+		return -1;
+
+	if (rdev_chain(&fh->data, cbfs, offset + file.offset, file.len))
+		return -1;
+
+	return 0;
+}
+
 int cbfs_for_each_file(const struct region_device *cbfs,
 			const struct cbfsf *prev, struct cbfsf *fh)
 {
@@ -70,8 +99,7 @@ int cbfs_for_each_file(const struct region_device *cbfs,
 
 	/* Try to scan the entire cbfs region looking for file name. */
 	while (1) {
-		struct cbfs_file file;
-		const size_t fsz = sizeof(file);
+		int ret;
 
 		 DEBUG("Checking offset %zx\n", offset);
 
@@ -79,28 +107,18 @@ int cbfs_for_each_file(const struct region_device *cbfs,
 		if (cbfs_end(cbfs, offset))
 			return 1;
 
+		ret = cbfs_file_at(cbfs, offset, fh);
+
 		/* Can't read file. Nothing else to do but bail out. */
-		if (rdev_readat(cbfs, &file, offset, fsz) != fsz)
+		if (ret < 0)
 			break;
 
-		if (memcmp(file.magic, CBFS_FILE_MAGIC, sizeof(file.magic))) {
+		if (ret > 0) {
 			offset++;
 			offset = ALIGN_UP(offset, CBFS_ALIGNMENT);
 			continue;
 		}
 
-		file.len = read_be32(&file.len);
-		file.offset = read_be32(&file.offset);
-
-		DEBUG("File @ offset %zx size %x\n", offset, file.len);
-
-		/* Keep track of both the metadata and the data for the file. */
-		if (rdev_chain(&fh->metadata, cbfs, offset, file.offset))
-			break;
-
-		if (rdev_chain(&fh->data, cbfs, offset + file.offset, file.len))
-			break;
-
 		/* Success. */
 		return 0;
 	}
@@ -156,7 +174,7 @@ int cbfsf_decompression_info(struct cbfsf *fh, uint32_t *algo, size_t *size)
 	return 0;
 }
 
-static int cbfsf_file_type(struct cbfsf *fh, uint32_t *ftype)
+int cbfsf_file_type(struct cbfsf *fh, uint32_t *ftype)
 {
 	const size_t sz = sizeof(*ftype);
 
@@ -169,21 +187,206 @@ static int cbfsf_file_type(struct cbfsf *fh, uint32_t *ftype)
 	return 0;
 }
 
+/* Returns 0 if fh is called name and has the requested type, > 0 if it
+ * doesn't and < 0 on error. */
+static int cbfs_file_match(struct cbfsf *fh, const struct region_device *cbfs,
+				const char *name, uint32_t *type)
+{
+	char *fname;
+	int name_match;
+	const size_t fsz = sizeof(struct cbfs_file);
+
+	fname = rdev_mmap(&fh->metadata, fsz,
+			region_device_sz(&fh->metadata) - fsz);
+
+	if (fname == NULL)
+		return -1;
+
+	name_match = !strcmp(fname, name);
+	rdev_munmap(&fh->metadata, fname);
+
+	if (!name_match) {
+		DEBUG(" Unmatched '%s' at %zx\n", fname,
+			rdev_relative_offset(cbfs, &fh->metadata));
+		return 1;
+	}
+
+	if (type != NULL) {
+		uint32_t ftype;
+
+		if (cbfsf_file_type(fh, &ftype))
+			return -1;
+
+		if (*type != ftype) {
+			DEBUG(" Unmatched type %x at %zx\n", ftype,
+				rdev_relative_offset(cbfs, &fh->metadata));
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int cbfs_locate_at(struct cbfsf *fh, const struct region_device *cbfs,
+		size_t offset, const char *name, uint32_t *type)
+{
+	if (cbfs_file_at(cbfs, offset, fh))
+		return -1;
+
+	if (cbfs_file_match(fh, cbfs, name, type))
+		return -1;
+
+	return 0;
+}
+
+uint32_t cbfs_index_hash(const char *name)
+{
+	/* 32-bit FNV-1a */
+	uint32_t hash = 0x811c9dc5;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+int cbfs_index_hash_at(const struct region_device *cbfs, size_t offset,
+			uint32_t *hash)
+{
+	struct cbfsf fh;
+	char *fname;
+	const size_t fsz = sizeof(struct cbfs_file);
+
+	if (cbfs_file_at(cbfs, offset, &fh))
+		return -1;
+
+	fname = rdev_mmap(&fh.metadata, fsz,
+			region_device_sz(&fh.metadata) - fsz);
+
+	if (fname == NULL)
+		return -1;
+
+	*hash = cbfs_index_hash(fname);
+	rdev_munmap(&fh.metadata, fname);
+
+	return 0;
+}
+
+static int cbfs_index_read_entry(const struct region_device *index,
+				size_t i, uint32_t *hash, uint32_t *offset)
+{
+	struct cbfs_index_entry entry;
+	const size_t esz = sizeof(entry);
+
+	if (rdev_readat(index, &entry, sizeof(struct cbfs_index) + i * esz,
+			esz) != esz)
+		return -1;
+
+	*hash = read_be32(&entry.name_hash);
+	*offset = read_be32(&entry.offset);
+
+	return 0;
+}
+
+/*
+ * Look up name through the index cbfstool may have placed as the first file of
+ * the CBFS. The index is sorted by name hash so this only takes a logarithmic
+ * number of boot media accesses. Returns 0 if the file was found and < 0 if
+ * it wasn't or there is no usable index, in which case the caller needs to
+ * walk the CBFS instead.
+ */
+static int cbfs_index_locate(struct cbfsf *fh, const struct region_device *cbfs,
+				const char *name, uint32_t *type)
+{
+	struct cbfs_index index;
+	struct cbfsf idx;
+	uint32_t ftype;
+	uint32_t hash;
+	uint32_t entry_hash;
+	uint32_t offset;
+	size_t num;
+	size_t lo;
+	size_t hi;
+
+	if (cbfs_file_at(cbfs, 0, &idx))
+		return -1;
+
+	if (cbfsf_file_type(&idx, &ftype) || ftype != CBFS_TYPE_INDEX)
+		return -1;
+
+	if (rdev_readat(&idx.data, &index, 0, sizeof(index)) != sizeof(index))
+		return -1;
+
+	if (read_be32(&index.magic) != CBFS_INDEX_MAGIC)
+		return -1;
+
+	num = read_be32(&index.num_entries);
+	if (num > (region_device_sz(&idx.data) - sizeof(index)) /
+			sizeof(struct cbfs_index_entry))
+		return -1;
+
+	hash = cbfs_index_hash(name);
+
+	/* Find the first entry with a matching hash. */
+	lo = 0;
+	hi = num;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (cbfs_index_read_entry(&idx.data, mid, &entry_hash, &offset))
+			return -1;
+
+		if (entry_hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Several files may share a hash. Check each one of them. */
+	for (; lo < num; lo++) {
+		int ret;
+
+		if (cbfs_index_read_entry(&idx.data, lo, &entry_hash, &offset))
+			return -1;
+
+		if (entry_hash != hash)
+			break;
+
+		/* An entry not pointing to a file means the index is stale. */
+		if (cbfs_file_at(cbfs, offset, fh))
+			return -1;
+
+		ret = cbfs_file_match(fh, cbfs, name, type);
+
+		if (ret <= 0)
+			return ret < 0 ? -1 : 0;
+	}
+
+	/* The name isn't indexed. A tool that doesn't know about the index
+	 * may have put the file anywhere, so only a walk can tell. */
+	return -1;
+}
+
 int cbfs_locate(struct cbfsf *fh, const struct region_device *cbfs,
 		const char *name, uint32_t *type)
 {
 	struct cbfsf *prev;
+	int ret;
 
 	LOG("Locating '%s'\n", name);
 
+	ret = cbfs_index_locate(fh, cbfs, name, type);
+
+	if (ret == 0)
+		goto found;
+
+	DEBUG("Not in index, walking CBFS\n");
+
 	prev = NULL;
 
 	while (1) {
-		int ret;
-		char *fname;
-		int name_match;
-		const size_t fsz = sizeof(struct cbfs_file);
-
 		ret = cbfs_for_each_file(cbfs, prev, fh);
 		prev = fh;
 
@@ -191,45 +394,27 @@ int cbfs_locate(struct cbfsf *fh, const struct region_device *cbfs,
 		if (ret < 0 || ret > 0)
 			break;
 
-		fname = rdev_mmap(&fh->metadata, fsz,
-				region_device_sz(&fh->metadata) - fsz);
+		ret = cbfs_file_match(fh, cbfs, name, type);
 
-		if (fname == NULL)
+		if (ret < 0)
 			break;
 
-		name_match = !strcmp(fname, name);
-		rdev_munmap(&fh->metadata, fname);
-
-		if (!name_match) {
-			DEBUG(" Unmatched '%s' at %zx\n", fname,
-				rdev_relative_offset(cbfs, &fh->metadata));
+		if (ret > 0)
 			continue;
-		}
-
-		if (type != NULL) {
-			uint32_t ftype;
 
-			if (cbfsf_file_type(fh, &ftype))
-				break;
-
-			if (*type != ftype) {
-				DEBUG(" Unmatched type %x at %zx\n", ftype,
-					rdev_relative_offset(cbfs,
-							&fh->metadata));
-				continue;
-			}
-		}
-
-		LOG("Found @ offset %zx size %zx\n",
-			rdev_relative_offset(cbfs, &fh->metadata),
-			region_device_sz(&fh->data));
-
-		/* Success. */
-		return 0;
+		goto found;
 	}
 
 	LOG("'%s' not found.\n", name);
 	return -1;
+
+found:
+	LOG("Found @ offset %zx size %zx\n",
+		rdev_relative_offset(cbfs, &fh->metadata),
+		region_device_sz(&fh->data));
+
+	/* Success. */
+	return 0;
 }
 
 static int cbfs_extend_hash_buffer(struct vb2_digest_context *ctx,
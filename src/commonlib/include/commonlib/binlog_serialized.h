@@ -0,0 +1,74 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __BINLOG_SERIALIZED_H__
+#define __BINLOG_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+#define BINLOG_MAGIC		0x474f4c42	/* "BLOG" */
+
+/*
+ * Binary printk log, stored in CBMEM_ID_BINLOG. Each format string is
+ * stored once in the string table, and records refer to it by its offset
+ * there. Records are kept in a ring buffer that drops the oldest records
+ * when it is full. A record can wrap around the end of the ring.
+ *
+ * All offsets are relative to the start of the header, values are in the
+ * byte order of the firmware.
+ */
+struct binlog_header {
+	uint32_t	magic;
+	uint32_t	long_size;	/* sizeof(long) and sizeof(void *) */
+	uint32_t	index_offset;	/* format string lookup, firmware only */
+	uint32_t	index_entries;
+	uint32_t	strings_offset;
+	uint32_t	strings_size;
+	uint32_t	strings_used;
+	uint32_t	ring_offset;
+	uint32_t	ring_size;
+	uint32_t	head;		/* ring offset of the oldest record */
+	uint32_t	used;		/* bytes of records in the ring */
+	uint32_t	dropped;	/* records dropped to make room */
+} __packed;
+
+struct binlog_index_entry {
+	uint32_t	fmt_addr;	/* address of the format string */
+	uint32_t	fmt_offset;	/* string table offset + 1, 0 if unused */
+} __packed;
+
+/* The format string follows the record header instead of being stored in
+ * the string table, which is full. */
+#define BINLOG_RECORD_INLINE	(1 << 0)
+/* Not all arguments fit in the record. */
+#define BINLOG_RECORD_TRUNCATED	(1 << 1)
+
+/*
+ * The arguments follow the record header (and inline format string) in the
+ * order the format string consumes them, packed without padding:
+ *  - '*' field widths and precisions, %c: 4 bytes
+ *  - %d, %i, %o, %u, %x, %X: 8 bytes with the 'll' qualifier, long_size
+ *    bytes with 'l' and 'z', 4 bytes otherwise
+ *  - %p: long_size bytes
+ *  - %s: the string including its terminating NUL, "<NULL>" for NULL
+ *  - %n, %% and unknown conversions: nothing
+ */
+struct binlog_record {
+	uint16_t	size;		/* including this header */
+	uint8_t		level;		/* BIOS_* log level */
+	uint8_t		flags;
+	uint32_t	fmt;		/* string table offset, unless INLINE */
+} __packed;
+
+#endif
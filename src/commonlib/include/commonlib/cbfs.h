@@ -27,10 +27,23 @@ struct cbfsf {
 };
 
 /* Locate file by name and optional type. Returns 0 on succcess else < 0 on
- * error.*/
+ * error. Uses the CBFS index if there is one, otherwise walks the CBFS. */
 int cbfs_locate(struct cbfsf *fh, const struct region_device *cbfs,
 		const char *name, uint32_t *type);
 
+/* Check that the file whose header is at offset within the CBFS has the given
+ * name and optional type. Returns 0 and fills in fh if so, else < 0. */
+int cbfs_locate_at(struct cbfsf *fh, const struct region_device *cbfs,
+		size_t offset, const char *name, uint32_t *type);
+
+/* Hash of a file name as used to sort the entries of a CBFS index. */
+uint32_t cbfs_index_hash(const char *name);
+
+/* Hash the name of the file whose header is at offset within the CBFS.
+ * Returns 0 on success else < 0. */
+int cbfs_index_hash_at(const struct region_device *cbfs, size_t offset,
+			uint32_t *hash);
+
 static inline void cbfs_file_data(struct region_device *data,
 					const struct cbfsf *file)
 {
@@ -70,6 +83,9 @@ size_t cbfs_for_each_attr(void *metadata, size_t metadata_size,
  */
 int cbfsf_decompression_info(struct cbfsf *fh, uint32_t *algo, size_t *size);
 
+/* Read the type of a CBFS file. Returns 0 on success and < 0 on error. */
+int cbfsf_file_type(struct cbfsf *fh, uint32_t *ftype);
+
 /*
  * Perform the vb2 hash over the CBFS region skipping empty file contents.
  * Caller is responsible for providing the hash algorithm as well as storage
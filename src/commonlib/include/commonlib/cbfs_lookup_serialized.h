@@ -0,0 +1,38 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __CBFS_LOOKUP_SERIALIZED_H__
+#define __CBFS_LOOKUP_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+/* Location of a file previously found in the boot CBFS. */
+struct cbfs_lookup_entry {
+	uint32_t	name_hash;	/* cbfs_index_hash() of the name */
+	uint32_t	type;
+	uint32_t	cbfs_offset;	/* CBFS offset within the boot device */
+	uint32_t	file_offset;	/* file header offset within the CBFS */
+	uint32_t	data_size;
+} __packed;
+
+/* Stored in CBMEM_ID_CBFS_LOOKUP once cbmem is online. */
+struct cbfs_lookup_cache {
+	uint32_t	max_entries;
+	uint32_t	num_entries;
+	uint32_t	hits;
+	uint32_t	misses;
+	struct cbfs_lookup_entry entries[0]; /* Variable number of entries */
+} __packed;
+
+#endif
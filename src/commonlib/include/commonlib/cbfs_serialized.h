@@ -58,6 +58,7 @@
 #define CBFS_COMPRESS_NONE  0
 #define CBFS_COMPRESS_LZMA  1
 #define CBFS_COMPRESS_LZ4   2
+#define CBFS_COMPRESS_ZSTD  3
 
 /** These are standard component types for well known
     components (i.e - those that coreboot needs to consume.
@@ -66,6 +67,7 @@
 
 #define CBFS_TYPE_DELETED    0x00000000
 #define CBFS_TYPE_DELETED2   0xffffffff
+#define CBFS_TYPE_INDEX      0x03
 #define CBFS_TYPE_STAGE      0x10
 #define CBFS_TYPE_PAYLOAD    0x20
 #define CBFS_TYPE_OPTIONROM  0x30
@@ -186,6 +188,24 @@ struct cbfs_file_attr_align {
 	uint32_t alignment;
 } __packed;
 
+/* Optional index over the files of a CBFS. If present, it is stored as the
+ * first file of the CBFS (type CBFS_TYPE_INDEX) and lists the offsets of all
+ * other files' headers sorted by a hash of their names (see
+ * cbfs_index_hash()). All fields are big endian. */
+#define CBFS_INDEX_MAGIC 0x58494243 /* CBIX */
+
+struct cbfs_index_entry {
+	uint32_t name_hash;
+	/* offset of the cbfs_file header relative to the start of the CBFS */
+	uint32_t offset;
+} __packed;
+
+struct cbfs_index {
+	uint32_t magic;
+	uint32_t num_entries;
+	struct cbfs_index_entry entries[0];
+} __packed;
+
 /*
  * ROMCC does not understand uint64_t, so we hide future definitions as they are
  * unlikely to be ever needed from ROMCC
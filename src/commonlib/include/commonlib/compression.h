@@ -28,7 +28,23 @@
  */
 size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn);
 
+/* Same as ulz4fn(), but src doesn't need to hold the input up front. Before
+ * each LZ4 block is decompressed, fill(arg, size) is called and has to make
+ * the first size bytes of src available. It returns < 0 on error, which
+ * aborts decompression. This lets decompression of the first blocks start
+ * before all of the input has been loaded. */
+size_t ulz4fn_fill(const void *src, size_t srcn, void *dst, size_t dstn,
+	int (*fill)(void *arg, size_t size), void *arg);
+
 /* Same as ulz4fn() but does not perform any bounds checks. */
 size_t ulz4f(const void *src, void *dst);
 
+/* Decompresses a single Zstandard frame from src to dst, ensuring that it
+ * doesn't read more than srcn bytes and doesn't write more than dstn. Frames
+ * using dictionaries are rejected, and the checksum is not verified. src and
+ * dst must not overlap, since the end of dst is used as scratch space for
+ * literals. Returns amount of decompressed bytes, or 0 on error.
+ */
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn);
+
 #endif	/* _COMMONLIB_COMPRESSION_H_ */
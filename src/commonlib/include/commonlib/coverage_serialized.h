@@ -0,0 +1,41 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __COVERAGE_SERIALIZED_H__
+#define __COVERAGE_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+/*
+ * gcov data of ramstage, stored in CBMEM_ID_COVERAGE. The header is followed
+ * by num_files records, each a coverage_file immediately followed by its
+ * name and the contents of the .gcda file. Records are packed back to back
+ * and stay 4 byte aligned since name_len and data_len are multiples of 4.
+ */
+
+#define COVERAGE_MAGIC		0x41444347	/* "GCDA" */
+
+struct coverage_file {
+	uint32_t name_len;		/* NUL terminated, padded to 4 bytes */
+	uint32_t data_len;		/* bytes of .gcda data after the name */
+} __packed;
+
+struct coverage_header {
+	uint32_t magic;
+	uint32_t num_files;
+	uint32_t size;			/* bytes used, header included */
+	uint32_t reserved;
+} __packed;
+
+#endif
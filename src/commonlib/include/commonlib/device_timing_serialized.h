@@ -0,0 +1,48 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __DEVICE_TIMING_SERIALIZED_H__
+#define __DEVICE_TIMING_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+/*
+ * Duration of every device_operations callback run while walking the device
+ * tree in ramstage, in the order they ran. Stored in CBMEM_ID_DEVICE_TIMING.
+ */
+
+#define DEVICE_TIMING_PATH_LEN	40
+
+enum device_timing_op {
+	DEVICE_TIMING_READ_RESOURCES = 1,
+	DEVICE_TIMING_SET_RESOURCES = 2,
+	DEVICE_TIMING_ENABLE_RESOURCES = 3,
+	DEVICE_TIMING_INIT = 4,
+	DEVICE_TIMING_FINAL = 5,
+};
+
+struct device_timing_entry {
+	uint32_t usecs;
+	uint32_t op;				/* enum device_timing_op */
+	char path[DEVICE_TIMING_PATH_LEN];	/* dev_path(), NUL terminated */
+} __packed;
+
+struct device_timing_table {
+	uint32_t max_entries;
+	uint32_t num_entries;
+	uint32_t dropped;			/* callbacks that didn't fit */
+	struct device_timing_entry entries[0];
+} __packed;
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __FUNC_TRACE_SERIALIZED_H__
+#define __FUNC_TRACE_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+/*
+ * Function entries and exits recorded by the -finstrument-functions hooks of
+ * ramstage, stored in CBMEM_ID_FUNC_TRACE. records[] is a ring: record n is
+ * kept in records[n % max_records], so only the last max_records of the
+ * head records written survive.
+ */
+
+#define FUNC_TRACE_EXIT		(1 << 0)
+
+struct func_trace_record {
+	uint64_t tsc;			/* timestamp_get() */
+	uint32_t func;			/* offset from program_base */
+	uint32_t call_site;		/* offset from program_base */
+	uint16_t cpu;
+	uint16_t flags;
+	uint32_t reserved;
+} __packed;
+
+struct func_trace_buffer {
+	uint64_t program_base;		/* runtime address of _program */
+	uint32_t tick_freq_mhz;
+	uint32_t max_records;
+	uint32_t head;			/* records written so far */
+	uint32_t reserved;
+	struct func_trace_record records[0];
+} __packed;
+
+#endif
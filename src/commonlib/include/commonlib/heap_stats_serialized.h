@@ -0,0 +1,37 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __HEAP_STATS_SERIALIZED_H__
+#define __HEAP_STATS_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+/*
+ * Usage of the ramstage heap, stored in CBMEM_ID_HEAP_STATS. Sizes are in
+ * bytes and include the allocator's per block overhead. The snapshot is
+ * taken right before the payload or the OS resume vector is entered.
+ */
+
+struct heap_stats {
+	uint32_t heap_size;
+	uint32_t in_use;
+	uint32_t peak_in_use;
+	uint32_t num_allocs;
+	uint32_t num_frees;
+	uint32_t free_blocks;
+	uint32_t largest_free;		/* fragmentation: vs. heap_size - in_use */
+	uint32_t reserved;
+} __packed;
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __LAPIC_PROFILE_SERIALIZED_H__
+#define __LAPIC_PROFILE_SERIALIZED_H__
+
+#include <stdint.h>
+#include <compiler.h>
+
+/*
+ * Histogram of the instruction pointers the ramstage sampling profiler
+ * interrupted, stored in CBMEM_ID_LAPIC_PROFILE. buckets[] is an open
+ * addressing hash table; unused buckets have a count of 0.
+ */
+
+struct lapic_profile_bucket {
+	uint32_t pc;
+	uint32_t count;
+} __packed;
+
+struct lapic_profile_table {
+	uint32_t hz;			/* nominal sampling rate */
+	uint32_t program_base;		/* runtime address of _program */
+	uint32_t num_buckets;
+	uint32_t samples;		/* all samples, including dropped */
+	uint32_t dropped;		/* samples that found no free bucket */
+	struct lapic_profile_bucket buckets[0];
+} __packed;
+
+#endif
@@ -63,6 +63,44 @@ ssize_t rdev_writeat(const struct region_device *rd, const void *b,
 ssize_t rdev_eraseat(const struct region_device *rd, size_t offset,
 			size_t size);
 
+/*
+ * Asynchronous reads. rdev_readat_async() starts reading size bytes at offset
+ * into b. Once the read has finished, req->result holds what rdev_readat()
+ * would have returned and req->done(req) is called if it is set. Region
+ * devices that don't implement asynchronous reads finish the request before
+ * rdev_readat_async() returns. The buffer and the request need to stay valid
+ * until the request has completed.
+ */
+struct rdev_async_req {
+	/* Optional completion callback, filled in by the caller. */
+	void (*done)(struct rdev_async_req *req);
+	void *arg;
+	/* Valid after completion. */
+	ssize_t result;
+	/* Private to the region device implementation. */
+	const struct region_device *rdev;
+	int pending;
+	void *priv;
+};
+
+/* Returns < 0 if the read could not be started, otherwise 0. */
+int rdev_readat_async(const struct region_device *rd,
+			struct rdev_async_req *req, void *b, size_t offset,
+			size_t size);
+
+/* Let the region device make progress. Returns 1 when req has completed. */
+int rdev_async_poll(struct rdev_async_req *req);
+
+/* Wait for req to complete. Returns req->result. */
+ssize_t rdev_async_wait(struct rdev_async_req *req);
+
+/*
+ * Called by rdev_async_wait() while the request is pending. The default
+ * implementation does nothing. Override it to hand the CPU to other work,
+ * e.g. by yielding to another thread.
+ */
+void rdev_async_idle(void);
+
 /****************************************
  *  Implementation of a region device   *
  ****************************************/
@@ -84,8 +122,17 @@ struct region_device_ops {
 	ssize_t (*writeat)(const struct region_device *, const void *, size_t,
 		size_t);
 	ssize_t (*eraseat)(const struct region_device *, size_t, size_t);
+	/* Optional. Start a read and call rdev_async_complete() once done. */
+	int (*readat_async)(const struct region_device *,
+		struct rdev_async_req *, void *, size_t, size_t);
+	/* Optional. Advance started reads without blocking. */
+	void (*poll)(const struct region_device *);
 };
 
+/* Called by region device implementations when an asynchronous read has
+ * finished with the given result. */
+void rdev_async_complete(struct rdev_async_req *req, ssize_t result);
+
 struct region {
 	size_t offset;
 	size_t size;
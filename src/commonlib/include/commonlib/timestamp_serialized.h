@@ -32,6 +32,34 @@ struct timestamp_table {
 	struct timestamp_entry entries[0]; /* Variable number of entries */
 } __packed;
 
+/*
+ * Timestamp spans are kept in a separate CBMEM area next to the flat
+ * timestamp_table. A span has a start and an end. It also links to the span
+ * that was open on the same CPU when it began. Stamps are relative to
+ * base_time, just like in the timestamp_table.
+ */
+#define TIMESTAMP_SPAN_VERSION		2
+#define TIMESTAMP_SPAN_LABEL_LEN	24
+
+struct timestamp_span {
+	uint64_t	start;
+	uint64_t	end;		/* 0 while the span is still open */
+	uint32_t	id;		/* enum timestamp_id, or 0 */
+	uint16_t	parent;		/* index + 1 of the parent, 0 for none */
+	uint16_t	cpu;
+	char		label[TIMESTAMP_SPAN_LABEL_LEN]; /* NUL terminated */
+} __packed;
+
+struct timestamp_span_table {
+	uint32_t	version;
+	uint16_t	tick_freq_mhz;
+	uint16_t	reserved;
+	uint64_t	base_time;
+	uint32_t	max_entries;
+	uint32_t	num_entries;
+	struct timestamp_span entries[0];
+} __packed;
+
 enum timestamp_id {
 	TS_START_ROMSTAGE = 1,
 	TS_BEFORE_INITRAM = 2,
@@ -50,6 +78,8 @@ enum timestamp_id {
 	TS_END_ULZMA = 16,
 	TS_START_ULZ4F = 17,
 	TS_END_ULZ4F = 18,
+	TS_START_UZSTD = 19,
+	TS_END_UZSTD = 20,
 	TS_DEVICE_ENUMERATE = 30,
 	TS_DEVICE_CONFIGURE = 40,
 	TS_DEVICE_ENABLE = 50,
@@ -59,6 +89,8 @@ enum timestamp_id {
 	TS_WRITE_TABLES = 80,
 	TS_FINALIZE_CHIPS = 85,
 	TS_LOAD_PAYLOAD = 90,
+	TS_START_PAYLOAD_PREFETCH = 91,
+	TS_END_PAYLOAD_PREFETCH = 92,
 	TS_ACPI_WAKE_JUMP = 98,
 	TS_SELFBOOT_JUMP = 99,
 
@@ -136,6 +168,8 @@ static const struct timestamp_id_to_name {
 	{ TS_END_ULZMA,		"finished LZMA decompress (ignore for x86)" },
 	{ TS_START_ULZ4F,	"starting LZ4 decompress (ignore for x86)" },
 	{ TS_END_ULZ4F,		"finished LZ4 decompress (ignore for x86)" },
+	{ TS_START_UZSTD,	"starting ZSTD decompress (ignore for x86)" },
+	{ TS_END_UZSTD,		"finished ZSTD decompress (ignore for x86)" },
 	{ TS_DEVICE_ENUMERATE,	"device enumeration" },
 	{ TS_DEVICE_CONFIGURE,	"device configuration" },
 	{ TS_DEVICE_ENABLE,	"device enable" },
@@ -145,6 +179,8 @@ static const struct timestamp_id_to_name {
 	{ TS_WRITE_TABLES,	"write tables" },
 	{ TS_FINALIZE_CHIPS,	"finalize chips" },
 	{ TS_LOAD_PAYLOAD,	"load payload" },
+	{ TS_START_PAYLOAD_PREFETCH,	"starting to prefetch payload" },
+	{ TS_END_PAYLOAD_PREFETCH,	"finished prefetching payload" },
 	{ TS_ACPI_WAKE_JUMP,	"ACPI wake jump" },
 	{ TS_SELFBOOT_JUMP,	"selfboot jump" },
 
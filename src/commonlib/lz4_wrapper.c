@@ -130,19 +130,25 @@ struct lz4_block_header {
 	/* + uint32_t block_checksum iff has_block_checksum is set */
 } __packed;
 
-size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
+static size_t lz4_decompress(const void *src, size_t srcn, void *dst,
+	size_t dstn, int (*fill)(void *arg, size_t size), void *arg)
 {
 	const void *in = src;
 	void *out = dst;
 	size_t out_size = 0;
 	int has_block_checksum;
 
+#define FILL(size) (fill != NULL && fill(arg, MIN((size_t)(size), srcn)) < 0)
+
 	{ /* With in-place decompression the header may become invalid later. */
 		const struct lz4_frame_header *h = in;
 
 		if (srcn < sizeof(*h) + sizeof(uint64_t) + sizeof(uint8_t))
 			return 0;	/* input overrun */
 
+		if (FILL(sizeof(*h) + sizeof(uint64_t) + sizeof(uint8_t)))
+			return 0;	/* read error */
+
 		/* We assume there's always only a single, standard frame. */
 		if (read_le32(&h->magic) != LZ4F_MAGICNUMBER || h->version != 1)
 			return 0;	/* unknown format */
@@ -158,6 +164,9 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
 		in += sizeof(uint8_t);
 	}
 
+	if (FILL(in - src + sizeof(struct lz4_block_header)))
+		return 0;		/* read error */
+
 	while (1) {
 		struct lz4_block_header b = { { .raw = read_le32(in) } };
 		in += sizeof(struct lz4_block_header);
@@ -170,6 +179,12 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
 			break;			/* decompression successful */
 		}
 
+		/* Get this block and the header of the next one. */
+		if (FILL(in - src + b.size + (has_block_checksum ?
+				sizeof(uint32_t) : 0) +
+				sizeof(struct lz4_block_header)))
+			break;			/* read error */
+
 		if (b.not_compressed) {
 			size_t size = MIN((uintptr_t)b.size, (uintptr_t)dst
 				+ dstn - (uintptr_t)out);
@@ -192,9 +207,22 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
 			in += sizeof(uint32_t);
 	}
 
+#undef FILL
+
 	return out_size;
 }
 
+size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	return lz4_decompress(src, srcn, dst, dstn, NULL, NULL);
+}
+
+size_t ulz4fn_fill(const void *src, size_t srcn, void *dst, size_t dstn,
+	int (*fill)(void *arg, size_t size), void *arg)
+{
+	return lz4_decompress(src, srcn, dst, dstn, fill, arg);
+}
+
 size_t ulz4f(const void *src, void *dst)
 {
 	/* LZ4 uses signed size parameters, so can't just use ((u32)-1) here. */
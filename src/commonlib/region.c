@@ -109,6 +109,67 @@ ssize_t rdev_readat(const struct region_device *rd, void *b, size_t offset,
 	return rdev->ops->readat(rdev, b, req.offset, req.size);
 }
 
+int rdev_readat_async(const struct region_device *rd,
+			struct rdev_async_req *req, void *b, size_t offset,
+			size_t size)
+{
+	const struct region_device *rdev;
+	struct region r = {
+		.offset = offset,
+		.size = size,
+	};
+
+	if (!normalize_and_ok(&rd->region, &r))
+		return -1;
+
+	rdev = rdev_root(rd);
+
+	req->rdev = rdev;
+	req->pending = 1;
+	req->result = -1;
+
+	/* Synchronous fallback. */
+	if (rdev->ops->readat_async == NULL) {
+		rdev_async_complete(req,
+			rdev->ops->readat(rdev, b, r.offset, r.size));
+		return 0;
+	}
+
+	if (rdev->ops->readat_async(rdev, req, b, r.offset, r.size)) {
+		req->pending = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+void rdev_async_complete(struct rdev_async_req *req, ssize_t result)
+{
+	req->result = result;
+	req->pending = 0;
+
+	if (req->done != NULL)
+		req->done(req);
+}
+
+int rdev_async_poll(struct rdev_async_req *req)
+{
+	if (req->pending && req->rdev->ops->poll != NULL)
+		req->rdev->ops->poll(req->rdev);
+
+	return !req->pending;
+}
+
+__attribute__((weak)) void rdev_async_idle(void) { /* no-op */ }
+
+ssize_t rdev_async_wait(struct rdev_async_req *req)
+{
+	while (!rdev_async_poll(req))
+		rdev_async_idle();
+
+	return req->result;
+}
+
 ssize_t rdev_writeat(const struct region_device *rd, const void *b,
 			size_t offset, size_t size)
 {
@@ -386,6 +447,26 @@ static ssize_t xlate_readat(const struct region_device *rd, void *b,
 	return rdev_readat(xldev->access_dev, b, offset, size);
 }
 
+static int xlate_readat_async(const struct region_device *rd,
+				struct rdev_async_req *req, void *b,
+				size_t offset, size_t size)
+{
+	struct region r = {
+		.offset = offset,
+		.size = size,
+	};
+	const struct xlate_region_device *xldev;
+
+	xldev = container_of(rd, __typeof__(*xldev), rdev);
+
+	if (!is_subregion(&xldev->sub_region, &r))
+		return -1;
+
+	offset -= region_offset(&xldev->sub_region);
+
+	return rdev_readat_async(xldev->access_dev, req, b, offset, size);
+}
+
 static ssize_t xlate_writeat(const struct region_device *rd, const void *b,
 				size_t offset, size_t size)
 {
@@ -428,12 +509,14 @@ const struct region_device_ops xlate_rdev_ro_ops = {
 	.mmap = xlate_mmap,
 	.munmap = xlate_munmap,
 	.readat = xlate_readat,
+	.readat_async = xlate_readat_async,
 };
 
 const struct region_device_ops xlate_rdev_rw_ops = {
 	.mmap = xlate_mmap,
 	.munmap = xlate_munmap,
 	.readat = xlate_readat,
+	.readat_async = xlate_readat_async,
 	.writeat = xlate_writeat,
 	.eraseat = xlate_eraseat,
 };
@@ -468,6 +551,17 @@ static ssize_t incoherent_readat(const struct region_device *rd, void *b,
 	return rdev_readat(irdev->read, b, offset, size);
 }
 
+static int incoherent_readat_async(const struct region_device *rd,
+				struct rdev_async_req *req, void *b,
+				size_t offset, size_t size)
+{
+	const struct incoherent_rdev *irdev;
+
+	irdev = container_of(rd, const struct incoherent_rdev, rdev);
+
+	return rdev_readat_async(irdev->read, req, b, offset, size);
+}
+
 static ssize_t incoherent_writeat(const struct region_device *rd, const void *b,
 			size_t offset, size_t size)
 {
@@ -492,6 +586,7 @@ static const struct region_device_ops incoherent_rdev_ops = {
 	.mmap = incoherent_mmap,
 	.munmap = incoherent_munmap,
 	.readat = incoherent_readat,
+	.readat_async = incoherent_readat_async,
 	.writeat = incoherent_writeat,
 	.eraseat = incoherent_eraseat,
 };
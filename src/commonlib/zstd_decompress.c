@@ -0,0 +1,961 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Decoder for single Zstandard frames as described in RFC 8878.
+ *
+ * Since the whole frame is decompressed in one go, the output buffer doubles
+ * as the window, and the literals of each block are decoded into the unused
+ * end of the output buffer. Besides the output buffer, only the decoding
+ * tables in struct zstd_workspace are needed, independently of the window
+ * size the frame was compressed with.
+ */
+
+#include <commonlib/compression.h>
+#include <commonlib/endian.h>
+#include <commonlib/helpers.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Host tools have plenty of stack. */
+#ifndef MAYBE_STATIC
+#define MAYBE_STATIC
+#endif
+
+#define ZSTD_MAGIC		0xfd2fb528
+#define ZSTD_SKIPPABLE_MAGIC	0x184d2a50
+#define ZSTD_SKIPPABLE_MASK	0xfffffff0
+#define ZSTD_BLOCK_SIZE_MAX	(128 * KiB)
+
+#define HUF_MAX_BITS		11
+#define HUF_MAX_SYMBOLS		256
+#define HUF_WEIGHT_LOG		6
+
+#define LL_MAX_LOG		9
+#define ML_MAX_LOG		9
+#define OF_MAX_LOG		8
+#define LL_MAX_SYMBOL		35
+#define ML_MAX_SYMBOL		52
+#define OF_MAX_SYMBOL		31
+
+enum {
+	BLOCK_RAW = 0,
+	BLOCK_RLE = 1,
+	BLOCK_COMPRESSED = 2,
+};
+
+enum {
+	LITERALS_RAW = 0,
+	LITERALS_RLE = 1,
+	LITERALS_COMPRESSED = 2,
+	LITERALS_TREELESS = 3,
+};
+
+enum {
+	MODE_PREDEFINED = 0,
+	MODE_RLE = 1,
+	MODE_FSE = 2,
+	MODE_REPEAT = 3,
+};
+
+struct fse_entry {
+	uint8_t symbol;
+	uint8_t nb_bits;
+	uint16_t baseline;
+};
+
+struct fse_table {
+	struct fse_entry *entries;
+	int log;		/* < 0 if not set up yet */
+	int max_log;
+	int max_symbol;
+	const int16_t *default_norm;
+	int default_max_symbol;
+	int default_log;
+};
+
+struct zstd_workspace {
+	uint16_t huf[1 << HUF_MAX_BITS];	/* symbol << 8 | nb_bits */
+	int huf_bits;				/* 0 if not set up yet */
+	struct fse_entry ll_entries[1 << LL_MAX_LOG];
+	struct fse_entry ml_entries[1 << ML_MAX_LOG];
+	struct fse_entry of_entries[1 << OF_MAX_LOG];
+	struct fse_table ll, ml, of;
+	uint32_t rep[3];
+};
+
+static const int16_t ll_default_norm[LL_MAX_SYMBOL + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1
+};
+
+static const int16_t ml_default_norm[ML_MAX_SYMBOL + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1
+};
+
+static const int16_t of_default_norm[28 + 1] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+
+static const uint32_t ll_base[LL_MAX_SYMBOL + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+	8192, 16384, 32768, 65536
+};
+
+static const uint8_t ll_bits[LL_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16
+};
+
+static const uint32_t ml_base[ML_MAX_SYMBOL + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+	4099, 8195, 16387, 32771, 65539
+};
+
+static const uint8_t ml_bits[ML_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16
+};
+
+static int highbit(uint32_t x)
+{
+	return 31 - __builtin_clz(x);
+}
+
+/*
+ * Bitstreams of FSE and Huffman coded data are read backwards, starting with
+ * the highest bit below the padding marker in the last byte. Reading past the
+ * start of the stream yields zeros, and leaves pos negative.
+ *
+ * The 64 bits starting at bit base are kept in window. It is only reloaded
+ * once fewer bits than a read may take are left in it, which keeps the
+ * per-symbol cost down to a shift and a mask.
+ */
+struct bitrev {
+	const uint8_t *src;
+	size_t size;
+	int pos;
+	int base;
+	uint64_t window;
+};
+
+/* Moves the window so that it holds at least the 56 bits below pos, or all
+ * bits down to the start of the stream. */
+static void bitrev_reload(struct bitrev *b)
+{
+	size_t i;
+
+	if (b->pos >= 63) {
+		b->base = (b->pos - 56) & ~7;
+		b->window = read_le64(b->src + b->base / 8);
+		return;
+	}
+
+	b->base = 0;
+	b->window = 0;
+	for (i = 0; i < sizeof(b->window) && i < b->size; i++)
+		b->window |= (uint64_t)b->src[i] << (8 * i);
+}
+
+static int bitrev_init(struct bitrev *b, const uint8_t *src, size_t size)
+{
+	if (size == 0 || size > ZSTD_BLOCK_SIZE_MAX || src[size - 1] == 0)
+		return -1;
+
+	b->src = src;
+	b->size = size;
+	b->pos = (size - 1) * 8 + highbit(src[size - 1]);
+	bitrev_reload(b);
+	return 0;
+}
+
+/* Returns the next n (<= 32) bits without consuming them. */
+static inline uint32_t bitrev_peek(struct bitrev *b, int n)
+{
+	int start = b->pos - n;
+	uint64_t mask = (1ULL << n) - 1;
+
+	if (start < b->base && b->base > 0)
+		bitrev_reload(b);
+	if (start >= b->base)
+		return (b->window >> (start - b->base)) & mask;
+	if (b->pos <= 0)
+		return 0;
+	return (b->window << -start) & mask;
+}
+
+static inline uint32_t bitrev_read(struct bitrev *b, int n)
+{
+	uint32_t v = bitrev_peek(b, n);
+
+	b->pos -= n;
+	return v;
+}
+
+/* Returns 32 bits of src starting at bit offset bit, padded with zeros. */
+static uint32_t read_bits_le(const uint8_t *src, size_t srcn, size_t bit)
+{
+	size_t byte = bit / 8;
+	uint64_t v = 0;
+	size_t i;
+
+	for (i = 0; i < 5 && byte + i < srcn; i++)
+		v |= (uint64_t)src[byte + i] << (8 * i);
+
+	return v >> (bit % 8);
+}
+
+/* Reads the normalized probabilities of an FSE table description. Returns
+ * the number of bytes it took up, or < 0 on error. */
+static int fse_read_ncount(const uint8_t *src, size_t srcn, int16_t *norm,
+			   int *max_symbol, int max_log, int *log)
+{
+	size_t bit = 4;
+	int remaining, threshold, nb_bits, symbol = 0;
+
+	if (srcn < 1)
+		return -1;
+
+	*log = (src[0] & 0xf) + 5;
+	if (*log > max_log)
+		return -1;
+
+	remaining = (1 << *log) + 1;
+	threshold = 1 << *log;
+	nb_bits = *log + 1;
+
+	while (remaining > 1) {
+		uint32_t val;
+		int count, max;
+
+		if (symbol > *max_symbol || bit > srcn * 8)
+			return -1;
+
+		val = read_bits_le(src, srcn, bit);
+		max = (2 * threshold - 1) - remaining;
+		if ((int)(val & (threshold - 1)) < max) {
+			count = val & (threshold - 1);
+			bit += nb_bits - 1;
+		} else {
+			count = val & (2 * threshold - 1);
+			if (count >= threshold)
+				count -= max;
+			bit += nb_bits;
+		}
+
+		count--;
+		remaining -= count < 0 ? -count : count;
+		if (remaining < 1)
+			return -1;
+		norm[symbol++] = count;
+
+		/* A zero probability is followed by 2 bit counts of further
+		 * zeros, which continue for as long as they are 3. */
+		if (count == 0) {
+			int repeat;
+
+			do {
+				repeat = read_bits_le(src, srcn, bit) & 3;
+				bit += 2;
+				if (symbol + repeat > *max_symbol + 1)
+					return -1;
+				memset(&norm[symbol], 0,
+				       repeat * sizeof(norm[0]));
+				symbol += repeat;
+			} while (repeat == 3);
+		}
+
+		while (remaining < threshold) {
+			nb_bits--;
+			threshold >>= 1;
+		}
+	}
+
+	if (remaining != 1 || bit > srcn * 8)
+		return -1;
+
+	*max_symbol = symbol - 1;
+	return (bit + 7) / 8;
+}
+
+static int fse_build(struct fse_entry *entries, const int16_t *norm,
+		     int max_symbol, int log)
+{
+	const uint32_t size = 1 << log;
+	const uint32_t step = (size >> 1) + (size >> 3) + 3;
+	uint32_t high = size - 1;
+	uint32_t pos = 0;
+	uint16_t next[ML_MAX_SYMBOL + 1];
+	uint32_t i;
+	int s, j;
+
+	/* Symbols with "less than 1" probability get a single cell at the
+	 * top of the table, all others are spread over the remaining ones. */
+	for (s = 0; s <= max_symbol; s++) {
+		if (norm[s] == -1) {
+			entries[high--].symbol = s;
+			next[s] = 1;
+		} else {
+			next[s] = norm[s];
+		}
+	}
+
+	for (s = 0; s <= max_symbol; s++) {
+		for (j = 0; j < norm[s]; j++) {
+			entries[pos].symbol = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+
+	if (pos != 0)
+		return -1;
+
+	for (i = 0; i < size; i++) {
+		uint32_t n = next[entries[i].symbol]++;
+		int nb_bits = log - highbit(n);
+
+		entries[i].nb_bits = nb_bits;
+		entries[i].baseline = (n << nb_bits) - size;
+	}
+
+	return 0;
+}
+
+static void fse_update(const struct fse_entry *entries, uint32_t *state,
+		       struct bitrev *b)
+{
+	const struct fse_entry *e = &entries[*state];
+
+	*state = e->baseline + bitrev_read(b, e->nb_bits);
+}
+
+/* Sets up one of the sequence decoding tables. Returns the number of input
+ * bytes used, or < 0 on error. */
+static int fse_table_setup(struct fse_table *t, int mode, const uint8_t *src,
+			   size_t srcn)
+{
+	int16_t norm[ML_MAX_SYMBOL + 1];
+	int max_symbol = t->max_symbol;
+	int log, n;
+
+	switch (mode) {
+	case MODE_PREDEFINED:
+		t->log = t->default_log;
+		return fse_build(t->entries, t->default_norm,
+				 t->default_max_symbol, t->default_log);
+	case MODE_RLE:
+		if (srcn < 1 || src[0] > t->max_symbol)
+			return -1;
+		t->entries[0].symbol = src[0];
+		t->entries[0].nb_bits = 0;
+		t->entries[0].baseline = 0;
+		t->log = 0;
+		return 1;
+	case MODE_FSE:
+		n = fse_read_ncount(src, srcn, norm, &max_symbol, t->max_log,
+				    &log);
+		if (n < 0 || fse_build(t->entries, norm, max_symbol, log))
+			return -1;
+		t->log = log;
+		return n;
+	default:
+		/* Repeat mode reuses the table of the previous block. */
+		return t->log < 0 ? -1 : 0;
+	}
+}
+
+/* Decodes the FSE compressed Huffman weights. Returns the number of weights,
+ * or < 0 on error. */
+static int huf_decode_weights(const uint8_t *src, size_t srcn,
+			      uint8_t *weights)
+{
+	struct fse_entry entries[1 << HUF_WEIGHT_LOG];
+	int16_t norm[16];
+	int max_symbol = ARRAY_SIZE(norm) - 1;
+	struct bitrev b;
+	uint32_t state1, state2;
+	int log, hdr, n = 0;
+
+	hdr = fse_read_ncount(src, srcn, norm, &max_symbol, HUF_WEIGHT_LOG,
+			      &log);
+	if (hdr < 0 || fse_build(entries, norm, max_symbol, log))
+		return -1;
+
+	if (bitrev_init(&b, src + hdr, srcn - hdr))
+		return -1;
+
+	state1 = bitrev_read(&b, log);
+	state2 = bitrev_read(&b, log);
+
+	/* The two interleaved states take turns until one of them runs past
+	 * the start of the stream, then the other one emits its last symbol. */
+	while (1) {
+		if (n >= HUF_MAX_SYMBOLS - 2)
+			return -1;
+		weights[n++] = entries[state1].symbol;
+		fse_update(entries, &state1, &b);
+		if (b.pos < 0) {
+			weights[n++] = entries[state2].symbol;
+			break;
+		}
+
+		weights[n++] = entries[state2].symbol;
+		fse_update(entries, &state2, &b);
+		if (b.pos < 0) {
+			weights[n++] = entries[state1].symbol;
+			break;
+		}
+	}
+
+	return n;
+}
+
+/* Reads a Huffman tree description. Returns the number of input bytes used,
+ * or < 0 on error. */
+static int huf_read_table(struct zstd_workspace *ws, const uint8_t *src,
+			  size_t srcn)
+{
+	uint8_t weights[HUF_MAX_SYMBOLS];
+	uint32_t sum = 0, rest;
+	int n, i, s, w, max_bits, used, pos = 0;
+
+	if (srcn < 1)
+		return -1;
+
+	if (src[0] >= 128) {
+		/* Weights stored directly, 4 bits each. */
+		n = src[0] - 127;
+		used = 1 + (n + 1) / 2;
+		if ((size_t)used > srcn)
+			return -1;
+		for (i = 0; i < n; i++) {
+			uint8_t byte = src[1 + i / 2];
+
+			weights[i] = (i & 1) ? byte & 0xf : byte >> 4;
+		}
+	} else {
+		used = 1 + src[0];
+		if ((size_t)used > srcn)
+			return -1;
+		n = huf_decode_weights(src + 1, src[0], weights);
+		if (n < 0)
+			return -1;
+	}
+
+	if (n >= HUF_MAX_SYMBOLS)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		if (weights[i] > HUF_MAX_BITS)
+			return -1;
+		if (weights[i])
+			sum += 1 << (weights[i] - 1);
+	}
+
+	if (sum == 0)
+		return -1;
+
+	/* The weight of the last symbol is implied by filling up the sum to
+	 * the next power of two. */
+	max_bits = highbit(sum) + 1;
+	if (max_bits > HUF_MAX_BITS)
+		return -1;
+	rest = (1 << max_bits) - sum;
+	if (rest & (rest - 1))
+		return -1;
+	weights[n++] = highbit(rest) + 1;
+
+	for (w = 1; w <= max_bits; w++) {
+		for (s = 0; s < n; s++) {
+			uint16_t e = s << 8 | (max_bits + 1 - w);
+
+			if (weights[s] != w)
+				continue;
+			for (i = 0; i < 1 << (w - 1); i++)
+				ws->huf[pos++] = e;
+		}
+	}
+
+	ws->huf_bits = max_bits;
+	return used;
+}
+
+static int huf_decode_stream(const struct zstd_workspace *ws,
+			     const uint8_t *src, size_t srcn, uint8_t *dst,
+			     size_t dstn)
+{
+	/* Stores to dst may alias ws, so keep the table in locals. */
+	const uint16_t *huf = ws->huf;
+	const int huf_bits = ws->huf_bits;
+	struct bitrev b;
+	size_t i;
+
+	if (bitrev_init(&b, src, srcn))
+		return -1;
+
+	for (i = 0; i < dstn; i++) {
+		uint16_t e = huf[bitrev_peek(&b, huf_bits)];
+
+		dst[i] = e >> 8;
+		b.pos -= e & 0xff;
+	}
+
+	/* The stream has to be used up exactly. */
+	return b.pos == 0 ? 0 : -1;
+}
+
+struct literals {
+	const uint8_t *ptr;
+	const uint8_t *end;
+	int in_dst;		/* decoded into the end of the output buffer */
+};
+
+/* Decodes the literals section of a compressed block. Literals that need
+ * decoding are placed at the very end of the output buffer. Returns the
+ * number of input bytes used, or < 0 on error. */
+static int decode_literals(struct zstd_workspace *ws, const uint8_t *src,
+			   size_t srcn, uint8_t *op, uint8_t *oend,
+			   struct literals *lit)
+{
+	const int type = src[0] & 3;
+	const int format = (src[0] >> 2) & 3;
+	size_t hdr, regen, comp, streams, used;
+	uint64_t v;
+	uint8_t *buf;
+
+	if (type == LITERALS_RAW || type == LITERALS_RLE) {
+		hdr = (format & 1) ? (format >> 1) + 2 : 1;
+		if (srcn < hdr)
+			return -1;
+		v = read_bits_le(src, hdr, 0);
+		regen = (format & 1) ? v >> 4 : v >> 3;
+
+		if (type == LITERALS_RAW) {
+			if (regen > srcn - hdr)
+				return -1;
+			lit->ptr = src + hdr;
+			lit->end = lit->ptr + regen;
+			lit->in_dst = 0;
+			return hdr + regen;
+		}
+
+		if (srcn < hdr + 1 || regen > (size_t)(oend - op))
+			return -1;
+		buf = oend - regen;
+		memset(buf, src[hdr], regen);
+		lit->ptr = buf;
+		lit->end = oend;
+		lit->in_dst = 1;
+		return hdr + 1;
+	}
+
+	hdr = format < 2 ? 3 : format + 2;
+	if (srcn < hdr)
+		return -1;
+	v = read_bits_le(src, hdr, 0) | (uint64_t)(hdr == 5 ? src[4] : 0) << 32;
+	streams = format == 0 ? 1 : 4;
+	regen = (v >> 4) & ((1 << (hdr * 4 - 2)) - 1);
+	comp = (v >> (hdr * 4 + 2)) & ((1 << (hdr * 4 - 2)) - 1);
+
+	if (comp > srcn - hdr || regen > (size_t)(oend - op))
+		return -1;
+	used = hdr + comp;
+	src += hdr;
+
+	if (type == LITERALS_COMPRESSED) {
+		int n = huf_read_table(ws, src, comp);
+
+		if (n < 0)
+			return -1;
+		src += n;
+		comp -= n;
+	} else if (ws->huf_bits == 0) {
+		return -1;
+	}
+
+	buf = oend - regen;
+	if (streams == 1) {
+		if (huf_decode_stream(ws, src, comp, buf, regen))
+			return -1;
+	} else {
+		size_t sizes[4], seg = (regen + 3) / 4;
+		int i;
+
+		if (comp < 6 || 3 * seg > regen)
+			return -1;
+		sizes[0] = read_le16(src);
+		sizes[1] = read_le16(src + 2);
+		sizes[2] = read_le16(src + 4);
+		if (sizes[0] + sizes[1] + sizes[2] > comp - 6)
+			return -1;
+		sizes[3] = comp - 6 - sizes[0] - sizes[1] - sizes[2];
+		src += 6;
+
+		for (i = 0; i < 4; i++) {
+			size_t n = i < 3 ? seg : regen - 3 * seg;
+
+			if (huf_decode_stream(ws, src, sizes[i], buf + i * seg,
+					      n))
+				return -1;
+			src += sizes[i];
+		}
+	}
+
+	lit->ptr = buf;
+	lit->end = oend;
+	lit->in_dst = 1;
+	return used;
+}
+
+static uint32_t resolve_offset(struct zstd_workspace *ws, uint32_t value,
+			       uint32_t ll)
+{
+	uint32_t offset;
+	int idx;
+
+	if (value > 3) {
+		offset = value - 3;
+		ws->rep[2] = ws->rep[1];
+		ws->rep[1] = ws->rep[0];
+		ws->rep[0] = offset;
+		return offset;
+	}
+
+	/* Repeat offsets are shifted by one if there are no literals. */
+	idx = value - 1 + (ll == 0);
+	if (idx == 0)
+		return ws->rep[0];
+
+	offset = idx == 3 ? ws->rep[0] - 1 : ws->rep[idx];
+	if (idx != 1)
+		ws->rep[2] = ws->rep[1];
+	ws->rep[1] = ws->rep[0];
+	ws->rep[0] = offset;
+	return offset;
+}
+
+/* Copies the given number of literals to op. Returns < 0 on error. */
+static int copy_literals(struct literals *lit, size_t n, uint8_t **op,
+			 uint8_t *oend)
+{
+	if (n > (size_t)(lit->end - lit->ptr) || n > (size_t)(oend - *op))
+		return -1;
+
+	/* Literals decoded into the output buffer are never behind op, but
+	 * can overlap with the bytes about to be written. */
+	memmove(*op, lit->ptr, n);
+	*op += n;
+	lit->ptr += n;
+	return 0;
+}
+
+static int decode_block(struct zstd_workspace *ws, const uint8_t *src,
+			size_t srcn, uint8_t *dst, uint8_t **opp, uint8_t *oend)
+{
+	const uint8_t *ip = src, *iend = src + srcn;
+	struct literals lit;
+	struct bitrev b;
+	uint32_t nseq, ll_state, ml_state, of_state;
+	uint8_t *op = *opp;
+	int n, modes;
+
+	if (srcn < 1)
+		return -1;
+	n = decode_literals(ws, ip, srcn, op, oend, &lit);
+	if (n < 0)
+		return -1;
+	ip += n;
+
+	if (ip >= iend)
+		return -1;
+	nseq = *ip++;
+	if (nseq == 255) {
+		if (iend - ip < 2)
+			return -1;
+		nseq = read_le16(ip) + 0x7f00;
+		ip += 2;
+	} else if (nseq >= 128) {
+		if (iend - ip < 1)
+			return -1;
+		nseq = ((nseq - 128) << 8) + *ip++;
+	}
+
+	if (nseq == 0) {
+		if (ip != iend)
+			return -1;
+		if (copy_literals(&lit, lit.end - lit.ptr, &op, oend))
+			return -1;
+		*opp = op;
+		return 0;
+	}
+
+	if (ip >= iend)
+		return -1;
+	modes = *ip++;
+	if (modes & 3)
+		return -1;
+
+	n = fse_table_setup(&ws->ll, modes >> 6, ip, iend - ip);
+	if (n < 0)
+		return -1;
+	ip += n;
+	n = fse_table_setup(&ws->of, (modes >> 4) & 3, ip, iend - ip);
+	if (n < 0)
+		return -1;
+	ip += n;
+	n = fse_table_setup(&ws->ml, (modes >> 2) & 3, ip, iend - ip);
+	if (n < 0)
+		return -1;
+	ip += n;
+
+	if (bitrev_init(&b, ip, iend - ip))
+		return -1;
+
+	ll_state = bitrev_read(&b, ws->ll.log);
+	of_state = bitrev_read(&b, ws->of.log);
+	ml_state = bitrev_read(&b, ws->ml.log);
+
+	while (nseq--) {
+		const uint8_t ll_code = ws->ll.entries[ll_state].symbol;
+		const uint8_t ml_code = ws->ml.entries[ml_state].symbol;
+		const uint8_t of_code = ws->of.entries[of_state].symbol;
+		uint32_t value, offset, ml, ll;
+		const uint8_t *limit;
+		uint8_t *match;
+
+		value = (1U << of_code) + bitrev_read(&b, of_code);
+		ml = ml_base[ml_code] + bitrev_read(&b, ml_bits[ml_code]);
+		ll = ll_base[ll_code] + bitrev_read(&b, ll_bits[ll_code]);
+		offset = resolve_offset(ws, value, ll);
+
+		if (nseq) {
+			fse_update(ws->ll.entries, &ll_state, &b);
+			fse_update(ws->ml.entries, &ml_state, &b);
+			fse_update(ws->of.entries, &of_state, &b);
+		}
+
+		if (copy_literals(&lit, ll, &op, oend))
+			return -1;
+
+		/* Matches must neither reach before the start of the frame nor
+		 * overwrite literals that are still to be copied. */
+		limit = lit.in_dst ? lit.ptr : oend;
+		if (offset == 0 || offset > (size_t)(op - dst) ||
+		    ml > (size_t)(limit - op))
+			return -1;
+
+		match = op - offset;
+		if (offset >= ml) {
+			memcpy(op, match, ml);
+			op += ml;
+		} else {
+			while (ml--)
+				*op++ = *match++;
+		}
+	}
+
+	if (b.pos != 0)
+		return -1;
+
+	if (copy_literals(&lit, lit.end - lit.ptr, &op, oend))
+		return -1;
+
+	*opp = op;
+	return 0;
+}
+
+static void workspace_init(struct zstd_workspace *ws)
+{
+	ws->huf_bits = 0;
+
+	ws->ll.entries = ws->ll_entries;
+	ws->ll.log = -1;
+	ws->ll.max_log = LL_MAX_LOG;
+	ws->ll.max_symbol = LL_MAX_SYMBOL;
+	ws->ll.default_norm = ll_default_norm;
+	ws->ll.default_max_symbol = ARRAY_SIZE(ll_default_norm) - 1;
+	ws->ll.default_log = 6;
+
+	ws->ml.entries = ws->ml_entries;
+	ws->ml.log = -1;
+	ws->ml.max_log = ML_MAX_LOG;
+	ws->ml.max_symbol = ML_MAX_SYMBOL;
+	ws->ml.default_norm = ml_default_norm;
+	ws->ml.default_max_symbol = ARRAY_SIZE(ml_default_norm) - 1;
+	ws->ml.default_log = 6;
+
+	ws->of.entries = ws->of_entries;
+	ws->of.log = -1;
+	ws->of.max_log = OF_MAX_LOG;
+	ws->of.max_symbol = OF_MAX_SYMBOL;
+	ws->of.default_norm = of_default_norm;
+	ws->of.default_max_symbol = ARRAY_SIZE(of_default_norm) - 1;
+	ws->of.default_log = 5;
+
+	ws->rep[0] = 1;
+	ws->rep[1] = 4;
+	ws->rep[2] = 8;
+}
+
+static size_t decompress_frame(struct zstd_workspace *ws, const uint8_t *src,
+			       size_t srcn, uint8_t *dst, size_t dstn)
+{
+	static const uint8_t dict_id_sizes[] = { 0, 1, 2, 4 };
+	static const uint8_t content_size_sizes[] = { 0, 2, 4, 8 };
+	const uint8_t *ip = src, *iend = src + srcn;
+	uint8_t *op = dst, *oend = dst + dstn;
+	uint64_t content_size = 0;
+	size_t dict_id_size, content_size_size, i;
+	int single_segment, has_checksum, has_content_size;
+	uint8_t fhd;
+
+	/* Skippable frames may precede the actual one. */
+	while (iend - ip >= 8 && (read_le32(ip) & ZSTD_SKIPPABLE_MASK) ==
+				 ZSTD_SKIPPABLE_MAGIC) {
+		uint32_t size = read_le32(ip + 4);
+
+		if (size > (size_t)(iend - ip) - 8)
+			return 0;
+		ip += 8 + size;
+	}
+
+	if (iend - ip < 5 || read_le32(ip) != ZSTD_MAGIC)
+		return 0;
+	ip += 4;
+
+	fhd = *ip++;
+	single_segment = (fhd >> 5) & 1;
+	has_checksum = (fhd >> 2) & 1;
+	dict_id_size = dict_id_sizes[fhd & 3];
+	content_size_size = content_size_sizes[fhd >> 6];
+	if (content_size_size == 0 && single_segment)
+		content_size_size = 1;
+	has_content_size = content_size_size != 0;
+
+	if (fhd & 0x08)
+		return 0;
+	if ((size_t)(iend - ip) < !single_segment + dict_id_size +
+				  content_size_size)
+		return 0;
+
+	/* The window size doesn't matter when decoding in one go. */
+	if (!single_segment)
+		ip++;
+
+	/* Dictionaries are not supported. */
+	for (i = 0; i < dict_id_size; i++)
+		if (*ip++)
+			return 0;
+
+	for (i = 0; i < content_size_size; i++)
+		content_size |= (uint64_t)*ip++ << (8 * i);
+	if (content_size_size == 2)
+		content_size += 256;
+
+	if (has_content_size && content_size > dstn)
+		return 0;
+
+	workspace_init(ws);
+
+	while (1) {
+		uint32_t header, size;
+		int last, type;
+
+		if (iend - ip < 3)
+			return 0;
+		header = ip[0] | ip[1] << 8 | ip[2] << 16;
+		ip += 3;
+		last = header & 1;
+		type = (header >> 1) & 3;
+		size = header >> 3;
+
+		switch (type) {
+		case BLOCK_RAW:
+			if (size > (size_t)(iend - ip) ||
+			    size > (size_t)(oend - op))
+				return 0;
+			memcpy(op, ip, size);
+			op += size;
+			ip += size;
+			break;
+		case BLOCK_RLE:
+			if (iend - ip < 1 || size > (size_t)(oend - op))
+				return 0;
+			memset(op, *ip, size);
+			op += size;
+			ip += 1;
+			break;
+		case BLOCK_COMPRESSED:
+			if (size > ZSTD_BLOCK_SIZE_MAX ||
+			    size > (size_t)(iend - ip))
+				return 0;
+			if (decode_block(ws, ip, size, dst, &op, oend))
+				return 0;
+			ip += size;
+			break;
+		default:
+			return 0;
+		}
+
+		if (last)
+			break;
+	}
+
+	/* The content checksum is not verified. */
+	if (has_checksum && iend - ip < 4)
+		return 0;
+
+	if (has_content_size && (size_t)(op - dst) != content_size)
+		return 0;
+
+	return op - dst;
+}
+
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	MAYBE_STATIC struct zstd_workspace ws;
+
+	return decompress_frame(&ws, src, srcn, dst, dstn);
+}
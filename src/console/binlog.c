@@ -0,0 +1,414 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/early_variables.h>
+#include <cbmem.h>
+#include <commonlib/binlog_serialized.h>
+#include <commonlib/helpers.h>
+#include <console/binlog.h>
+#include <console/console.h>
+#include <string.h>
+
+/*
+ * Binary printk log. Instead of formatting messages, do_printk() stores the
+ * format string once and a compact record of the raw arguments for every
+ * message. util/cbmem formats the records. See binlog_serialized.h for the
+ * layout.
+ */
+
+#define BINLOG_INDEX_BITS	10
+#define BINLOG_INDEX_ENTRIES	(1 << BINLOG_INDEX_BITS)
+#define BINLOG_STRINGS_SIZE	(CONFIG_CONSOLE_BINARY_LOG_SIZE / 4)
+#define BINLOG_MAX_RECORD	256
+#define BINLOG_EARLY_SIZE	CONFIG_CONSOLE_BINARY_LOG_EARLY_SIZE
+
+static struct binlog_header *binlog_p CAR_GLOBAL;
+
+/*
+ * Until CBMEM is up, records are kept in a small buffer with a pointer to
+ * their format string instead of a string table offset. The format strings
+ * belong to the running stage, so they are still there when the records are
+ * moved into CBMEM.
+ */
+struct binlog_early {
+	const char *fmt;
+	uint16_t size;		/* of the arguments that follow */
+	uint8_t level;
+	uint8_t flags;
+};
+
+static uintptr_t binlog_early_buf[BINLOG_EARLY_SIZE / sizeof(uintptr_t)]
+	CAR_GLOBAL;
+static size_t binlog_early_used CAR_GLOBAL;
+static uint32_t binlog_early_dropped CAR_GLOBAL;
+
+static void binlog_flush_early(struct binlog_header *log);
+
+static void binlog_reset(struct binlog_header *log, size_t size)
+{
+	log->magic = BINLOG_MAGIC;
+	log->long_size = sizeof(long);
+	log->index_offset = sizeof(*log);
+	log->index_entries = BINLOG_INDEX_ENTRIES;
+	log->strings_offset = log->index_offset +
+		BINLOG_INDEX_ENTRIES * sizeof(struct binlog_index_entry);
+	log->strings_size = BINLOG_STRINGS_SIZE;
+	log->strings_used = 0;
+	log->ring_offset = log->strings_offset + log->strings_size;
+	log->ring_size = size - log->ring_offset;
+	log->head = 0;
+	log->used = 0;
+	log->dropped = 0;
+
+	memset((void *)log + log->index_offset, 0,
+	       BINLOG_INDEX_ENTRIES * sizeof(struct binlog_index_entry));
+}
+
+static void binlog_init(int is_recovery)
+{
+	const size_t size = CONFIG_CONSOLE_BINARY_LOG_SIZE;
+	struct binlog_header *log;
+
+	/* Romstage starts a new log on every boot, later stages add to it. */
+	log = cbmem_find(CBMEM_ID_BINLOG);
+	if (log == NULL || ENV_ROMSTAGE) {
+		if (log == NULL)
+			log = cbmem_add(CBMEM_ID_BINLOG, size);
+		if (log == NULL) {
+			printk(BIOS_ERR, "ERROR: No binary log in cbmem.\n");
+			return;
+		}
+		binlog_reset(log, size);
+	}
+
+	binlog_flush_early(log);
+	car_set_var(binlog_p, log);
+}
+
+ROMSTAGE_CBMEM_INIT_HOOK(binlog_init)
+POSTCAR_CBMEM_INIT_HOOK(binlog_init)
+RAMSTAGE_CBMEM_INIT_HOOK(binlog_init)
+
+/* Returns the string table offset of fmt, adding it if needed, or < 0 if the
+ * string table is full. */
+static int binlog_string(struct binlog_header *log, const char *fmt)
+{
+	struct binlog_index_entry *index = (void *)log + log->index_offset;
+	char *strings = (char *)log + log->strings_offset;
+	uint32_t addr = (uintptr_t)fmt;
+	uint32_t hash = (addr * 2654435761U) >> (32 - BINLOG_INDEX_BITS);
+	struct binlog_index_entry *e;
+	size_t len, i;
+
+	/* Format strings are looked up by address, but compared in full so
+	 * that different stages or non-constant formats can't mix them up.
+	 * Collisions probe the following entries. */
+	for (i = 0; i < BINLOG_INDEX_ENTRIES; i++) {
+		e = &index[(hash + i) % BINLOG_INDEX_ENTRIES];
+		if (!e->fmt_offset)
+			break;
+		if (e->fmt_addr == addr &&
+		    !strcmp(strings + e->fmt_offset - 1, fmt))
+			return e->fmt_offset - 1;
+	}
+
+	/* Without an index entry the string would be added again and again. */
+	if (i == BINLOG_INDEX_ENTRIES)
+		return -1;
+
+	len = strlen(fmt) + 1;
+	if (len > log->strings_size - log->strings_used)
+		return -1;
+
+	memcpy(strings + log->strings_used, fmt, len);
+	e->fmt_addr = addr;
+	e->fmt_offset = log->strings_used + 1;
+	log->strings_used += len;
+
+	return e->fmt_offset - 1;
+}
+
+static int put(uint8_t *buf, size_t *pos, const void *data, size_t len)
+{
+	if (len > BINLOG_MAX_RECORD - *pos)
+		return -1;
+
+	memcpy(buf + *pos, data, len);
+	*pos += len;
+	return 0;
+}
+
+static int put_string(uint8_t *buf, size_t *pos, const char *s)
+{
+	size_t len = strnlen(s, BINLOG_MAX_RECORD - *pos);
+
+	if (len == BINLOG_MAX_RECORD - *pos) {
+		/* Keep what fits, but still terminate the string. */
+		if (len > 0)
+			put(buf, pos, s, len - 1);
+		buf[(*pos)++] = '\0';
+		return -1;
+	}
+
+	return put(buf, pos, s, len + 1);
+}
+
+/* Packs the arguments fmt consumes the same way vtxprintf() does. Returns
+ * < 0 if they didn't all fit. */
+static int binlog_pack_args(uint8_t *buf, size_t *pos, const char *fmt,
+			    va_list args)
+{
+	unsigned long long ll;
+	unsigned long l;
+	unsigned int i;
+	const char *s;
+	int qualifier;
+
+	for (; *fmt; fmt++) {
+		if (*fmt != '%')
+			continue;
+
+		fmt++;
+		while (*fmt == '-' || *fmt == '+' || *fmt == ' ' ||
+		       *fmt == '#' || *fmt == '0')
+			fmt++;
+
+		if (*fmt == '*') {
+			fmt++;
+			i = va_arg(args, int);
+			if (put(buf, pos, &i, sizeof(i)))
+				return -1;
+		}
+		while (*fmt >= '0' && *fmt <= '9')
+			fmt++;
+
+		if (*fmt == '.') {
+			fmt++;
+			if (*fmt == '*') {
+				fmt++;
+				i = va_arg(args, int);
+				if (put(buf, pos, &i, sizeof(i)))
+					return -1;
+			}
+			while (*fmt >= '0' && *fmt <= '9')
+				fmt++;
+		}
+
+		qualifier = -1;
+		if (*fmt == 'h' || *fmt == 'l' || *fmt == 'L' || *fmt == 'z') {
+			qualifier = *fmt;
+			++fmt;
+			if (*fmt == 'l') {
+				qualifier = 'L';
+				++fmt;
+			}
+			if (*fmt == 'h') {
+				qualifier = 'H';
+				++fmt;
+			}
+		}
+
+		switch (*fmt) {
+		case 'c':
+			i = va_arg(args, int);
+			if (put(buf, pos, &i, sizeof(i)))
+				return -1;
+			break;
+
+		case 's':
+			s = va_arg(args, const char *);
+			if (put_string(buf, pos, s ? s : "<NULL>"))
+				return -1;
+			break;
+
+		case 'p':
+			l = (unsigned long)va_arg(args, void *);
+			if (put(buf, pos, &l, sizeof(l)))
+				return -1;
+			break;
+
+		case 'n':
+			(void)va_arg(args, void *);
+			break;
+
+		case 'o':
+		case 'X':
+		case 'x':
+		case 'd':
+		case 'i':
+		case 'u':
+			if (qualifier == 'L') {
+				ll = va_arg(args, unsigned long long);
+				if (put(buf, pos, &ll, sizeof(ll)))
+					return -1;
+			} else if (qualifier == 'l' || qualifier == 'z') {
+				l = va_arg(args, unsigned long);
+				if (put(buf, pos, &l, sizeof(l)))
+					return -1;
+			} else {
+				i = va_arg(args, unsigned int);
+				if (put(buf, pos, &i, sizeof(i)))
+					return -1;
+			}
+			break;
+
+		case '\0':
+			return 0;
+
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void ring_read(const struct binlog_header *log, uint32_t offset,
+		      void *dst, size_t len)
+{
+	const uint8_t *ring = (const void *)log + log->ring_offset;
+	size_t first = MIN(len, log->ring_size - offset);
+
+	memcpy(dst, ring + offset, first);
+	memcpy(dst + first, ring, len - first);
+}
+
+static void ring_write(struct binlog_header *log, uint32_t offset,
+		       const void *src, size_t len)
+{
+	uint8_t *ring = (void *)log + log->ring_offset;
+	size_t first = MIN(len, log->ring_size - offset);
+
+	memcpy(ring + offset, src, first);
+	memcpy(ring, src + first, len - first);
+}
+
+static void binlog_push(struct binlog_header *log, const void *rec,
+			size_t size)
+{
+	uint32_t tail;
+	uint16_t old;
+
+	if (size > log->ring_size)
+		return;
+
+	/* Drop the oldest records until the new one fits. */
+	while (log->ring_size - log->used < size) {
+		ring_read(log, log->head, &old, sizeof(old));
+		log->head = (log->head + old) % log->ring_size;
+		log->used -= old;
+		log->dropped++;
+	}
+
+	tail = (log->head + log->used) % log->ring_size;
+	ring_write(log, tail, rec, size);
+	log->used += size;
+}
+
+/* Adds a record for fmt with the packed arguments to the log. */
+static void binlog_emit(struct binlog_header *log, int msg_level,
+			const char *fmt, const uint8_t *args, size_t len,
+			int flags)
+{
+	uint8_t buf[BINLOG_MAX_RECORD];
+	struct binlog_record *rec = (void *)buf;
+	size_t pos = sizeof(*rec);
+	int offset;
+
+	rec->level = msg_level;
+	rec->flags = flags;
+	rec->fmt = 0;
+
+	offset = binlog_string(log, fmt);
+	if (offset >= 0) {
+		rec->fmt = offset;
+	} else {
+		rec->flags |= BINLOG_RECORD_INLINE;
+		if (put_string(buf, &pos, fmt))
+			rec->flags |= BINLOG_RECORD_TRUNCATED;
+	}
+
+	/* Keep whatever arguments fit after an inline format string. */
+	if (len > BINLOG_MAX_RECORD - pos) {
+		len = BINLOG_MAX_RECORD - pos;
+		rec->flags |= BINLOG_RECORD_TRUNCATED;
+	}
+	put(buf, &pos, args, len);
+
+	rec->size = pos;
+	binlog_push(log, buf, pos);
+}
+
+static void binlog_stage_early(int msg_level, const char *fmt,
+			       const uint8_t *args, size_t len, int flags)
+{
+	uint8_t *early = car_get_var_ptr(binlog_early_buf);
+	size_t used = car_get_var(binlog_early_used);
+	struct binlog_early *e = (void *)(early + used);
+	const size_t size = ALIGN_UP(sizeof(*e) + len, sizeof(void *));
+
+	/* Unlike the ring, this keeps the oldest messages. */
+	if (size > sizeof(binlog_early_buf) - used) {
+		car_set_var(binlog_early_dropped,
+			    car_get_var(binlog_early_dropped) + 1);
+		return;
+	}
+
+	e->fmt = fmt;
+	e->size = len;
+	e->level = msg_level;
+	e->flags = flags;
+	memcpy(e + 1, args, len);
+	car_set_var(binlog_early_used, used + size);
+}
+
+static void binlog_flush_early(struct binlog_header *log)
+{
+	uint8_t *early = car_get_var_ptr(binlog_early_buf);
+	size_t used = car_get_var(binlog_early_used);
+	size_t pos = 0;
+
+	while (pos < used) {
+		const struct binlog_early *e = (void *)(early + pos);
+
+		binlog_emit(log, e->level, e->fmt, (const void *)(e + 1),
+			    e->size, e->flags);
+		pos += ALIGN_UP(sizeof(*e) + e->size, sizeof(void *));
+	}
+
+	log->dropped += car_get_var(binlog_early_dropped);
+	car_set_var(binlog_early_used, 0);
+	car_set_var(binlog_early_dropped, 0);
+}
+
+void binlog_vprintk(int msg_level, const char *fmt, va_list args)
+{
+	struct binlog_header *log = car_get_var(binlog_p);
+	uint8_t buf[BINLOG_MAX_RECORD];
+	/* Leave room for the record header, which bounds the arguments the
+	 * same way for both paths. */
+	size_t pos = sizeof(struct binlog_record);
+	int flags = 0;
+
+	if (binlog_pack_args(buf, &pos, fmt, args))
+		flags |= BINLOG_RECORD_TRUNCATED;
+
+	pos -= sizeof(struct binlog_record);
+	if (log != NULL)
+		binlog_emit(log, msg_level, fmt,
+			    buf + sizeof(struct binlog_record), pos, flags);
+	else
+		binlog_stage_early(msg_level, fmt,
+				   buf + sizeof(struct binlog_record), pos,
+				   flags);
+}
@@ -16,6 +16,7 @@
 
 #include <arch/io.h>
 #include <console/console.h>
+#include <console/uart.h>
 #include <halt.h>
 
 #ifndef __ROMCC__
@@ -25,6 +26,7 @@
 void NORETURN die(const char *msg)
 {
 	printk(BIOS_EMERG, "%s", msg);
+	__uart_drain();
 	halt();
 }
 #endif
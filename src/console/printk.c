@@ -17,6 +17,8 @@
  * blatantly copied from linux/kernel/printk.c
  */
 
+#include <console/binlog.h>
+#include <console/cbmem_console.h>
 #include <console/console.h>
 #include <console/streams.h>
 #include <console/vtxprintf.h>
@@ -29,6 +31,18 @@
 DECLARE_SPIN_LOCK(console_lock)
 #endif
 
+#if IS_ENABLED(CONFIG_CONSOLE_CBMEM_PER_CPU) && ENV_RAMSTAGE
+void console_lock_acquire(void)
+{
+	spin_lock(&console_lock);
+}
+
+void console_lock_release(void)
+{
+	spin_unlock(&console_lock);
+}
+#endif
+
 void do_putchar(unsigned char byte)
 {
 	console_tx_byte(byte);
@@ -42,9 +56,12 @@ static void wrap_putchar(unsigned char byte, void *data)
 int do_printk(int msg_level, const char *fmt, ...)
 {
 	va_list args;
-	int i;
+	int i = 0;
+	int text, binary;
 
-	if (!console_log_level(msg_level))
+	text = console_log_level(msg_level);
+	binary = binlog_log_level(msg_level);
+	if (!text && !binary)
 		return 0;
 
 #if IS_ENABLED (CONFIG_SQUELCH_EARLY_SMP) && defined(__PRE_RAM__)
@@ -53,6 +70,25 @@ int do_printk(int msg_level, const char *fmt, ...)
 #endif
 
 	DISABLE_TRACE;
+
+	/*
+	 * APs doing parallel work don't contend for the console lock. Errors
+	 * still go out right away, die() relies on that.
+	 */
+	if (msg_level > BIOS_ERR && cbmemc_cpu_console_active()) {
+		if (text) {
+			va_start(args, fmt);
+			i = cbmemc_cpu_vprintk(fmt, args);
+			va_end(args);
+		}
+		/* Negative once the buffers got merged, print directly. */
+		if (i >= 0) {
+			ENABLE_TRACE;
+			return i;
+		}
+		i = 0;
+	}
+
 #ifdef __PRE_RAM__
 #if IS_ENABLED(CONFIG_HAVE_ROMSTAGE_CONSOLE_SPINLOCK)
 	spin_lock(romstage_console_lock());
@@ -61,11 +97,19 @@ int do_printk(int msg_level, const char *fmt, ...)
 	spin_lock(&console_lock);
 #endif
 
-	va_start(args, fmt);
-	i = vtxprintf(wrap_putchar, fmt, args, NULL);
-	va_end(args);
+	if (binary) {
+		va_start(args, fmt);
+		binlog_vprintk(msg_level, fmt, args);
+		va_end(args);
+	}
 
-	console_tx_flush();
+	if (text) {
+		va_start(args, fmt);
+		i = vtxprintf(wrap_putchar, fmt, args, NULL);
+		va_end(args);
+
+		console_tx_flush();
+	}
 
 #ifdef __PRE_RAM__
 #if IS_ENABLED(CONFIG_HAVE_ROMSTAGE_CONSOLE_SPINLOCK)
@@ -82,6 +126,14 @@ int do_printk(int msg_level, const char *fmt, ...)
 #if IS_ENABLED (CONFIG_VBOOT)
 void do_printk_va_list(int msg_level, const char *fmt, va_list args)
 {
+	va_list copy;
+
+	if (binlog_log_level(msg_level)) {
+		va_copy(copy, args);
+		binlog_vprintk(msg_level, fmt, copy);
+		va_end(copy);
+	}
+
 	if (!console_log_level(msg_level))
 		return;
 	vtxprintf(wrap_putchar, fmt, args, NULL);
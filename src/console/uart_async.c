@@ -0,0 +1,142 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <bootstate.h>
+#include <console/console.h>
+#include <console/uart.h>
+#include <smp/spinlock.h>
+#include <stdint.h>
+#include <thread.h>
+
+/*
+ * Buffered UART console. console_tx_byte() only queues bytes in a ring, a
+ * cooperative thread moves them into the UART FIFO whenever the main thread
+ * waits in udelay() or is blocked. The ring has a single producer, as
+ * printk() holds the console lock. The drain thread and a die() on an AP
+ * both consume, so consumers take drain_lock.
+ */
+
+#define RING_SIZE	CONFIG_CONSOLE_SERIAL_ASYNC_BUFFER_SIZE
+/* How long the drain thread lets the main thread run between refills. */
+#define DRAIN_INTERVAL_US	100
+
+DECLARE_SPIN_LOCK(drain_lock)
+
+static u8 ring[RING_SIZE];
+/* Only written by the consumer. */
+static volatile size_t ring_head;
+/* Only written by the producer. */
+static volatile size_t ring_tail;
+static volatile int drain_stop;
+/* Cleared once the ring is drained for good, bytes are sent directly then. */
+static volatile int async_enabled = 1;
+static uint32_t dropped;
+
+void uart_async_tx_byte(u8 data)
+{
+	size_t next;
+
+	if (!async_enabled) {
+		uart_tx_byte(CONFIG_UART_FOR_CONSOLE, data);
+		return;
+	}
+
+	next = (ring_tail + 1) % RING_SIZE;
+	if (next == ring_head) {
+		dropped++;
+		return;
+	}
+
+	ring[ring_tail] = data;
+	/* Publish the byte before moving the tail. */
+	barrier();
+	ring_tail = next;
+}
+
+/* Only fills the room left in the UART, so this never waits on it. */
+static void uart_async_send(void)
+{
+	unsigned int room;
+	size_t head;
+
+	spin_lock(&drain_lock);
+
+	head = ring_head;
+	room = async_enabled ? uart_tx_room(CONFIG_UART_FOR_CONSOLE) : 0;
+	while (head != ring_tail && room--) {
+		uart_tx_byte(CONFIG_UART_FOR_CONSOLE, ring[head]);
+		head = (head + 1) % RING_SIZE;
+		ring_head = head;
+	}
+
+	spin_unlock(&drain_lock);
+}
+
+void uart_async_drain(void)
+{
+	size_t head;
+
+	spin_lock(&drain_lock);
+
+	if (!async_enabled) {
+		spin_unlock(&drain_lock);
+		return;
+	}
+
+	for (head = ring_head; head != ring_tail;
+	     head = (head + 1) % RING_SIZE)
+		uart_tx_byte(CONFIG_UART_FOR_CONSOLE, ring[head]);
+	ring_head = head;
+	uart_tx_flush(CONFIG_UART_FOR_CONSOLE);
+	async_enabled = 0;
+
+	spin_unlock(&drain_lock);
+
+	if (dropped)
+		printk(BIOS_WARNING, "UART: %u bytes dropped, ring full.\n",
+		       dropped);
+}
+
+static void uart_async_thread(void *unused)
+{
+	while (!drain_stop) {
+		uart_async_send();
+		thread_yield_microseconds(DRAIN_INTERVAL_US);
+	}
+
+	uart_async_drain();
+}
+
+static void uart_async_start(void *unused)
+{
+	/* The thread blocks the payload handoff until the ring is empty. */
+	if (thread_run_until(uart_async_thread, NULL, BS_PAYLOAD_BOOT,
+			     BS_ON_ENTRY))
+		uart_async_drain();
+}
+
+static void uart_async_stop(void *unused)
+{
+	drain_stop = 1;
+}
+
+/* OS resume doesn't pass through BS_PAYLOAD_BOOT, drain right away. */
+static void uart_async_resume(void *unused)
+{
+	drain_stop = 1;
+	uart_async_drain();
+}
+
+BOOT_STATE_INIT_ENTRY(BS_PRE_DEVICE, BS_ON_ENTRY, uart_async_start, NULL);
+BOOT_STATE_INIT_ENTRY(BS_PAYLOAD_LOAD, BS_ON_EXIT, uart_async_stop, NULL);
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME, BS_ON_ENTRY, uart_async_resume, NULL);
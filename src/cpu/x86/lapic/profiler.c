@@ -0,0 +1,187 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <bootstate.h>
+#include <cbmem.h>
+#include <commonlib/lapic_profile_serialized.h>
+#include <console/console.h>
+#include <cpu/x86/lapic.h>
+#include <cpu/x86/lapic_profiler.h>
+#include <delay.h>
+#include <pc80/i8259.h>
+#include <string.h>
+#include <symbols.h>
+
+/*
+ * Sampling profiler for ramstage. The BSP's local APIC timer fires
+ * CONFIG_LAPIC_PROFILER_HZ times a second at LAPIC_PROFILER_VECTOR, the stub
+ * in c_start.S passes the interrupted instruction pointer on to
+ * lapic_profiler_sample() which counts it in a hash table in CBMEM.
+ */
+
+#define NUM_BUCKETS	CONFIG_LAPIC_PROFILER_BUCKETS
+/* Buckets looked at before a sample is dropped. */
+#define MAX_PROBES	16
+
+#if NUM_BUCKETS & (NUM_BUCKETS - 1)
+#error "CONFIG_LAPIC_PROFILER_BUCKETS must be a power of 2"
+#endif
+
+static struct lapic_profile_table *profile;
+static uint32_t timer_count;
+static int running;
+static int paused;
+
+void lapic_profiler_sample(uint32_t pc)
+{
+	struct lapic_profile_table *table = profile;
+	uint32_t i, index;
+
+	table->samples++;
+
+	index = (pc * 0x9e3779b1) >> 16;
+	for (i = 0; i < MAX_PROBES; i++) {
+		struct lapic_profile_bucket *b;
+
+		b = &table->buckets[(index + i) & (NUM_BUCKETS - 1)];
+		if (b->count == 0)
+			b->pc = pc;
+		if (b->pc == pc) {
+			b->count++;
+			break;
+		}
+	}
+	if (i == MAX_PROBES)
+		table->dropped++;
+
+	lapic_write(LAPIC_EOI, 0);
+}
+
+static inline void enable_interrupts(void)
+{
+	asm volatile ("sti" ::: "memory");
+}
+
+static inline void disable_interrupts(void)
+{
+	asm volatile ("cli" ::: "memory");
+}
+
+/* Timer ticks per millisecond, measured against udelay(). */
+static uint32_t lapic_timer_calibrate(void)
+{
+	lapic_write(LAPIC_LVTT, LAPIC_LVT_MASKED | LAPIC_PROFILER_VECTOR);
+	lapic_write(LAPIC_TDCR, LAPIC_TDR_DIV_16);
+	lapic_write(LAPIC_TMICT, 0xffffffff);
+	udelay(1000);
+	return 0xffffffff - lapic_read(LAPIC_TMCCT);
+}
+
+static void lapic_profiler_arm(void)
+{
+	lapic_write(LAPIC_LVTT, LAPIC_LVT_TIMER_PERIODIC |
+		    LAPIC_PROFILER_VECTOR);
+	lapic_write(LAPIC_TDCR, LAPIC_TDR_DIV_16);
+	lapic_write(LAPIC_TMICT, timer_count);
+}
+
+static void lapic_profiler_disarm(void)
+{
+	lapic_write(LAPIC_LVTT, LAPIC_LVT_MASKED | LAPIC_PROFILER_VECTOR);
+	lapic_write(LAPIC_TMICT, 0);
+	/* Take a tick that may already be pending on coreboot's IDT. */
+	enable_interrupts();
+	asm volatile ("nop");
+	disable_interrupts();
+}
+
+void lapic_profiler_pause(void)
+{
+	if (running && paused++ == 0)
+		lapic_profiler_disarm();
+}
+
+void lapic_profiler_resume(void)
+{
+	if (running && --paused == 0) {
+		lapic_profiler_arm();
+		enable_interrupts();
+	}
+}
+
+static void lapic_profiler_start(void *unused)
+{
+	uint32_t ticks_per_ms;
+
+	if (profile == NULL)
+		return;
+
+	/* The profiler's tick is the only interrupt expected in ramstage. */
+	pic_write_irq_mask(0xffff);
+
+	enable_lapic();
+	lapic_write(LAPIC_SPIV, lapic_read(LAPIC_SPIV) | LAPIC_SPIV_ENABLE);
+
+	ticks_per_ms = lapic_timer_calibrate();
+	timer_count = ticks_per_ms * 1000 / CONFIG_LAPIC_PROFILER_HZ;
+	if (timer_count == 0) {
+		printk(BIOS_ERR, "LAPIC profiler: timer too slow.\n");
+		return;
+	}
+
+	printk(BIOS_DEBUG, "LAPIC profiler: %u Hz, %u timer ticks/ms\n",
+	       CONFIG_LAPIC_PROFILER_HZ, ticks_per_ms);
+
+	running = 1;
+	lapic_profiler_arm();
+	enable_interrupts();
+}
+
+static void lapic_profiler_stop(void *unused)
+{
+	if (!running)
+		return;
+
+	lapic_profiler_disarm();
+	running = 0;
+
+	printk(BIOS_DEBUG, "LAPIC profiler: %u samples, %u dropped\n",
+	       profile->samples, profile->dropped);
+}
+
+static void lapic_profiler_init(int is_recovery)
+{
+	const size_t size = sizeof(struct lapic_profile_table) +
+		NUM_BUCKETS * sizeof(struct lapic_profile_bucket);
+	struct lapic_profile_table *table;
+
+	table = cbmem_add(CBMEM_ID_LAPIC_PROFILE, size);
+	if (table == NULL) {
+		printk(BIOS_ERR, "ERROR: No LAPIC profile table allocated\n");
+		return;
+	}
+
+	memset(table, 0, size);
+	table->hz = CONFIG_LAPIC_PROFILER_HZ;
+	table->program_base = (uintptr_t)_program;
+	table->num_buckets = NUM_BUCKETS;
+
+	profile = table;
+}
+
+RAMSTAGE_CBMEM_INIT_HOOK(lapic_profiler_init)
+
+BOOT_STATE_INIT_ENTRY(BS_PRE_DEVICE, BS_ON_ENTRY, lapic_profiler_start, NULL);
+/* Neither the payload nor the OS expect interrupts to be enabled. */
+BOOT_STATE_INIT_ENTRY(BS_PAYLOAD_BOOT, BS_ON_ENTRY, lapic_profiler_stop, NULL);
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME, BS_ON_ENTRY, lapic_profiler_stop, NULL);
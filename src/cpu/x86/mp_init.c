@@ -37,6 +37,7 @@
 #include <smp/spinlock.h>
 #include <symbols.h>
 #include <thread.h>
+#include <timestamp.h>
 
 #define MAX_APIC_IDS 256
 
@@ -134,11 +135,18 @@ static struct mp_flight_plan mp_info;
 struct cpu_map {
 	struct device *dev;
 	int apic_id;
+	/* timestamp_get() when the CPU reached ap_init(). */
+	uint64_t arrival;
+	/* Timestamp span covering the CPU's initialization. */
+	int span;
 };
 
 /* Keep track of APIC and device structure for each CPU. */
 static struct cpu_map cpus[CONFIG_MAX_CPUS];
 
+/* timestamp_get() right before the first SIPI was sent. */
+static uint64_t ap_start_time;
+
 inline void barrier_wait(atomic_t *b)
 {
 	while (atomic_read(b) == 0)
@@ -220,6 +228,8 @@ static void asmlinkage ap_init(unsigned int cpu)
 	struct cpu_info *info;
 	int apic_id;
 
+	cpus[cpu].arrival = timestamp_get();
+
 	/* Ensure the local APIC is enabled */
 	enable_lapic();
 
@@ -228,6 +238,9 @@ static void asmlinkage ap_init(unsigned int cpu)
 	info->cpu = cpus[cpu].dev;
 	thread_init_cpu_info_non_bsp(info);
 
+	/* Spans are tracked per CPU, so this needs info->index. */
+	cpus[cpu].span = timestamp_span_begin(0, "AP init");
+
 	apic_id = lapicid();
 	info->cpu->path.apic.apic_id = apic_id;
 	cpus[cpu].apic_id = apic_id;
@@ -371,10 +384,11 @@ static atomic_t *load_sipi_vector(struct mp_params *mp_params)
 	/* Provide pointer to microcode patch. */
 	sp->microcode_ptr = (uint32_t)mp_params->microcode_pointer;
 	/* Pass on abiility to load microcode in parallel. */
-	if (mp_params->parallel_microcode_load)
-		sp->microcode_lock = 0;
-	else
+	if (mp_params->parallel_microcode_load ||
+	    IS_ENABLED(CONFIG_PARALLEL_MP_MICROCODE))
 		sp->microcode_lock = ~0;
+	else
+		sp->microcode_lock = 0;
 	sp->c_handler = (uint32_t)&ap_init;
 	ap_count = &sp->ap_count;
 	atomic_set(ap_count, 0);
@@ -473,8 +487,11 @@ static int start_aps(struct bus *cpu_bus, int ap_count, atomic_t *num_aps)
 	lapic_write_around(LAPIC_ICR2, SET_LAPIC_DEST_FIELD(0));
 	lapic_write_around(LAPIC_ICR, LAPIC_DEST_ALLBUT | LAPIC_INT_ASSERT |
 			   LAPIC_DM_INIT);
-	printk(BIOS_DEBUG, "Waiting for 10ms after sending INIT.\n");
-	mdelay(10);
+	/* Only processors before the P6 family need time to process INIT. */
+	if (!IS_ENABLED(CONFIG_PARALLEL_MP_FAST_START)) {
+		printk(BIOS_DEBUG, "Waiting for 10ms after sending INIT.\n");
+		mdelay(10);
+	}
 
 	/* Send 1st SIPI */
 	if ((lapic_read(LAPIC_ICR) & LAPIC_ICR_BUSY)) {
@@ -486,6 +503,7 @@ static int start_aps(struct bus *cpu_bus, int ap_count, atomic_t *num_aps)
 		printk(BIOS_DEBUG, "done.\n");
 	}
 
+	ap_start_time = timestamp_get();
 	lapic_write_around(LAPIC_ICR2, SET_LAPIC_DEST_FIELD(0));
 	lapic_write_around(LAPIC_ICR, LAPIC_DEST_ALLBUT | LAPIC_INT_ASSERT |
 			   LAPIC_DM_STARTUP | sipi_vector);
@@ -496,8 +514,17 @@ static int start_aps(struct bus *cpu_bus, int ap_count, atomic_t *num_aps)
 	}
 	printk(BIOS_DEBUG, "done.\n");
 
-	/* Wait for CPUs to check in up to 200 us. */
-	wait_for_aps(num_aps, ap_count, 200 /* us */, 15 /* us */);
+	if (IS_ENABLED(CONFIG_PARALLEL_MP_FAST_START)) {
+		/* The 2nd SIPI is only needed for APs that missed the 1st. */
+		if (!wait_for_aps(num_aps, ap_count, 10000 /* 10 ms */,
+				  15 /* us */)) {
+			printk(BIOS_DEBUG, "All APs checked in after 1st SIPI.\n");
+			return 0;
+		}
+	} else {
+		/* Wait for CPUs to check in up to 200 us. */
+		wait_for_aps(num_aps, ap_count, 200 /* us */, 15 /* us */);
+	}
 
 	/* Send 2nd SIPI */
 	if ((lapic_read(LAPIC_ICR) & LAPIC_ICR_BUSY)) {
@@ -529,6 +556,33 @@ static int start_aps(struct bus *cpu_bus, int ap_count, atomic_t *num_aps)
 	return 0;
 }
 
+/* Report how long after the first SIPI each AP reached ap_init(). */
+static void print_ap_arrival(void)
+{
+	const int mhz = timestamp_tick_freq_mhz();
+	uint64_t first = ~0ULL, last = 0, delta;
+	int i, arrived = 0;
+
+	if (mhz <= 0)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(cpus); i++) {
+		if (i == cpu_index() || cpus[i].arrival == 0)
+			continue;
+
+		delta = (cpus[i].arrival - ap_start_time) / mhz;
+		printk(BIOS_SPEW, "AP: slot %d arrived after %llu us.\n",
+		       i, delta);
+		first = MIN(first, delta);
+		last = MAX(last, delta);
+		arrived++;
+	}
+
+	if (arrived)
+		printk(BIOS_DEBUG, "%d APs arrived %llu to %llu us after the 1st SIPI.\n",
+		       arrived, first, last);
+}
+
 static int bsp_do_flight_plan(struct mp_params *mp_params)
 {
 	int i;
@@ -609,6 +663,7 @@ static void init_bsp(struct bus *cpu_bus)
 static int mp_init(struct bus *cpu_bus, struct mp_params *p)
 {
 	int num_cpus;
+	int ret;
 	atomic_t *ap_count;
 
 	init_bsp(cpu_bus);
@@ -651,7 +706,11 @@ static int mp_init(struct bus *cpu_bus, struct mp_params *p)
 	}
 
 	/* Walk the flight plan for the BSP. */
-	return bsp_do_flight_plan(p);
+	ret = bsp_do_flight_plan(p);
+
+	print_ap_arrival();
+
+	return ret;
 }
 
 /* Calls cpu_initialize(info->index) which calls the coreboot CPU drivers. */
@@ -660,6 +719,9 @@ static void mp_initialize_cpu(void)
 	/* Call back into driver infrastructure for the AP initialization.   */
 	struct cpu_info *info = cpu_info();
 	cpu_initialize(info->index);
+
+	if (info->index != 0)
+		timestamp_span_end(cpus[info->index].span);
 }
 
 /* Returns APIC id for coreboot CPU number or < 0 on failure. */
@@ -695,6 +757,11 @@ DECLARE_SPIN_LOCK(smm_relocation_lock);
 /* Send SMI to self with single user serialization. */
 void smm_initiate_relocation(void)
 {
+	if (IS_ENABLED(CONFIG_PARALLEL_MP_SMM_RELOCATION)) {
+		smm_initiate_relocation_parallel();
+		return;
+	}
+
 	spin_lock(&smm_relocation_lock);
 	smm_initiate_relocation_parallel();
 	spin_unlock(&smm_relocation_lock);
@@ -870,13 +937,30 @@ static void store_callback(mp_callback_t *slot, mp_callback_t value)
 	*(volatile mp_callback_t *)slot = value;
 }
 
-static int run_ap_work(mp_callback_t func, long expire_us)
+/*
+ * Take back a callback the AP hasn't accepted yet. Returns 1 if it was taken
+ * back, 0 if the AP accepted it in the meantime and will run it.
+ */
+static int retract_callback(mp_callback_t *slot, mp_callback_t func)
+{
+	return __sync_bool_compare_and_swap(slot, func, NULL);
+}
+
+/*
+ * Returns 0 once every AP accepted func. Otherwise the callbacks that weren't
+ * accepted are taken back, so they never run, *accepted is set to the number
+ * of APs that do run func and -1 is returned.
+ */
+static int run_ap_work_accepted(mp_callback_t func, long expire_us,
+				int *accepted)
 {
 	int i;
 	int cpus_accepted;
 	struct stopwatch sw;
 	int cur_cpu = cpu_index();
 
+	*accepted = 0;
+
 	if (!IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK)) {
 		printk(BIOS_ERR, "APs already parked. PARALLEL_MP_AP_WORK not selected.\n");
 		return -1;
@@ -902,15 +986,34 @@ static int run_ap_work(mp_callback_t func, long expire_us)
 				cpus_accepted++;
 		}
 
-		if (cpus_accepted == global_num_aps)
+		if (cpus_accepted == global_num_aps) {
+			*accepted = cpus_accepted;
 			return 0;
+		}
 	} while (!stopwatch_expired(&sw));
 
 	printk(BIOS_ERR, "AP call expired. %d/%d CPUs accepted.\n",
 		cpus_accepted, global_num_aps);
+
+	/* This also clears the slots of CPUs that don't exist. */
+	cpus_accepted = 0;
+	for (i = 0; i < ARRAY_SIZE(ap_callbacks); i++) {
+		if (cur_cpu == i)
+			continue;
+		if (!retract_callback(&ap_callbacks[i], func))
+			cpus_accepted++;
+	}
+	*accepted = cpus_accepted;
 	return -1;
 }
 
+static int run_ap_work(mp_callback_t func, long expire_us)
+{
+	int accepted;
+
+	return run_ap_work_accepted(func, expire_us, &accepted);
+}
+
 static void ap_wait_for_instruction(void)
 {
 	int cur_cpu = cpu_index();
@@ -926,9 +1029,10 @@ static void ap_wait_for_instruction(void)
 			continue;
 		}
 
-		store_callback(&ap_callbacks[cur_cpu], NULL);
-		mfence();
-		func();
+		/* Claim it, unless the BSP retracted the call in between. */
+		if (__sync_bool_compare_and_swap(&ap_callbacks[cur_cpu], func,
+						 NULL))
+			func();
 	}
 }
 
@@ -937,6 +1041,42 @@ int mp_run_on_aps(void (*func)(void), long expire_us)
 	return run_ap_work(func, expire_us);
 }
 
+int mp_run_on_ap(unsigned int cpu, void (*func)(void), long expire_us)
+{
+	struct stopwatch sw;
+
+	if (!IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK)) {
+		printk(BIOS_ERR, "APs already parked. PARALLEL_MP_AP_WORK not selected.\n");
+		return -1;
+	}
+
+	if (cpu == cpu_index() || cpu > global_num_aps) {
+		printk(BIOS_ERR, "No AP with index %u.\n", cpu);
+		return -1;
+	}
+
+	/* Don't take over a call the AP hasn't accepted yet. */
+	if (!__sync_bool_compare_and_swap(&ap_callbacks[cpu], NULL, func)) {
+		printk(BIOS_ERR, "CPU %u has another call pending.\n", cpu);
+		return -1;
+	}
+
+	/* Wait for the AP to signal back that the call has been accepted. */
+	stopwatch_init_usecs_expire(&sw, expire_us);
+	while (read_callback(&ap_callbacks[cpu]) != NULL) {
+		if (stopwatch_expired(&sw)) {
+			/* The AP may have accepted it in the meantime. */
+			if (!retract_callback(&ap_callbacks[cpu], func))
+				return 0;
+			printk(BIOS_ERR, "AP call to CPU %u expired.\n", cpu);
+			return -1;
+		}
+		asm ("pause");
+	}
+
+	return 0;
+}
+
 int mp_run_on_all_cpus(void (*func)(void), long expire_us)
 {
 	/* Run on BSP first. */
@@ -949,6 +1089,101 @@ int mp_park_aps(void)
 	return mp_run_on_aps(park_this_cpu, 10 * USECS_PER_MSEC);
 }
 
+/* The items of work handed out by mp_run_work(). */
+static struct {
+	const struct mp_work *items;
+	int num_items;
+	atomic_t next;		/* Items claimed so far. */
+	atomic_t done;		/* Items completed so far. */
+	atomic_t aps_busy;	/* APs not yet out of mp_work_ap(). */
+} mp_work_queue;
+
+/* Claim and run items until there are none left. */
+static void mp_work_drain(void)
+{
+	const struct mp_work *items = mp_work_queue.items;
+	const int num_items = mp_work_queue.num_items;
+	int i;
+
+	while ((i = atomic_inc_return(&mp_work_queue.next) - 1) < num_items) {
+		items[i].func(items[i].arg);
+		atomic_inc(&mp_work_queue.done);
+	}
+}
+
+static void mp_work_ap(void)
+{
+	mp_work_drain();
+	atomic_dec(&mp_work_queue.aps_busy);
+}
+
+int mp_run_work(const struct mp_work *work, size_t num, long expire_us)
+{
+	struct stopwatch sw;
+	int accepted;
+	int ret = 0;
+
+	if (atomic_read(&mp_work_queue.aps_busy) != 0) {
+		printk(BIOS_ERR, "MP work: APs still busy with earlier work.\n");
+		return -1;
+	}
+
+	mp_work_queue.items = work;
+	mp_work_queue.num_items = num;
+	atomic_set(&mp_work_queue.next, 0);
+	atomic_set(&mp_work_queue.done, 0);
+
+	stopwatch_init_usecs_expire(&sw, expire_us);
+
+	/* A single item is not worth waking up the APs for. */
+	if (IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK) && global_num_aps > 0 &&
+	    num > 1) {
+		atomic_set(&mp_work_queue.aps_busy, global_num_aps);
+		/*
+		 * APs that didn't accept never enter mp_work_ap(), the ones
+		 * that did may already be leaving it. The BSP and the APs
+		 * that accepted still get through all the items.
+		 */
+		if (run_ap_work_accepted(mp_work_ap, expire_us, &accepted) < 0)
+			for (; accepted < global_num_aps; accepted++)
+				atomic_dec(&mp_work_queue.aps_busy);
+	}
+
+	/* The BSP takes its share of the items as well. */
+	mp_work_drain();
+
+	while (atomic_read(&mp_work_queue.done) != mp_work_queue.num_items ||
+	       atomic_read(&mp_work_queue.aps_busy) != 0) {
+		if (stopwatch_expired(&sw)) {
+			printk(BIOS_ERR, "MP work expired. %d/%d items done.\n",
+			       atomic_read(&mp_work_queue.done),
+			       mp_work_queue.num_items);
+			ret = -1;
+			break;
+		}
+		asm ("pause");
+	}
+
+	/*
+	 * Don't start any more items and wait for the ones that are running,
+	 * the caller may reuse work and its arguments as soon as this returns.
+	 * Give them another expire_us, a hung item must not stall the boot.
+	 */
+	atomic_set(&mp_work_queue.next, mp_work_queue.num_items);
+	stopwatch_init_usecs_expire(&sw, expire_us);
+	while (atomic_read(&mp_work_queue.aps_busy) != 0) {
+		if (stopwatch_expired(&sw)) {
+			printk(BIOS_ERR, "MP work: %d APs still running items.\n",
+			       atomic_read(&mp_work_queue.aps_busy));
+			return -2;
+		}
+		asm ("pause");
+	}
+	mfence();
+
+	return ret;
+}
+
 static struct mp_flight_record mp_steps[] = {
 	/* Once the APs are up load the SMM handlers. */
 	MP_FR_BLOCK_APS(NULL, load_smm_handlers),
@@ -0,0 +1,100 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/cpu.h>
+#include <bootstate.h>
+#include <console/console.h>
+#include <cpu/x86/mp.h>
+#include <stdint.h>
+#include <timer.h>
+
+/*
+ * Smoke test for mp_run_work(). Every item burns a little time so that the
+ * APs get to claim some of them, then the results are checked on the BSP.
+ */
+
+#define NUM_ITEMS	(8 * CONFIG_MAX_CPUS)
+#define ROUNDS		20000
+
+struct test_item {
+	uint32_t seed;
+	uint32_t result;
+	int cpu;
+	int runs;
+};
+
+static struct test_item items[NUM_ITEMS];
+static struct mp_work work[NUM_ITEMS];
+
+static uint32_t test_hash(uint32_t x)
+{
+	int i;
+
+	for (i = 0; i < ROUNDS; i++)
+		x = x * 1664525 + 1013904223;
+	return x;
+}
+
+static void test_work(void *arg)
+{
+	struct test_item *item = arg;
+
+	item->result = test_hash(item->seed);
+	item->cpu = cpu_index();
+	item->runs++;
+}
+
+static void mp_work_test(void *unused)
+{
+	int per_cpu[CONFIG_MAX_CPUS] = { 0 };
+	int i, errors = 0;
+	struct stopwatch sw;
+	long elapsed;
+
+	for (i = 0; i < NUM_ITEMS; i++) {
+		items[i].seed = i;
+		items[i].result = 0;
+		items[i].cpu = -1;
+		items[i].runs = 0;
+		work[i].func = test_work;
+		work[i].arg = &items[i];
+	}
+
+	stopwatch_init(&sw);
+	if (mp_run_work(work, NUM_ITEMS, 100 * USECS_PER_MSEC) < 0)
+		errors++;
+	elapsed = stopwatch_duration_usecs(&sw);
+
+	for (i = 0; i < NUM_ITEMS; i++) {
+		if (items[i].runs != 1 ||
+		    items[i].result != test_hash(items[i].seed)) {
+			printk(BIOS_ERR, "MP work test: item %d ran %d times\n",
+			       i, items[i].runs);
+			errors++;
+			continue;
+		}
+		if (items[i].cpu >= 0 && items[i].cpu < CONFIG_MAX_CPUS)
+			per_cpu[items[i].cpu]++;
+	}
+
+	for (i = 0; i < CONFIG_MAX_CPUS; i++)
+		if (per_cpu[i])
+			printk(BIOS_DEBUG, "MP work test: CPU %d ran %d items\n",
+			       i, per_cpu[i]);
+
+	printk(errors ? BIOS_ERR : BIOS_INFO,
+	       "MP work test: %d items in %ld us, %s\n", NUM_ITEMS, elapsed,
+	       errors ? "FAILED" : "passed");
+}
+
+BOOT_STATE_INIT_ENTRY(BS_DEV_INIT, BS_ON_EXIT, mp_work_test, NULL);
@@ -41,6 +41,7 @@
 #include <console/console.h>
 #include <arch/io.h>
 #include <device/device.h>
+#include <device/device_timing.h>
 #include <device/pci_def.h>
 #include <device/pci_ids.h>
 #include <stdlib.h>
@@ -50,6 +51,22 @@
 #include <arch/ebda.h>
 #endif
 #include <timer.h>
+#include <timestamp.h>
+
+/* Run a device callback, recording its duration if DEVICE_TIMING is set. */
+static void dev_run_op(struct device *dev, void (*op)(struct device *dev),
+		       enum device_timing_op id)
+{
+#if IS_ENABLED(CONFIG_DEVICE_TIMING)
+	struct stopwatch sw;
+
+	stopwatch_init(&sw);
+	op(dev);
+	device_timing_add(dev, id, stopwatch_duration_usecs(&sw));
+#else
+	op(dev);
+#endif
+}
 
 /** Linked list of ALL devices */
 struct device *all_devices = &dev_root;
@@ -234,7 +251,8 @@ static void read_resources(struct bus *bus)
 			continue;
 		}
 		post_log_path(curdev);
-		curdev->ops->read_resources(curdev);
+		dev_run_op(curdev, curdev->ops->read_resources,
+			   DEVICE_TIMING_READ_RESOURCES);
 
 		/* Read in the resources behind the current device's links. */
 		for (link = curdev->link_list; link; link = link->next)
@@ -850,7 +868,8 @@ void assign_resources(struct bus *bus)
 			continue;
 		}
 		post_log_path(curdev);
-		curdev->ops->set_resources(curdev);
+		dev_run_op(curdev, curdev->ops->set_resources,
+			   DEVICE_TIMING_SET_RESOURCES);
 	}
 	post_log_clear();
 	printk(BIOS_SPEW, "%s assign_resources, bus %d link: %d\n",
@@ -877,7 +896,8 @@ static void enable_resources(struct bus *link)
 	for (dev = link->children; dev; dev = dev->sibling) {
 		if (dev->enabled && dev->ops && dev->ops->enable_resources) {
 			post_log_path(dev);
-			dev->ops->enable_resources(dev);
+			dev_run_op(dev, dev->ops->enable_resources,
+				   DEVICE_TIMING_ENABLE_RESOURCES);
 		}
 	}
 
@@ -1130,6 +1150,7 @@ static void init_dev(struct device *dev)
 		return;
 
 	if (!dev->initialized && dev->ops && dev->ops->init) {
+		int span;
 #if IS_ENABLED(CONFIG_HAVE_MONOTONIC_TIMER)
 		struct stopwatch sw;
 		stopwatch_init(&sw);
@@ -1141,7 +1162,9 @@ static void init_dev(struct device *dev)
 
 		printk(BIOS_DEBUG, "%s init ...\n", dev_path(dev));
 		dev->initialized = 1;
-		dev->ops->init(dev);
+		span = timestamp_span_begin(0, dev_path(dev));
+		dev_run_op(dev, dev->ops->init, DEVICE_TIMING_INIT);
+		timestamp_span_end(span);
 #if IS_ENABLED(CONFIG_HAVE_MONOTONIC_TIMER)
 		printk(BIOS_DEBUG, "%s init finished in %ld usecs\n", dev_path(dev),
 			stopwatch_duration_usecs(&sw));
@@ -1211,7 +1234,7 @@ static void final_dev(struct device *dev)
 
 	if (dev->ops && dev->ops->final) {
 		printk(BIOS_DEBUG, "%s final\n", dev_path(dev));
-		dev->ops->final(dev);
+		dev_run_op(dev, dev->ops->final, DEVICE_TIMING_FINAL);
 	}
 }
 
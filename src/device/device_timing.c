@@ -0,0 +1,63 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <cbmem.h>
+#include <console/console.h>
+#include <device/device.h>
+#include <device/device_timing.h>
+#include <string.h>
+
+static struct device_timing_table *timing_table;
+
+void device_timing_add(struct device *dev, enum device_timing_op op,
+		       long usecs)
+{
+	struct device_timing_table *table = timing_table;
+	struct device_timing_entry *e;
+
+	/* Callbacks run before CBMEM is up are not recorded. */
+	if (table == NULL)
+		return;
+
+	if (table->num_entries >= table->max_entries) {
+		table->dropped++;
+		return;
+	}
+
+	e = &table->entries[table->num_entries++];
+	e->usecs = usecs;
+	e->op = op;
+	memset(e->path, 0, sizeof(e->path));
+	strncpy(e->path, dev_path(dev), sizeof(e->path) - 1);
+}
+
+static void device_timing_init(int is_recovery)
+{
+	const size_t size = sizeof(struct device_timing_table) +
+		CONFIG_DEVICE_TIMING_MAX * sizeof(struct device_timing_entry);
+	struct device_timing_table *table;
+
+	table = cbmem_add(CBMEM_ID_DEVICE_TIMING, size);
+	if (table == NULL) {
+		printk(BIOS_ERR, "ERROR: No device timing table allocated\n");
+		return;
+	}
+
+	table->max_entries = CONFIG_DEVICE_TIMING_MAX;
+	table->num_entries = 0;
+	table->dropped = 0;
+
+	timing_table = table;
+}
+
+RAMSTAGE_CBMEM_INIT_HOOK(device_timing_init)
@@ -22,6 +22,7 @@
 #include <console/console.h>
 #include <cpu/amd/lxdef.h>
 #include <cpu/amd/vr.h>
+#include <cpu/x86/lapic_profiler.h>
 #include <delay.h>
 #include <device/pci.h>
 #include <device/pci_ids.h>
@@ -56,6 +57,34 @@ void (*realmode_call)(u32 addr, u32 eax, u32 ebx, u32 ecx, u32 edx,
 void (*realmode_interrupt)(u32 intno, u32 eax, u32 ebx, u32 ecx, u32 edx,
 		u32 esi, u32 edi) asmlinkage;
 
+#if IS_ENABLED(CONFIG_LAPIC_PROFILER)
+/*
+ * The real mode IVT has no handler for the profiler's timer tick, so keep the
+ * profiler paused for as long as we are in real mode.
+ */
+static void (*realmode_call_entry)(u32 addr, u32 eax, u32 ebx, u32 ecx,
+		u32 edx, u32 esi, u32 edi) asmlinkage;
+
+static void (*realmode_interrupt_entry)(u32 intno, u32 eax, u32 ebx, u32 ecx,
+		u32 edx, u32 esi, u32 edi) asmlinkage;
+
+static asmlinkage void realmode_call_unprofiled(u32 addr, u32 eax, u32 ebx,
+		u32 ecx, u32 edx, u32 esi, u32 edi)
+{
+	lapic_profiler_pause();
+	realmode_call_entry(addr, eax, ebx, ecx, edx, esi, edi);
+	lapic_profiler_resume();
+}
+
+static asmlinkage void realmode_interrupt_unprofiled(u32 intno, u32 eax,
+		u32 ebx, u32 ecx, u32 edx, u32 esi, u32 edi)
+{
+	lapic_profiler_pause();
+	realmode_interrupt_entry(intno, eax, ebx, ecx, edx, esi, edi);
+	lapic_profiler_resume();
+}
+#endif
+
 static void setup_realmode_code(void)
 {
 	memcpy(REALMODE_BASE, &__realmode_code, __realmode_code_size);
@@ -64,6 +93,13 @@ static void setup_realmode_code(void)
 	realmode_call = PTR_TO_REAL_MODE(__realmode_call);
 	realmode_interrupt = PTR_TO_REAL_MODE(__realmode_interrupt);
 
+#if IS_ENABLED(CONFIG_LAPIC_PROFILER)
+	realmode_call_entry = realmode_call;
+	realmode_interrupt_entry = realmode_interrupt;
+	realmode_call = realmode_call_unprofiled;
+	realmode_interrupt = realmode_interrupt_unprofiled;
+#endif
+
 	printk(BIOS_SPEW, "Real mode stub @%p: %d bytes\n", REALMODE_BASE,
 			__realmode_code_size);
 }
@@ -48,6 +48,18 @@ static void uart8250_tx_byte(unsigned base_port, unsigned char data)
 	outb(data, base_port + UART8250_TBR);
 }
 
+/* Bytes that can be written without waiting: an empty FIFO, or an empty
+ * holding register on UARTs without one. */
+static unsigned int uart8250_tx_room(unsigned base_port)
+{
+	if (!uart8250_can_tx_byte(base_port))
+		return 0;
+	if ((inb(base_port + UART8250_IIR) & UART8250_IIR_FIFO) ==
+	    UART8250_IIR_FIFO)
+		return UART8250_TX_FIFO_SIZE;
+	return 1;
+}
+
 static void uart8250_tx_flush(unsigned base_port)
 {
 	unsigned long int i = FIFO_TIMEOUT;
@@ -128,6 +140,11 @@ void uart_tx_flush(int idx)
 	uart8250_tx_flush(uart_platform_base(idx));
 }
 
+unsigned int uart_tx_room(int idx)
+{
+	return uart8250_tx_room(uart_platform_base(idx));
+}
+
 #if ENV_RAMSTAGE
 void uart_fill_lb(void *data)
 {
@@ -67,6 +67,18 @@ static void uart8250_mem_tx_byte(void *base, unsigned char data)
 	uart8250_write(base, UART8250_TBR, data);
 }
 
+/* Bytes that can be written without waiting: an empty FIFO, or an empty
+ * holding register on UARTs without one. */
+static unsigned int uart8250_mem_tx_room(void *base)
+{
+	if (!uart8250_mem_can_tx_byte(base))
+		return 0;
+	if ((uart8250_read(base, UART8250_IIR) & UART8250_IIR_FIFO) ==
+	    UART8250_IIR_FIFO)
+		return UART8250_TX_FIFO_SIZE;
+	return 1;
+}
+
 static void uart8250_mem_tx_flush(void *base)
 {
 	unsigned long int i = FIFO_TIMEOUT;
@@ -148,6 +160,14 @@ void uart_tx_flush(int idx)
 	uart8250_mem_tx_flush(base);
 }
 
+unsigned int uart_tx_room(int idx)
+{
+	void *base = uart_platform_baseptr(idx);
+	if (!base)
+		return 0;
+	return uart8250_mem_tx_room(base);
+}
+
 #if ENV_RAMSTAGE
 void uart_fill_lb(void *data)
 {
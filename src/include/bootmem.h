@@ -22,7 +22,8 @@
 
 /*
  * Initialize the memory address space prior to payload loading. The bootmem
- * serves as the source for the lb_mem table.
+ * serves as the source for the lb_mem table. Calling it again starts over
+ * with a fresh map.
  */
 void bootmem_init(void);
 
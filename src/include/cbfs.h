@@ -18,6 +18,7 @@
 
 #include <commonlib/cbfs.h>
 #include <program_loading.h>
+#include <rules.h>
 
 /***********************************************
  * Perform CBFS operations on the boot device. *
@@ -58,6 +59,27 @@ size_t cbfs_prog_stage_section(struct prog *pstage, uintptr_t *base);
 /* Load stage into memory filling in prog. Return 0 on success. < 0 on error. */
 int cbfs_prog_stage_load(struct prog *prog);
 
+/*
+ * Per-boot cache of files located in the boot CBFS. cbfs_boot_locate() consults
+ * it before walking the CBFS and records every file it finds. The cache lives
+ * in CAR until cbmem comes online and is then kept in CBMEM_ID_CBFS_LOOKUP.
+ */
+#if IS_ENABLED(CONFIG_CBFS_LOOKUP_CACHE) && !ENV_SMM
+void cbfs_lookup_cache_init(void);
+/* Return 0 and fill in fh on a verified cache hit, else < 0. */
+int cbfs_lookup_cache_find(struct cbfsf *fh, const struct region_device *cbfs,
+			   const char *name, uint32_t *type);
+void cbfs_lookup_cache_add(struct cbfsf *fh, const struct region_device *cbfs,
+			   const char *name);
+#else
+static inline void cbfs_lookup_cache_init(void) { }
+static inline int cbfs_lookup_cache_find(struct cbfsf *fh,
+		const struct region_device *cbfs, const char *name,
+		uint32_t *type) { return -1; }
+static inline void cbfs_lookup_cache_add(struct cbfsf *fh,
+		const struct region_device *cbfs, const char *name) { }
+#endif
+
 /*****************************************************************
  * Support structures and functions. Direct field access should  *
  * only be done by implementers of cbfs regions -- Not the above *
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _CONSOLE_BINLOG_H_
+#define _CONSOLE_BINLOG_H_
+
+#include <rules.h>
+#include <console/vtxprintf.h>
+
+#define __BINLOG_ENABLE__	(IS_ENABLED(CONFIG_CONSOLE_BINARY_LOG) && \
+	(ENV_ROMSTAGE || ENV_POSTCAR || ENV_RAMSTAGE))
+
+#if __BINLOG_ENABLE__
+/* Append a printk() record to the binary log in CBMEM. Messages before CBMEM
+ * is online are staged in a small buffer until it is. Callers hold the
+ * console lock. */
+void binlog_vprintk(int msg_level, const char *fmt, va_list args);
+
+static inline int binlog_log_level(int msg_level)
+{
+	return msg_level <= CONFIG_CONSOLE_BINARY_LOG_LEVEL;
+}
+#else
+static inline void binlog_vprintk(int msg_level, const char *fmt,
+				  va_list args) {}
+static inline int binlog_log_level(int msg_level) { return 0; }
+#endif
+
+#endif
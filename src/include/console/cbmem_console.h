@@ -15,6 +15,7 @@
 #ifndef _CONSOLE_CBMEM_CONSOLE_H_
 #define _CONSOLE_CBMEM_CONSOLE_H_
 
+#include <console/vtxprintf.h>
 #include <rules.h>
 #include <stdint.h>
 
@@ -36,5 +37,22 @@ static inline void __cbmemc_init(void)	{}
 static inline void __cbmemc_tx_byte(u8 data)	{}
 #endif
 
+#if IS_ENABLED(CONFIG_CONSOLE_CBMEM_PER_CPU) && ENV_RAMSTAGE
+/* Returns non-zero if the current CPU logs to its own buffer. */
+int cbmemc_cpu_console_active(void);
+/* Append a message to the current CPU's buffer without taking the console
+ * lock. Returns -1 if the buffers were merged in the meantime. */
+int cbmemc_cpu_vprintk(const char *fmt, va_list args);
+/* The merge holds the console lock, so direct AP output follows it. */
+void console_lock_acquire(void);
+void console_lock_release(void);
+#else
+static inline int cbmemc_cpu_console_active(void) { return 0; }
+static inline int cbmemc_cpu_vprintk(const char *fmt, va_list args)
+{
+	return 0;
+}
+#endif
+
 void cbmem_dump_console(void);
 #endif
@@ -44,6 +44,9 @@ void uart_init(int idx);
 void uart_tx_byte(int idx, unsigned char data);
 void uart_tx_flush(int idx);
 unsigned char uart_rx_byte(int idx);
+/* Number of bytes uart_tx_byte() can take without waiting. Only provided by
+ * the 8250 drivers. */
+unsigned int uart_tx_room(int idx);
 
 uintptr_t uart_platform_base(int idx);
 
@@ -59,7 +62,31 @@ void oxford_remap(unsigned int new_base);
 	(ENV_BOOTBLOCK || ENV_ROMSTAGE || ENV_RAMSTAGE || ENV_VERSTAGE || \
 	ENV_POSTCAR || (ENV_SMM && IS_ENABLED(CONFIG_DEBUG_SMI))))
 
-#if __CONSOLE_SERIAL_ENABLE__
+#define __CONSOLE_SERIAL_ASYNC_ENABLE__	(__CONSOLE_SERIAL_ENABLE__ && \
+	IS_ENABLED(CONFIG_CONSOLE_SERIAL_ASYNC) && ENV_RAMSTAGE)
+
+#if __CONSOLE_SERIAL_ASYNC_ENABLE__
+/* Queue a byte for the drain thread. */
+void uart_async_tx_byte(u8 data);
+/* Send everything queued and switch to synchronous output. */
+void uart_async_drain(void);
+#endif
+
+#if __CONSOLE_SERIAL_ASYNC_ENABLE__
+static inline void __uart_init(void)
+{
+	uart_init(CONFIG_UART_FOR_CONSOLE);
+}
+static inline void __uart_tx_byte(u8 data)
+{
+	uart_async_tx_byte(data);
+}
+static inline void __uart_tx_flush(void)	{}
+static inline void __uart_drain(void)
+{
+	uart_async_drain();
+}
+#elif __CONSOLE_SERIAL_ENABLE__
 static inline void __uart_init(void)
 {
 	uart_init(CONFIG_UART_FOR_CONSOLE);
@@ -72,10 +99,12 @@ static inline void __uart_tx_flush(void)
 {
 	uart_tx_flush(CONFIG_UART_FOR_CONSOLE);
 }
+static inline void __uart_drain(void)		{}
 #else
 static inline void __uart_init(void)		{}
 static inline void __uart_tx_byte(u8 data)	{}
 static inline void __uart_tx_flush(void)	{}
+static inline void __uart_drain(void)		{}
 #endif
 
 #if IS_ENABLED(CONFIG_GDB_STUB) && (ENV_ROMSTAGE || ENV_RAMSTAGE)
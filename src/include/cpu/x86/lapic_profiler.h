@@ -0,0 +1,40 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef CPU_X86_LAPIC_PROFILER_H
+#define CPU_X86_LAPIC_PROFILER_H
+
+/* IDT vector of the profiler's local APIC timer interrupt. */
+#define LAPIC_PROFILER_VECTOR	0x30
+
+#if !defined(__ASSEMBLER__)
+
+#include <stdint.h>
+
+#if IS_ENABLED(CONFIG_LAPIC_PROFILER)
+/* Called from the interrupt stub with the interrupted instruction pointer. */
+void lapic_profiler_sample(uint32_t pc);
+/*
+ * Keep the timer from interrupting code that doesn't run on coreboot's IDT,
+ * e.g. option ROMs in real mode. Calls may nest.
+ */
+void lapic_profiler_pause(void);
+void lapic_profiler_resume(void);
+#else
+static inline void lapic_profiler_pause(void) {}
+static inline void lapic_profiler_resume(void) {}
+#endif
+
+#endif /* !__ASSEMBLER__ */
+
+#endif /* CPU_X86_LAPIC_PROFILER_H */
@@ -133,9 +133,49 @@ int mp_init_with_smm(struct bus *cpu_bus, const struct mp_ops *mp_ops);
  */
 int mp_run_on_aps(void (*func)(void), long expire_us);
 
+/*
+ * Like mp_run_on_aps() but only for the AP with coreboot CPU index cpu. Fails
+ * if the AP has another call pending. When this fails, func never runs.
+ */
+int mp_run_on_ap(unsigned int cpu, void (*func)(void), long expire_us);
+
 /* Like mp_run_on_aps() but also runs func on BSP. */
 int mp_run_on_all_cpus(void (*func)(void), long expire_us);
 
+/*
+ * One item of work for mp_run_work(). func(arg) may be called on any CPU,
+ * the BSP included, and in any order relative to the other items.
+ */
+struct mp_work {
+	void (*func)(void *arg);
+	void *arg;
+};
+
+/*
+ * Run num items of work across all CPUs. The BSP and the APs keep taking the
+ * next unclaimed item until none are left, so CPUs that finish early pick up
+ * more. Returns 0 once every item has completed, or < 0 if that did not
+ * happen within expire_us. In that case the remaining items are skipped and
+ * items already running get another expire_us to finish, so work may be freed
+ * afterwards. Only if some still didn't finish, -2 is returned: they are left
+ * running, work must stay valid and further calls fail until they are done.
+ * Without PARALLEL_MP_AP_WORK, or if the APs can't be reached, the items run
+ * on the BSP.
+ */
+#if IS_ENABLED(CONFIG_PARALLEL_MP)
+int mp_run_work(const struct mp_work *work, size_t num, long expire_us);
+#else
+static inline int mp_run_work(const struct mp_work *work, size_t num,
+			      long expire_us)
+{
+	size_t i;
+
+	for (i = 0; i < num; i++)
+		work[i].func(work[i].arg);
+	return 0;
+}
+#endif
+
 /*
  * Park all APs to prepare for OS boot. This is handled automatically
  * by the coreboot infrastructure.
@@ -148,7 +188,8 @@ int mp_park_aps(void);
 
 /* Send SMI to self without any serialization. */
 void smm_initiate_relocation_parallel(void);
-/* Send SMI to self with single execution. */
+/* Send SMI to self with single execution, unless PARALLEL_MP_SMM_RELOCATION
+ * is selected. */
 void smm_initiate_relocation(void);
 /* Make a CPU wait until the barrier is released */
 void barrier_wait(atomic_t *b);
@@ -0,0 +1,30 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef DEVICE_TIMING_H
+#define DEVICE_TIMING_H
+
+#include <commonlib/device_timing_serialized.h>
+
+struct device;
+
+#if IS_ENABLED(CONFIG_DEVICE_TIMING)
+/* Record that callback op of dev took usecs microseconds. */
+void device_timing_add(struct device *dev, enum device_timing_op op,
+		       long usecs);
+#else
+static inline void device_timing_add(struct device *dev,
+				     enum device_timing_op op, long usecs) {}
+#endif
+
+#endif /* DEVICE_TIMING_H */
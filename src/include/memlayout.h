@@ -78,6 +78,9 @@
 	REGION(timestamp, addr, size, 8) \
 	_ = ASSERT(size >= 212, "Timestamp region must fit timestamp_cache!");
 
+#define CBFS_LOOKUP(addr, size) \
+	REGION(cbfs_lookup, addr, size, 4)
+
 #define PRERAM_CBMEM_CONSOLE(addr, size) \
 	REGION(preram_cbmem_console, addr, size, 4)
 
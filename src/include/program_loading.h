@@ -199,4 +199,16 @@ void mirror_payload(struct prog *payload);
  */
 void *selfload(struct prog *payload, bool check_regions);
 
+/*
+ * Decompress the payload's segments into a bootmem buffer ahead of time, so
+ * that the following selfload() only has to copy them into place. Returns
+ * 0 on success, < 0 on error in which case selfload() loads the payload the
+ * usual way. Must be called after resources are assigned and finish before
+ * the tables are written. Sets up an early bootmem map and mirrors the
+ * payload into it, which leaves the payload's area pointing at the mirror.
+ *
+ * Defined in src/lib/selfboot.c
+ */
+int selfload_prefetch(struct prog *payload);
+
 #endif /* PROGRAM_LOADING_H */
@@ -52,6 +52,16 @@ typedef struct { int counter; } atomic_t;
 #define atomic_dec(v)	(((v)->counter)--)
 
 
+/**
+ * atomic_inc_return - increment atomic variable and return the result
+ * @param v: pointer of type atomic_t
+ *
+ * Atomically increments v by 1 and returns the new value.  Note that
+ * the guaranteed useful range of an atomic_t is only 24 bits.
+ */
+#define atomic_inc_return(v)	(++((v)->counter))
+
+
 #endif /* CONFIG_SMP */
 
 #endif /* SMP_ATOMIC_H */
@@ -1,6 +1,7 @@
 #ifndef STDLIB_H
 #define STDLIB_H
 
+#include <rules.h>
 #include <stddef.h>
 
 #define min(a, b) MIN((a), (b))
@@ -8,8 +9,12 @@
 
 void *memalign(size_t boundary, size_t size);
 void *malloc(size_t size);
+#if ENV_RAMSTAGE && !IS_ENABLED(CONFIG_HEAP_BUMP_ALLOCATOR)
+void free(void *ptr);
+#else
 /* We never free memory */
 static inline void free(void *ptr) {}
+#endif
 
 #ifndef __ROMCC__
 static inline unsigned long div_round_up(unsigned int n, unsigned int d)
@@ -21,6 +21,19 @@
 #include <timer.h>
 #include <arch/cpu.h>
 
+enum thread_state {
+	THREAD_UNINITIALIZED,
+	THREAD_STARTED,
+	THREAD_DONE,
+	THREAD_FAILED,		/* Could not be started, will never run. */
+};
+
+/* Filled in by thread_run_on_cpu() so that the thread can be waited for. */
+struct thread_handle {
+	volatile enum thread_state state;
+	unsigned int cpu;
+};
+
 #if IS_ENABLED(CONFIG_COOP_MULTITASKING) && !defined(__SMM__) && !defined(__PRE_RAM__)
 
 struct thread {
@@ -31,6 +44,8 @@ struct thread {
 	void (*entry)(void *);
 	void *entry_arg;
 	int can_yield;
+	int cpu;
+	struct thread_handle *handle;
 };
 
 void threads_initialize(void);
@@ -48,6 +63,21 @@ int thread_run(void (*func)(void *), void *arg);
  * machine. */
 int thread_run_until(void (*func)(void *), void *arg,
 		     boot_state_t state, boot_state_sequence_t seq);
+/* thread_run_on_cpu() starts func(arg) on a new thread that runs on the CPU
+ * with coreboot index cpu, and fills in handle if it isn't NULL. CPU 0 is the
+ * BSP, where the thread behaves like one started by thread_run(). Any other
+ * CPU has to be an AP that is waiting for work (PARALLEL_MP_AP_WORK). Threads
+ * bound to an AP run there one after the other until they return: they don't
+ * yield, can't start threads of their own and don't block any boot state.
+ * Only the BSP may call this. Return 0 on successful start of thread, < 0
+ * when thread could not be started. */
+int thread_run_on_cpu(struct thread_handle *handle, unsigned int cpu,
+		      void (*func)(void *), void *arg);
+/* Wait up to expire_us for the thread behind handle to return. Threads on the
+ * BSP keep running as long as the caller can yield. Return 0 once the thread
+ * is done, < 0 if it was never started, can't finish or is still running when
+ * the time is up. */
+int thread_join(struct thread_handle *handle, long expire_us);
 /* Return 0 on successful yield for the given amount of time, < 0 when thread
  * did not yield. */
 int thread_yield_microseconds(unsigned int microsecs);
@@ -74,6 +104,16 @@ void arch_prepare_thread(struct thread *t,
 #else
 static inline void threads_initialize(void) {}
 static inline int thread_run(void (*func)(void *), void *arg) { return -1; }
+static inline int thread_run_on_cpu(struct thread_handle *handle,
+				    unsigned int cpu, void (*func)(void *),
+				    void *arg)
+{
+	return -1;
+}
+static inline int thread_join(struct thread_handle *handle, long expire_us)
+{
+	return -1;
+}
 static inline int thread_yield_microseconds(unsigned int microsecs)
 {
 	return -1;
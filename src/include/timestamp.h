@@ -17,6 +17,7 @@
 #define __TIMESTAMP_H__
 
 #include <commonlib/timestamp_serialized.h>
+#include <rules.h>
 
 #if IS_ENABLED(CONFIG_COLLECT_TIMESTAMPS) && (IS_ENABLED(CONFIG_EARLY_CBMEM_INIT) \
 	|| !defined(__PRE_RAM__))
@@ -42,6 +43,25 @@ void timestamp_add_now(enum timestamp_id id);
 #define timestamp_add_now(id)
 #endif
 
+#if IS_ENABLED(CONFIG_TIMESTAMP_SPANS) && ENV_RAMSTAGE
+/*
+ * Open a span nested in the span currently open on this CPU. id may be 0 when
+ * a label is given. The label is copied and truncated to
+ * TIMESTAMP_SPAN_LABEL_LEN - 1 characters. Returns a handle to pass to
+ * timestamp_span_end(), or < 0 if the span isn't recorded.
+ */
+int timestamp_span_begin(enum timestamp_id id, const char *label);
+/* Close a span, making its parent the current one again. */
+void timestamp_span_end(int span);
+#else
+static inline int timestamp_span_begin(enum timestamp_id id,
+				       const char *label)
+{
+	return -1;
+}
+static inline void timestamp_span_end(int span) {}
+#endif
+
 /* Implemented by the architecture code */
 uint64_t timestamp_get(void);
 uint64_t get_initial_timestamp(void);
@@ -16,6 +16,7 @@
 
 #include <arch/exception.h>
 #include <bootblock_common.h>
+#include <cbfs.h>
 #include <console/console.h>
 #include <delay.h>
 #include <pc80/mc146818rtc.h>
@@ -36,6 +37,8 @@ asmlinkage void bootblock_main_with_timestamp(uint64_t base_timestamp)
 	if (IS_ENABLED(CONFIG_COLLECT_TIMESTAMPS) && _timestamp_size > 0)
 		timestamp_init(base_timestamp);
 
+	cbfs_lookup_cache_init();
+
 	cmos_post_init();
 
 	bootblock_soc_early_init();
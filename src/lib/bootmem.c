@@ -22,6 +22,7 @@
 #include <stdlib.h>
 
 static struct memranges bootmem;
+static int bootmem_is_initialized;
 
 void bootmem_init(void)
 {
@@ -33,8 +34,15 @@ void bootmem_init(void)
 	 * Fill the memory map out. The order of operations is important in
 	 * that each overlapping range will take over the next. Therefore,
 	 * add cacheable resources as RAM then add the reserved resources.
+	 * A map built earlier is replaced, keeping its entries for reuse.
 	 */
-	memranges_init(bm, cacheable, cacheable, LB_MEM_RAM);
+	if (bootmem_is_initialized) {
+		memranges_teardown(bm);
+		memranges_add_resources(bm, cacheable, cacheable, LB_MEM_RAM);
+	} else {
+		memranges_init(bm, cacheable, cacheable, LB_MEM_RAM);
+		bootmem_is_initialized = 1;
+	}
 	memranges_add_resources(bm, reserved, reserved, LB_MEM_RESERVED);
 
 	/* Add memory used by CBMEM. */
@@ -53,7 +53,15 @@ int cbfs_boot_locate(struct cbfsf *fh, const char *name, uint32_t *type)
 	if (rdev_chain(&rdev, boot_dev, props.offset, props.size))
 		return -1;
 
-	return cbfs_locate(fh, &rdev, name, type);
+	if (!cbfs_lookup_cache_find(fh, &rdev, name, type))
+		return 0;
+
+	if (cbfs_locate(fh, &rdev, name, type))
+		return -1;
+
+	cbfs_lookup_cache_add(fh, &rdev, name);
+
+	return 0;
 }
 
 void *cbfs_boot_map_with_leak(const char *name, uint32_t type, size_t *size)
@@ -86,6 +94,67 @@ int cbfs_locate_file_in_region(struct cbfsf *fh, const char *region_name,
 	return cbfs_locate(fh, &rdev, name, type);
 }
 
+/* How much of an LZ4 file to read ahead while the current block is being
+ * decompressed. */
+#define CBFS_LZ4_PREFETCH_SIZE (64 * KiB)
+
+struct cbfs_lz4_fill {
+	const struct region_device *rdev;
+	size_t offset;
+	uint8_t *buf;
+	size_t size;
+	size_t loaded;
+	struct rdev_async_req req;
+	size_t req_size;
+};
+
+static int cbfs_lz4_fill_wait(struct cbfs_lz4_fill *fill)
+{
+	size_t len = fill->req_size;
+
+	if (len == 0)
+		return 0;
+
+	fill->req_size = 0;
+
+	if (rdev_async_wait(&fill->req) != len)
+		return -1;
+
+	fill->loaded += len;
+
+	return 0;
+}
+
+static int cbfs_lz4_fill(void *arg, size_t size)
+{
+	struct cbfs_lz4_fill *fill = arg;
+	size_t len;
+
+	if (size > fill->loaded && cbfs_lz4_fill_wait(fill))
+		return -1;
+
+	if (size > fill->loaded) {
+		len = size - fill->loaded;
+		if (rdev_readat(fill->rdev, fill->buf + fill->loaded,
+				fill->offset + fill->loaded, len) != len)
+			return -1;
+		fill->loaded = size;
+	}
+
+	/* Read ahead while the caller decompresses what it asked for. Region
+	 * devices without asynchronous reads just read it right away. */
+	if (fill->req_size == 0 && fill->loaded < fill->size) {
+		len = MIN(fill->size - fill->loaded, CBFS_LZ4_PREFETCH_SIZE);
+		memset(&fill->req, 0, sizeof(fill->req));
+		if (rdev_readat_async(fill->rdev, &fill->req,
+				fill->buf + fill->loaded,
+				fill->offset + fill->loaded, len) == 0)
+			fill->req_size = len;
+	}
+
+	return 0;
+}
+
 size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 	size_t in_size, void *buffer, size_t buffer_size, uint32_t compression)
 {
@@ -109,6 +178,32 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 		 * the caller to ensure that buffer_size is large enough
 		 * (see compression.h, guaranteed by cbfstool for stages). */
 		void *compr_start = buffer + buffer_size - in_size;
+
+		/* Without memory mapped boot media, read the file as the LZ4
+		 * blocks get decompressed, reading ahead asynchronously if the
+		 * boot device supports it. Note that the timestamps then
+		 * include the time spent reading. */
+		if (!IS_ENABLED(CONFIG_BOOT_DEVICE_MEMORY_MAPPED)) {
+			struct cbfs_lz4_fill fill = {
+				.rdev = rdev,
+				.offset = offset,
+				.buf = compr_start,
+				.size = in_size,
+				.loaded = 0,
+				.req_size = 0,
+			};
+
+			timestamp_add_now(TS_START_ULZ4F);
+			out_size = ulz4fn_fill(compr_start, in_size, buffer,
+					       buffer_size, cbfs_lz4_fill, &fill);
+			timestamp_add_now(TS_END_ULZ4F);
+
+			/* Don't return with a read still writing to buffer. */
+			cbfs_lz4_fill_wait(&fill);
+
+			return out_size;
+		}
+
 		if (rdev_readat(rdev, compr_start, offset, in_size) != in_size)
 			return 0;
 
@@ -123,6 +218,18 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 		if ((ENV_ROMSTAGE || ENV_POSTCAR)
 			&& !IS_ENABLED(CONFIG_COMPRESS_RAMSTAGE))
 			return 0;
+
+		/* Mapping boot media that is not memory mapped means reading
+		 * the whole file into a bounce buffer first. Let the decoder
+		 * pull the input through a small window instead. */
+		if (!IS_ENABLED(CONFIG_BOOT_DEVICE_MEMORY_MAPPED)) {
+			timestamp_add_now(TS_START_ULZMA);
+			out_size = ulzman_rdev(rdev, offset, in_size, buffer,
+					       buffer_size);
+			timestamp_add_now(TS_END_ULZMA);
+			return out_size;
+		}
+
 		void *map = rdev_mmap(rdev, offset, in_size);
 		if (map == NULL)
 			return 0;
@@ -136,6 +243,27 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 
 		return out_size;
 
+	case CBFS_COMPRESS_ZSTD:
+		/* The decoder is only built in when stages use it. */
+		if (ENV_BOOTBLOCK || ENV_VERSTAGE)
+			return 0;
+		if (!IS_ENABLED(CONFIG_COMPRESS_RAMSTAGE_ZSTD))
+			return 0;
+
+		/* The decoder uses the end of the output buffer for literals,
+		 * so unlike LZ4 it can't decompress in-place. */
+		map = rdev_mmap(rdev, offset, in_size);
+		if (map == NULL)
+			return 0;
+
+		timestamp_add_now(TS_START_UZSTD);
+		out_size = uzstdn(map, in_size, buffer, buffer_size);
+		timestamp_add_now(TS_END_UZSTD);
+
+		rdev_munmap(rdev, map);
+
+		return out_size;
+
 	default:
 		return 0;
 	}
@@ -0,0 +1,256 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <compiler.h>
+#include <arch/early_variables.h>
+#include <cbfs.h>
+#include <cbmem.h>
+#include <commonlib/cbfs_lookup_serialized.h>
+#include <console/console.h>
+#include <rules.h>
+#include <smp/node.h>
+#include <symbols.h>
+
+#define MAX_CBMEM_LOOKUP_ENTRIES 64
+
+struct __packed cbfs_lookup_car {
+	uint32_t state;
+	struct cbfs_lookup_cache cache;
+};
+
+DECLARE_OPTIONAL_REGION(cbfs_lookup);
+
+#if defined(__PRE_RAM__)
+#define USE_CBFS_LOOKUP_REGION (_cbfs_lookup_size > 0)
+#else
+#define USE_CBFS_LOOKUP_REGION 0
+#endif
+
+#define HAS_CBMEM (ENV_ROMSTAGE || ENV_RAMSTAGE || ENV_POSTCAR)
+
+enum {
+	CBFS_LOOKUP_CAR_UNINITIALIZED = 0,
+	CBFS_LOOKUP_CAR_INITIALIZED,
+	CBFS_LOOKUP_CAR_NOT_NEEDED,
+};
+
+static size_t cbfs_lookup_car_max_entries(void)
+{
+	return (_cbfs_lookup_size - offsetof(struct cbfs_lookup_car,
+		cache.entries)) / sizeof(struct cbfs_lookup_entry);
+}
+
+static void cbfs_lookup_cache_reset(struct cbfs_lookup_cache *cache,
+				    size_t max_entries)
+{
+	cache->max_entries = max_entries;
+	cache->num_entries = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+static struct cbfs_lookup_car *cbfs_lookup_car_get(void)
+{
+	if (!USE_CBFS_LOOKUP_REGION)
+		return NULL;
+
+	if (_cbfs_lookup_size < sizeof(struct cbfs_lookup_car))
+		BUG();
+
+	return car_get_var_ptr((void *)_cbfs_lookup);
+}
+
+/* Like the timestamp code, only let the BSP touch the cache. On AMD systems
+ * multiple processors can be executing the pre-RAM stages. */
+static int cbfs_lookup_should_run(void)
+{
+	if (IS_ENABLED(CONFIG_ARCH_X86) && !boot_cpu())
+		return 0;
+
+	return 1;
+}
+
+void cbfs_lookup_cache_init(void)
+{
+	struct cbfs_lookup_car *car;
+
+	if (!cbfs_lookup_should_run())
+		return;
+
+	car = cbfs_lookup_car_get();
+
+	if (car == NULL)
+		return;
+
+	cbfs_lookup_cache_reset(&car->cache, cbfs_lookup_car_max_entries());
+	car->state = CBFS_LOOKUP_CAR_INITIALIZED;
+}
+
+static struct cbfs_lookup_cache *cbfs_lookup_cache_get(void)
+{
+	MAYBE_STATIC struct cbfs_lookup_cache *cache = NULL;
+	struct cbfs_lookup_car *car;
+
+	if (!cbfs_lookup_should_run())
+		return NULL;
+
+	if (cache != NULL)
+		return cache;
+
+	car = cbfs_lookup_car_get();
+
+	if (car != NULL) {
+		/* Stages not entered through the common bootblock never got
+		 * to initialize the region, so sanity check it here. */
+		if (car->state == CBFS_LOOKUP_CAR_UNINITIALIZED ||
+		    car->cache.max_entries != cbfs_lookup_car_max_entries() ||
+		    car->cache.num_entries > car->cache.max_entries)
+			cbfs_lookup_cache_init();
+
+		if (car->state == CBFS_LOOKUP_CAR_INITIALIZED)
+			return &car->cache;
+	}
+
+	if (HAS_CBMEM)
+		cache = cbmem_find(CBMEM_ID_CBFS_LOOKUP);
+
+	return cache;
+}
+
+static uint32_t cbfs_lookup_relative_offset(const struct region_device *cbfs,
+					    const struct cbfsf *fh)
+{
+	return region_device_offset(&fh->metadata) - region_device_offset(cbfs);
+}
+
+int cbfs_lookup_cache_find(struct cbfsf *fh, const struct region_device *cbfs,
+			   const char *name, uint32_t *type)
+{
+	struct cbfs_lookup_cache *cache;
+	uint32_t name_hash;
+	uint32_t cbfs_offset;
+	size_t i;
+
+	cache = cbfs_lookup_cache_get();
+
+	if (cache == NULL)
+		return -1;
+
+	name_hash = cbfs_index_hash(name);
+	cbfs_offset = region_device_offset(cbfs);
+
+	for (i = 0; i < cache->num_entries; i++) {
+		struct cbfs_lookup_entry *e = &cache->entries[i];
+		uint32_t file_hash;
+
+		if (e->name_hash != name_hash || e->cbfs_offset != cbfs_offset)
+			continue;
+
+		if (type != NULL && e->type != *type)
+			continue;
+
+		/* The entry only tells where to look. The name and type are
+		 * always checked against the file header itself. */
+		if (!cbfs_locate_at(fh, cbfs, e->file_offset, name, type)) {
+			cache->hits++;
+			return 0;
+		}
+
+		/* Keep entries for other names that share the hash. */
+		if (!cbfs_index_hash_at(cbfs, e->file_offset, &file_hash) &&
+		    file_hash == e->name_hash)
+			continue;
+
+		/* The file moved, look at the entry swapped into its place. */
+		cache->entries[i--] = cache->entries[--cache->num_entries];
+	}
+
+	cache->misses++;
+	return -1;
+}
+
+void cbfs_lookup_cache_add(struct cbfsf *fh, const struct region_device *cbfs,
+			   const char *name)
+{
+	struct cbfs_lookup_cache *cache;
+	struct cbfs_lookup_entry *e;
+	uint32_t ftype;
+
+	cache = cbfs_lookup_cache_get();
+
+	if (cache == NULL || cache->num_entries >= cache->max_entries)
+		return;
+
+	if (cbfsf_file_type(fh, &ftype))
+		return;
+
+	e = &cache->entries[cache->num_entries++];
+	e->name_hash = cbfs_index_hash(name);
+	e->type = ftype;
+	e->cbfs_offset = region_device_offset(cbfs);
+	e->file_offset = cbfs_lookup_relative_offset(cbfs, fh);
+	e->data_size = region_device_sz(&fh->data);
+}
+
+static void cbfs_lookup_cache_sync(int is_recovery)
+{
+	struct cbfs_lookup_car *car;
+	struct cbfs_lookup_cache *cache;
+	const size_t size = sizeof(struct cbfs_lookup_cache) +
+		MAX_CBMEM_LOOKUP_ENTRIES * sizeof(struct cbfs_lookup_entry);
+	size_t i;
+
+	if (!cbfs_lookup_should_run())
+		return;
+
+	cache = cbmem_find(CBMEM_ID_CBFS_LOOKUP);
+
+	/* Ramstage keeps using whatever romstage left behind. */
+	if (ENV_RAMSTAGE && cache != NULL)
+		return;
+
+	if (cache == NULL)
+		cache = cbmem_add(CBMEM_ID_CBFS_LOOKUP, size);
+
+	if (cache == NULL) {
+		printk(BIOS_ERR, "ERROR: No CBFS lookup cache in cbmem.\n");
+		return;
+	}
+
+	/* A table found in romstage is left over from the previous boot. */
+	cbfs_lookup_cache_reset(cache, MAX_CBMEM_LOOKUP_ENTRIES);
+
+	car = cbfs_lookup_car_get();
+
+	if (car == NULL || car->state != CBFS_LOOKUP_CAR_INITIALIZED)
+		return;
+
+	for (i = 0; i < car->cache.num_entries; i++) {
+		if (cache->num_entries >= cache->max_entries)
+			break;
+		cache->entries[cache->num_entries++] = car->cache.entries[i];
+	}
+
+	cache->hits = car->cache.hits;
+	cache->misses = car->cache.misses;
+
+	/* Cache no longer required. */
+	car->cache.num_entries = 0;
+	car->state = CBFS_LOOKUP_CAR_NOT_NEEDED;
+}
+
+ROMSTAGE_CBMEM_INIT_HOOK(cbfs_lookup_cache_sync)
+RAMSTAGE_CBMEM_INIT_HOOK(cbfs_lookup_cache_sync)
@@ -0,0 +1,210 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/cpu.h>
+#include <bootstate.h>
+#include <compiler.h>
+#include <console/cbmem_console.h>
+#include <console/console.h>
+#include <console/streams.h>
+#include <console/vtxprintf.h>
+#include <smp/spinlock.h>
+#include <stdlib.h>
+#include <timestamp.h>
+
+/*
+ * Per-CPU console buffers for APs doing work in parallel. Every AP appends
+ * its messages to its own buffer under its own lock, so APs never contend
+ * with each other or with the BSP. Each message gets a timestamp. On entry
+ * to BS_WRITE_TABLES the buffers are merged in timestamp order and sent to
+ * the regular consoles, prefixed with the CPU and the time they were
+ * logged at.
+ */
+
+struct cpu_console_record {
+	u64 timestamp;
+	u16 len;
+	u8 text[0];
+} __packed;
+
+struct cpu_console {
+	/* Bytes of complete records, only written by the owning CPU. */
+	volatile u32 cursor;
+	u32 dropped;
+	u8 body[CONFIG_CONSOLE_CBMEM_PER_CPU_SIZE];
+};
+
+static struct cpu_console cpu_consoles[CONFIG_MAX_CPUS];
+/* Only contended while the buffers are merged. */
+static spinlock_t cpu_console_locks[CONFIG_MAX_CPUS] = {
+	[0 ... CONFIG_MAX_CPUS - 1] = SPIN_LOCK_UNLOCKED
+};
+static volatile int cpu_consoles_merged;
+
+struct cpu_console_writer {
+	struct cpu_console *console;
+	u32 pos;
+	int full;
+};
+
+int cbmemc_cpu_console_active(void)
+{
+	unsigned long cpu;
+
+	if (cpu_consoles_merged)
+		return 0;
+
+	/* The BSP is CPU 0, this avoids reading the APIC base MSR. */
+	cpu = cpu_index();
+	return cpu != 0 && cpu < ARRAY_SIZE(cpu_consoles);
+}
+
+static void cpu_console_tx_byte(unsigned char byte, void *data)
+{
+	struct cpu_console_writer *w = data;
+
+	if (w->pos >= sizeof(w->console->body)) {
+		w->full = 1;
+		return;
+	}
+
+	w->console->body[w->pos++] = byte;
+}
+
+static int cpu_console_append(struct cpu_console *console, const char *fmt,
+			      va_list args)
+{
+	struct cpu_console_writer w;
+	struct cpu_console_record *rec;
+	int i;
+
+	if (console->cursor + sizeof(*rec) >= sizeof(console->body)) {
+		console->dropped++;
+		return 0;
+	}
+
+	rec = (void *)&console->body[console->cursor];
+	rec->timestamp = timestamp_get();
+
+	w.console = console;
+	w.pos = console->cursor + sizeof(*rec);
+	w.full = 0;
+
+	i = vtxprintf(cpu_console_tx_byte, fmt, args, &w);
+
+	/* Only whole messages are kept. */
+	if (w.full || w.pos - console->cursor - sizeof(*rec) > 0xffff) {
+		console->dropped++;
+		return i;
+	}
+
+	rec->len = w.pos - console->cursor - sizeof(*rec);
+	console->cursor = w.pos;
+
+	return i;
+}
+
+int cbmemc_cpu_vprintk(const char *fmt, va_list args)
+{
+	const unsigned long cpu = cpu_index();
+	int i = -1;
+
+	/* The merge takes every CPU's lock after setting the flag, so a
+	 * message is either part of the merge or printed directly. */
+	spin_lock(&cpu_console_locks[cpu]);
+	if (!cpu_consoles_merged)
+		i = cpu_console_append(&cpu_consoles[cpu], fmt, args);
+	spin_unlock(&cpu_console_locks[cpu]);
+
+	return i;
+}
+
+static struct cpu_console_record *cpu_console_record(int cpu, u32 pos)
+{
+	return (void *)&cpu_consoles[cpu].body[pos];
+}
+
+static void merge_tx_byte(unsigned char byte, void *data)
+{
+	console_tx_byte(byte);
+}
+
+static void cpu_console_prefix(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vtxprintf(merge_tx_byte, fmt, args, NULL);
+	va_end(args);
+}
+
+static void cpu_consoles_merge(void *unused)
+{
+	u32 pos[CONFIG_MAX_CPUS] = { 0 };
+	u32 end[CONFIG_MAX_CPUS];
+	struct cpu_console_record *rec;
+	const int mhz = timestamp_tick_freq_mhz();
+	int cpu, next;
+	u16 c;
+
+	console_lock_acquire();
+
+	/*
+	 * From now on APs go through the regular consoles again. They wait
+	 * for the console lock, so their output follows the merged messages.
+	 * Taking each buffer's lock waits for a message in progress.
+	 */
+	cpu_consoles_merged = 1;
+	for (cpu = 0; cpu < CONFIG_MAX_CPUS; cpu++) {
+		spin_lock(&cpu_console_locks[cpu]);
+		end[cpu] = cpu_consoles[cpu].cursor;
+		spin_unlock(&cpu_console_locks[cpu]);
+	}
+
+	while (1) {
+		next = -1;
+		for (cpu = 0; cpu < CONFIG_MAX_CPUS; cpu++) {
+			if (pos[cpu] >= end[cpu])
+				continue;
+			rec = cpu_console_record(cpu, pos[cpu]);
+			if (next < 0 || rec->timestamp <
+			    cpu_console_record(next, pos[next])->timestamp)
+				next = cpu;
+		}
+
+		if (next < 0)
+			break;
+
+		rec = cpu_console_record(next, pos[next]);
+		if (mhz > 0)
+			cpu_console_prefix("[CPU%d %llu us] ", next,
+					   rec->timestamp / mhz);
+		else
+			cpu_console_prefix("[CPU%d %llu] ", next,
+					   rec->timestamp);
+		for (c = 0; c < rec->len; c++)
+			console_tx_byte(rec->text[c]);
+		pos[next] += sizeof(*rec) + rec->len;
+	}
+	console_tx_flush();
+
+	console_lock_release();
+
+	for (cpu = 0; cpu < CONFIG_MAX_CPUS; cpu++)
+		if (cpu_consoles[cpu].dropped)
+			printk(BIOS_WARNING,
+			       "*** CPU %d console overflowed, %u messages dropped ***\n",
+			       cpu, cpu_consoles[cpu].dropped);
+}
+
+BOOT_STATE_INIT_ENTRY(BS_WRITE_TABLES, BS_ON_ENTRY, cpu_consoles_merge, NULL);
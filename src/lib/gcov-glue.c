@@ -16,118 +16,87 @@
 #include <stdint.h>
 #include <bootstate.h>
 #include <cbmem.h>
+#include <commonlib/coverage_serialized.h>
 
-typedef struct file {
-	uint32_t magic;
-	struct file *next;
-	char *filename;
-	char *data;
-	int offset;
-	int len;
-} FILE;
-
-#define SEEK_SET       0       /* Seek from beginning of file.  */
-
-#define DIR_SEPARATOR '/'
-#define IS_DIR_SEPARATOR(ch) ((ch) == DIR_SEPARATOR)
-#define HAS_DRIVE_SPEC(f) (0)
-
-#define COVERAGE_SIZE (32*1024)
-
-#define COVERAGE_MAGIC 0x584d4153
+/*
+ * There is no file system to write .gcda files to. gcov_exit() sizes the data
+ * of all objects up front and streams it into a single CBMEM area, handing out
+ * space with a bump pointer. util/cbmem -C writes the files back out.
+ */
 
-static FILE *current_file = NULL;
-static FILE *previous_file = NULL;
+static struct coverage_header *coverage;
+static uint8_t *coverage_pos;
+static uint8_t *coverage_end;
+static uint32_t *coverage_data;
+static uint32_t *coverage_data_end;
 
-static FILE *fopen(const char *path, const char *mode)
+static size_t coverage_file_size(const char *name, size_t data_len)
 {
-#if IS_ENABLED(CONFIG_DEBUG_COVERAGE)
-	printk(BIOS_DEBUG, "fopen %s with mode %s\n",
-		path, mode);
-#endif
-	if (!current_file) {
-		current_file = cbmem_add(CBMEM_ID_COVERAGE, 32*1024);
-	} else {
-		previous_file = current_file;
-		current_file =
-			(FILE *)(ALIGN(((unsigned long)previous_file->data
-			+ previous_file->len), 16));
-	}
-
-	// TODO check if we're at the end of the CBMEM region (ENOMEM)
-	if (current_file) {
-		current_file->magic = COVERAGE_MAGIC;
-		current_file->next = NULL;
-		if (previous_file)
-			previous_file->next = current_file;
-		current_file->filename = (char *)&current_file[1];
-		strcpy(current_file->filename, path);
-		current_file->data =
-			(char *)ALIGN(((unsigned long)current_file->filename
-			+ strlen(path) + 1), 16);
-		current_file->offset = 0;
-		current_file->len = 0;
-	}
-
-	return current_file;
+	return sizeof(struct coverage_file) + ALIGN(strlen(name) + 1, 4) +
+		data_len;
 }
 
-static int fclose(FILE *stream)
+static int coverage_open(size_t size)
 {
-#if IS_ENABLED(CONFIG_DEBUG_COVERAGE)
-	printk(BIOS_DEBUG, "fclose %s\n", stream->filename);
-#endif
-	return 0;
-}
+	const struct cbmem_entry *entry;
+
+	size += sizeof(*coverage);
+	entry = cbmem_entry_add(CBMEM_ID_COVERAGE, size);
+	if (entry == NULL || cbmem_entry_size(entry) < size) {
+		printk(BIOS_ERR, "ERROR: No room for %zu bytes of coverage data\n",
+		       size);
+		return -1;
+	}
 
-static int fseek(FILE *stream, long offset, int whence)
-{
-	/* fseek should only be called with offset==0 and whence==SEEK_SET
-	 * to a freshly opened file. */
-	gcc_assert(offset == 0 && whence == SEEK_SET);
-#if IS_ENABLED(CONFIG_DEBUG_COVERAGE)
-	printk(BIOS_DEBUG, "fseek %s offset=%ld whence=%d\n",
-		stream->filename, offset, whence);
-#endif
+	coverage = cbmem_entry_start(entry);
+	coverage->magic = COVERAGE_MAGIC;
+	coverage->num_files = 0;
+	coverage->size = sizeof(*coverage);
+	coverage->reserved = 0;
+	coverage_pos = (uint8_t *)&coverage[1];
+	coverage_end = (uint8_t *)coverage + size;
 	return 0;
 }
 
-static long ftell(FILE *stream)
+/* Start a new file of data_len bytes, filled in by coverage_write*(). */
+static int coverage_add_file(const char *name, size_t data_len)
 {
-	/* ftell should currently not be called */
-	gcc_assert(0);
-#if IS_ENABLED(CONFIG_DEBUG_COVERAGE)
-	printk(BIOS_DEBUG, "ftell %s\n", stream->filename);
-#endif
-	return 0;
-}
+	const size_t name_len = ALIGN(strlen(name) + 1, 4);
+	const size_t size = coverage_file_size(name, data_len);
+	struct coverage_file *file;
+	char *file_name;
 
-static size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream)
-{
 #if IS_ENABLED(CONFIG_DEBUG_COVERAGE)
-	printk(BIOS_DEBUG, "fread: ptr=%p size=%zd nmemb=%zd FILE*=%p\n",
-		ptr, size, nmemb, stream);
+	printk(BIOS_DEBUG, "coverage: %zu bytes for %s\n", data_len, name);
 #endif
+	if (size > coverage_end - coverage_pos)
+		return -1;
+
+	file = (struct coverage_file *)coverage_pos;
+	file->name_len = name_len;
+	file->data_len = data_len;
+	file_name = (char *)&file[1];
+	memset(file_name, 0, name_len);
+	strcpy(file_name, name);
+
+	coverage_data = (uint32_t *)(file_name + name_len);
+	coverage_data_end = coverage_data + data_len / sizeof(uint32_t);
+	coverage_pos += size;
+	coverage->size += size;
+	coverage->num_files++;
 	return 0;
 }
 
-static size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream)
+static void coverage_write(uint32_t value)
 {
-#if IS_ENABLED(CONFIG_DEBUG_COVERAGE)
-	printk(BIOS_DEBUG, "fwrite: %zd * %zd bytes to file %s\n",
-		nmemb, size, stream->filename);
-#endif
-	// TODO check if file is last opened file and fail otherwise.
-
-	memcpy(stream->data + stream->offset, ptr, size * nmemb);
-	stream->len += (nmemb * size) - (stream->len - stream->offset);
-	stream->offset += nmemb * size;
-	return nmemb;
+	if (coverage_data < coverage_data_end)
+		*coverage_data++ = value;
 }
 
-static void setbuf(FILE *stream, char *buf)
+static void coverage_write64(uint64_t value)
 {
-	gcc_assert(buf == 0);
+	coverage_write(value);
+	coverage_write(value >> 32);
 }
 
 static void coverage_init(void *unused)
@@ -507,7 +507,7 @@ extern int __gcov_execve(const char *, char  *const [], char *const [])
 
 #endif /* IN_LIBGCOV */
 
-#if IN_LIBGCOV >= 0
+#if IN_LIBGCOV >= 0 && !defined(__COREBOOT__)
 
 /* Optimum number of gcov_unsigned_t's read from or written to disk.  */
 #define GCOV_BLOCK_SIZE (1 << 10)
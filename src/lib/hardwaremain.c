@@ -331,6 +331,7 @@ static void bs_walk_state_machine(void)
 	while (1) {
 		struct boot_state *state;
 		boot_state_t next_id;
+		int span;
 
 		state = &boot_states[current_phase.state_id];
 
@@ -344,6 +345,8 @@ static void bs_walk_state_machine(void)
 			printk(BIOS_DEBUG, "BS: Entering %s state.\n",
 				state->name);
 
+		span = timestamp_span_begin(0, state->name);
+
 		bs_run_timers(0);
 
 		bs_sample_time(state);
@@ -380,6 +383,8 @@ static void bs_walk_state_machine(void)
 
 		bs_report_time(state);
 
+		timestamp_span_end(span);
+
 		state->complete = 1;
 	}
 }
@@ -107,7 +107,9 @@ void __gcov_merge_add(gcov_type *counters  __attribute__((unused)),
 #endif /* __COREBOOT__ */
 
 #ifdef L_gcov
+#ifndef __COREBOOT__
 #include "gcov-io.c"
+#endif
 
 struct gcov_fn_buffer {
 	struct gcov_fn_buffer *next;
@@ -122,6 +124,7 @@ static struct gcov_info *gcov_list;
 /* Size of the longest file name. */
 static size_t gcov_max_filename = 0;
 
+#ifndef __COREBOOT__
 /* Make sure path component of the given FILENAME exists, create
    missing directories. FILENAME must be writable.
    Returns zero on success, or -1 if an error occurred.  */
@@ -253,6 +256,8 @@ fail:
 	return (struct gcov_fn_buffer **)free_fn_data(gi_ptr, fn_buffer, ix);
 }
 
+#endif /* __COREBOOT__ */
+
 /* Add an unsigned value to the current crc */
 
 static gcov_unsigned_t
@@ -294,34 +299,21 @@ gcov_version(struct gcov_info *ptr, gcov_unsigned_t version,
 	return 1;
 }
 
-/* Dump the coverage counts. We merge with existing counts when
-   possible, to avoid growing the .da files ad infinitum. We use this
-   program's checksum to make sure we only accumulate whole program
-   statistics to the correct summary. An object file might be embedded
-   in two separate programs, and we must keep the two program
-   summaries separate.  */
+/* Find the totals for this execution and return the program checksum.  */
 
-static void
-gcov_exit(void)
+static gcov_unsigned_t
+gcov_program_summary(struct gcov_summary *this_prg)
 {
-	struct gcov_info *gi_ptr;
+	const struct gcov_info *gi_ptr;
 	const struct gcov_fn_info *gfi_ptr;
-	struct gcov_summary this_prg; /* summary for program.  */
-	struct gcov_summary all_prg; /* summary for all instances of program. */
 	struct gcov_ctr_summary *cs_ptr;
 	const struct gcov_ctr_info *ci_ptr;
 	unsigned int t_ix;
 	int f_ix = 0;
 	gcov_unsigned_t c_num;
-	const char *gcov_prefix;
-	int gcov_prefix_strip = 0;
-	size_t prefix_length;
-	char *gi_filename, *gi_filename_up;
 	gcov_unsigned_t crc32 = 0;
 
-	memset(&all_prg, 0, sizeof(all_prg));
-	/* Find the totals for this execution.  */
-	memset(&this_prg, 0, sizeof(this_prg));
+	memset(this_prg, 0, sizeof(*this_prg));
 	for (gi_ptr = gcov_list; gi_ptr; gi_ptr = gi_ptr->next) {
 		crc32 = crc32_unsigned(crc32, gi_ptr->stamp);
 		crc32 = crc32_unsigned(crc32, gi_ptr->n_functions);
@@ -345,7 +337,7 @@ gcov_exit(void)
 				if (!gi_ptr->merge[t_ix])
 					continue;
 
-				cs_ptr = &this_prg.ctrs[t_ix];
+				cs_ptr = &this_prg->ctrs[t_ix];
 				cs_ptr->num += ci_ptr->num;
 				crc32 = crc32_unsigned(crc32, ci_ptr->num);
 
@@ -362,7 +354,36 @@ gcov_exit(void)
 		}
 	}
 
+	return crc32;
+}
+
 #ifndef __COREBOOT__
+/* Dump the coverage counts. We merge with existing counts when
+   possible, to avoid growing the .da files ad infinitum. We use this
+   program's checksum to make sure we only accumulate whole program
+   statistics to the correct summary. An object file might be embedded
+   in two separate programs, and we must keep the two program
+   summaries separate.  */
+
+static void
+gcov_exit(void)
+{
+	struct gcov_info *gi_ptr;
+	const struct gcov_fn_info *gfi_ptr;
+	struct gcov_summary this_prg; /* summary for program.  */
+	struct gcov_summary all_prg; /* summary for all instances of program. */
+	const struct gcov_ctr_info *ci_ptr;
+	unsigned int t_ix;
+	int f_ix = 0;
+	const char *gcov_prefix;
+	int gcov_prefix_strip = 0;
+	size_t prefix_length;
+	char *gi_filename, *gi_filename_up;
+	gcov_unsigned_t crc32;
+
+	memset(&all_prg, 0, sizeof(all_prg));
+	crc32 = gcov_program_summary(&this_prg);
+
 	{
 		/* Check if the level of dirs to strip off specified. */
 		char *tmp = getenv("GCOV_PREFIX_STRIP");
@@ -383,7 +404,6 @@ gcov_exit(void)
 		if (IS_DIR_SEPARATOR(gcov_prefix[prefix_length - 1]))
 			prefix_length--;
 	} else
-#endif
 		prefix_length = 0;
 
 	/* If no prefix was specified and a prefix strip, then we assume
@@ -723,6 +743,132 @@ read_fatal:;
 				gi_filename);
 	}
 }
+#else /* __COREBOOT__ */
+/* Size in words of the data file written for GI_PTR.  */
+
+static size_t
+gcov_data_words(const struct gcov_info *gi_ptr)
+{
+	const struct gcov_fn_info *gfi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	unsigned int f_ix, t_ix;
+	/* Magic, version, stamp, the program summary and the final 0.  */
+	size_t words = 3 + 2 + GCOV_TAG_SUMMARY_LENGTH + 1;
+
+	for (f_ix = 0; f_ix != gi_ptr->n_functions; f_ix++) {
+		words += 2;
+		gfi_ptr = gi_ptr->functions[f_ix];
+		if (!gfi_ptr || gfi_ptr->key != gi_ptr)
+			continue;
+
+		words += GCOV_TAG_FUNCTION_LENGTH;
+		ci_ptr = gfi_ptr->ctrs;
+		for (t_ix = 0; t_ix < GCOV_COUNTERS; t_ix++) {
+			if (!gi_ptr->merge[t_ix])
+				continue;
+			words += 2 + GCOV_TAG_COUNTER_LENGTH(ci_ptr->num);
+			ci_ptr++;
+		}
+	}
+
+	return words;
+}
+
+static void
+gcov_write_data(const struct gcov_info *gi_ptr,
+		const struct gcov_summary *this_prg, gcov_unsigned_t crc32)
+{
+	const struct gcov_fn_info *gfi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	const struct gcov_ctr_summary *cs_tprg;
+	unsigned int f_ix, t_ix, c_num;
+
+	coverage_write(GCOV_DATA_MAGIC);
+	coverage_write(GCOV_VERSION);
+	coverage_write(gi_ptr->stamp);
+
+	/* Nothing is merged, so this is the only run of the program.  */
+	coverage_write(GCOV_TAG_PROGRAM_SUMMARY);
+	coverage_write(GCOV_TAG_SUMMARY_LENGTH);
+	coverage_write(crc32);
+	for (t_ix = 0; t_ix < GCOV_COUNTERS_SUMMABLE; t_ix++) {
+		cs_tprg = &this_prg->ctrs[t_ix];
+		if (gi_ptr->merge[t_ix]) {
+			coverage_write(cs_tprg->num);
+			coverage_write(1);
+			coverage_write64(cs_tprg->sum_all);
+			coverage_write64(cs_tprg->run_max);
+			coverage_write64(cs_tprg->run_max);
+		} else {
+			coverage_write(0);
+			coverage_write(0);
+			coverage_write64(0);
+			coverage_write64(0);
+			coverage_write64(0);
+		}
+	}
+
+	for (f_ix = 0; f_ix != gi_ptr->n_functions; f_ix++) {
+		gfi_ptr = gi_ptr->functions[f_ix];
+		coverage_write(GCOV_TAG_FUNCTION);
+		if (!gfi_ptr || gfi_ptr->key != gi_ptr) {
+			coverage_write(0);
+			continue;
+		}
+
+		coverage_write(GCOV_TAG_FUNCTION_LENGTH);
+		coverage_write(gfi_ptr->ident);
+		coverage_write(gfi_ptr->lineno_checksum);
+		coverage_write(gfi_ptr->cfg_checksum);
+
+		ci_ptr = gfi_ptr->ctrs;
+		for (t_ix = 0; t_ix < GCOV_COUNTERS; t_ix++) {
+			if (!gi_ptr->merge[t_ix])
+				continue;
+
+			coverage_write(GCOV_TAG_FOR_COUNTER(t_ix));
+			coverage_write(GCOV_TAG_COUNTER_LENGTH(ci_ptr->num));
+			for (c_num = 0; c_num < ci_ptr->num; c_num++)
+				coverage_write64(ci_ptr->values[c_num]);
+			ci_ptr++;
+		}
+	}
+
+	coverage_write(0);
+}
+
+/* Dump the coverage counts of this run into CBMEM. There are no earlier
+   files to merge with, so each object's data is written in one pass and
+   the whole area is sized before anything is written.  */
+
+static void
+gcov_exit(void)
+{
+	const struct gcov_info *gi_ptr;
+	struct gcov_summary this_prg;
+	gcov_unsigned_t crc32;
+	size_t size = 0;
+
+	crc32 = gcov_program_summary(&this_prg);
+
+	for (gi_ptr = gcov_list; gi_ptr; gi_ptr = gi_ptr->next)
+		size += coverage_file_size(gi_ptr->filename,
+			gcov_data_words(gi_ptr) * sizeof(gcov_unsigned_t));
+
+	if (coverage_open(size))
+		return;
+
+	for (gi_ptr = gcov_list; gi_ptr; gi_ptr = gi_ptr->next) {
+		if (coverage_add_file(gi_ptr->filename,
+			gcov_data_words(gi_ptr) * sizeof(gcov_unsigned_t))) {
+			fprintf(stderr, "profiling:%s:Out of space\n",
+				gi_ptr->filename);
+			return;
+		}
+		gcov_write_data(gi_ptr, &this_prg, crc32);
+	}
+}
+#endif /* __COREBOOT__ */
 
 /* Add a new object file onto the bb chain.  Invoked automatically
    when running an object file's global ctors.  */
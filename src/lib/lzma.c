@@ -10,6 +10,8 @@
  *
  */
 
+#include <commonlib/helpers.h>
+#include <commonlib/region.h>
 #include <console/console.h>
 #include <string.h>
 #include <lib.h>
@@ -17,10 +19,22 @@
 
 #include "lzmadecode.h"
 
-size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
+/* ulzman_rdev() reads its input through a buffer of this size. */
+#define LZMA_STREAM_WINDOW_SIZE (4 * KiB)
+
+#define LZMA_HEADER_SIZE (LZMA_PROPERTIES_SIZE + 8)
+
+struct lzma_rdev_stream {
+	ILzmaInCallback cb; /* Needs to be first, see lzma_rdev_read(). */
+	const struct region_device *rdev;
+	size_t offset;
+	size_t remaining;
+	unsigned char *window;
+};
+
+static size_t ulzma_decode(const unsigned char *header,
+	const unsigned char *src, size_t srcn, ILzmaInCallback *in, void *dst)
 {
-	unsigned char properties[LZMA_PROPERTIES_SIZE];
-	const int data_offset = LZMA_PROPERTIES_SIZE + 8;
 	UInt32 outSize;
 	SizeT inProcessed;
 	SizeT outProcessed;
@@ -30,14 +44,13 @@ size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
 	MAYBE_STATIC unsigned char scratchpad[15980];
 	const unsigned char *cp;
 
-	memcpy(properties, src, LZMA_PROPERTIES_SIZE);
 	/* The outSize in LZMA stream is a 64bit integer stored in little-endian
 	 * (ref: lzma.cc@LZMACompress: put_64). To prevent accessing by
 	 * unaligned memory address and to load in correct endianness, read each
 	 * byte and re-construct. */
-	cp = src + LZMA_PROPERTIES_SIZE;
+	cp = header + LZMA_PROPERTIES_SIZE;
 	outSize = cp[3] << 24 | cp[2] << 16 | cp[1] << 8 | cp[0];
-	if (LzmaDecodeProperties(&state.Properties, properties,
+	if (LzmaDecodeProperties(&state.Properties, header,
 				 LZMA_PROPERTIES_SIZE) != LZMA_RESULT_OK) {
 		printk(BIOS_WARNING, "lzma: Incorrect stream properties.\n");
 		return 0;
@@ -48,11 +61,66 @@ size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
 		return 0;
 	}
 	state.Probs = (CProb *)scratchpad;
-	res = LzmaDecode(&state, src + data_offset, srcn - data_offset,
-			 &inProcessed, dst, outSize, &outProcessed);
+	state.InCallback = in;
+	res = LzmaDecode(&state, src, srcn, &inProcessed, dst, outSize,
+			 &outProcessed);
 	if (res != 0) {
 		printk(BIOS_WARNING, "lzma: Decoding error = %d\n", res);
 		return 0;
 	}
 	return outProcessed;
 }
+
+size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	unsigned char header[LZMA_HEADER_SIZE];
+
+	if (srcn < LZMA_HEADER_SIZE)
+		return 0;
+
+	memcpy(header, src, LZMA_HEADER_SIZE);
+
+	return ulzma_decode(header, src + LZMA_HEADER_SIZE,
+			    srcn - LZMA_HEADER_SIZE, NULL, dst);
+}
+
+static int lzma_rdev_read(void *object, const unsigned char **buffer,
+			  SizeT *size)
+{
+	struct lzma_rdev_stream *s = object;
+	size_t len = MIN(s->remaining, LZMA_STREAM_WINDOW_SIZE);
+
+	if (len && rdev_readat(s->rdev, s->window, s->offset, len) != len)
+		return LZMA_RESULT_DATA_ERROR;
+
+	s->offset += len;
+	s->remaining -= len;
+	*buffer = s->window;
+	*size = len;
+
+	return LZMA_RESULT_OK;
+}
+
+size_t ulzman_rdev(const struct region_device *rdev, size_t offset,
+		   size_t srcn, void *dst, size_t dstn)
+{
+	unsigned char header[LZMA_HEADER_SIZE];
+	MAYBE_STATIC unsigned char window[LZMA_STREAM_WINDOW_SIZE]
+		__attribute__((aligned(4)));
+	struct lzma_rdev_stream s = {
+		.cb = { .Read = lzma_rdev_read },
+		.rdev = rdev,
+		.offset = offset + LZMA_HEADER_SIZE,
+		.remaining = srcn - LZMA_HEADER_SIZE,
+		.window = window,
+	};
+
+	if (srcn < LZMA_HEADER_SIZE)
+		return 0;
+
+	if (rdev_readat(rdev, header, offset, LZMA_HEADER_SIZE) !=
+	    LZMA_HEADER_SIZE)
+		return 0;
+
+	return ulzma_decode(header, NULL, 0, &s.cb, dst);
+}
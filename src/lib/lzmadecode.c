@@ -20,6 +20,7 @@
 */
 
 #include "lzmadecode.h"
+#include <stddef.h>
 #include <stdint.h>
 
 #define kNumTopBits 24
@@ -30,9 +31,10 @@
 #define kNumMoveBits 5
 
 /* Use 32-bit reads whenever possible to avoid bad flash performance. Fall back
- * to byte reads for last 4 bytes since RC_TEST returns an error when BufferLim
- * is *reached* (not surpassed!), meaning we can't allow that to happen while
- * there are still bytes to decode from the algorithm's point of view. */
+ * to byte reads for last 4 bytes since RC_TEST returns an error (or fetches
+ * the next chunk of input) when BufferLim is *reached* (not surpassed!),
+ * meaning we can't allow that to happen while there are still bytes to decode
+ * from the algorithm's point of view. */
 #define RC_READ_BYTE							\
 	(look_ahead_ptr < 4 ? look_ahead.raw[look_ahead_ptr++]		\
 	: ((((uintptr_t) Buffer & 3)					\
@@ -51,7 +53,18 @@
 }
 
 
-#define RC_TEST { if (Buffer == BufferLim) return LZMA_RESULT_DATA_ERROR; }
+#define RC_TEST {							\
+	if (Buffer == BufferLim) {					\
+		SizeT size;						\
+									\
+		if (InCallback == NULL					\
+			|| InCallback->Read(InCallback, &Buffer, &size)	\
+				!= LZMA_RESULT_OK			\
+			|| size == 0)					\
+			return LZMA_RESULT_DATA_ERROR;			\
+		BufferLim = Buffer + size;				\
+	}								\
+}
 
 #define RC_INIT(buffer, bufferSize) Buffer = buffer; \
 	BufferLim = buffer + bufferSize; RC_INIT2
@@ -207,6 +220,7 @@ int LzmaDecode(CLzmaDecoderState *vs,
 	} look_ahead;
 	UInt32 Range;
 	UInt32 Code;
+	ILzmaInCallback *InCallback = vs->InCallback;
 
 	*inSizeProcessed = 0;
 	*outSizeProcessed = 0;
@@ -423,7 +437,8 @@ int LzmaDecode(CLzmaDecoderState *vs,
 	RC_NORMALIZE;
 
 
-	*inSizeProcessed = (SizeT)(Buffer - inStream);
+	if (InCallback == NULL)
+		*inSizeProcessed = (SizeT)(Buffer - inStream);
 	*outSizeProcessed = nowPos;
 	return LZMA_RESULT_OK;
 }
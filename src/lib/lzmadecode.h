@@ -52,9 +52,18 @@ int LzmaDecodeProperties(CLzmaProperties *propsRes,
 
 #define kLzmaNeedInitId (-2)
 
+/* Supplies the next chunk of input when the current one is used up. A chunk
+ * of size 0 means there is no more input. */
+typedef struct _ILzmaInCallback {
+	int (*Read)(void *object, const unsigned char **buffer,
+		SizeT *bufferSize);
+} ILzmaInCallback;
+
 typedef struct _CLzmaDecoderState {
 	CLzmaProperties Properties;
 	CProb *Probs;
+	/* If set, inStream/inSize are only the first chunk of the input. */
+	ILzmaInCallback *InCallback;
 } CLzmaDecoderState;
 
 
@@ -1,6 +1,14 @@
 #include <stdlib.h>
 #include <console/console.h>
 #include <cpu/x86/smm.h>
+#if ENV_RAMSTAGE && !IS_ENABLED(CONFIG_HEAP_BUMP_ALLOCATOR)
+#include <bootstate.h>
+#include <cbmem.h>
+#include <commonlib/heap_stats_serialized.h>
+#include <lib.h>
+#include <smp/spinlock.h>
+#include <string.h>
+#endif
 
 #if IS_ENABLED(CONFIG_DEBUG_MALLOC)
 #define MALLOCDBG(x...) printk(BIOS_SPEW, x)
@@ -9,6 +17,9 @@
 #endif
 
 extern unsigned char _heap, _eheap;
+
+#if !ENV_RAMSTAGE || IS_ENABLED(CONFIG_HEAP_BUMP_ALLOCATOR)
+
 static void *free_mem_ptr = &_heap;		/* Start of heap */
 static void *free_mem_end_ptr = &_eheap;	/* End of heap */
 
@@ -42,6 +53,141 @@ void *memalign(size_t boundary, size_t size)
 	return p;
 }
 
+#else
+
+/* Small heap, fewer second level lists. */
+#define TLSF_SL_LOG2	2
+#include <commonlib/tlsf.c.inc>
+
+static struct {
+	struct tlsf pool;
+	uint32_t peak_in_use;
+	uint32_t num_allocs;
+	uint32_t num_frees;
+} heap;
+
+static struct heap_stats *heap_stats;
+
+DECLARE_SPIN_LOCK(heap_lock)
+
+static void heap_fill_stats(struct heap_stats *stats)
+{
+	struct tlsf_block *b;
+
+	memset(stats, 0, sizeof(*stats));
+	if (heap.pool.first == NULL)
+		return;
+
+	stats->heap_size = tlsf_pool_size(&heap.pool);
+	stats->in_use = heap.pool.in_use;
+	stats->peak_in_use = heap.peak_in_use;
+	stats->num_allocs = heap.num_allocs;
+	stats->num_frees = heap.num_frees;
+	for (b = heap.pool.first; b != heap.pool.last; b = tlsf_next_block(b)) {
+		if (tlsf_block_used(b))
+			continue;
+		stats->free_blocks++;
+		if (tlsf_block_size(b) > stats->largest_free)
+			stats->largest_free = tlsf_block_size(b);
+	}
+}
+
+void *memalign(size_t boundary, size_t size)
+{
+	struct tlsf_block *b;
+	struct heap_stats stats;
+
+	MALLOCDBG("%s Enter, boundary %zu, size %zu\n", __func__, boundary,
+		  size);
+
+	spin_lock(&heap_lock);
+
+	if (heap.pool.first == NULL)
+		tlsf_init(&heap.pool, &_heap, &_eheap);
+
+	b = tlsf_alloc(&heap.pool, size, boundary);
+	if (b == NULL) {
+		heap_fill_stats(&stats);
+		spin_unlock(&heap_lock);
+		printk(BIOS_ERR, "memalign(boundary=%zu, size=%zu): failed: ",
+				boundary, size);
+		printk(BIOS_ERR, "%u of %u bytes in use, ", stats.in_use,
+				stats.heap_size);
+		printk(BIOS_ERR, "largest free block %u bytes\n",
+				stats.largest_free);
+		die("Error! memalign: Out of memory");
+	}
+
+	if (heap.pool.in_use > heap.peak_in_use)
+		heap.peak_in_use = heap.pool.in_use;
+	heap.num_allocs++;
+
+	spin_unlock(&heap_lock);
+
+	MALLOCDBG("memalign %p\n", tlsf_block_data(b));
+
+	return tlsf_block_data(b);
+}
+
+void free(void *ptr)
+{
+	struct tlsf_block *b;
+
+	MALLOCDBG("free %p\n", ptr);
+
+	spin_lock(&heap_lock);
+
+	/* Silently ignore anything that was never part of the heap. */
+	if (heap.pool.first == NULL ||
+	    ptr < tlsf_block_data(heap.pool.first) ||
+	    ptr >= (void *)heap.pool.last) {
+		spin_unlock(&heap_lock);
+		return;
+	}
+
+	b = tlsf_used_block(&heap.pool, ptr);
+	if (b == NULL) {
+		spin_unlock(&heap_lock);
+		printk(BIOS_ERR, "free(%p): not allocated\n", ptr);
+		return;
+	}
+
+	tlsf_release(&heap.pool, b);
+	heap.num_frees++;
+
+	spin_unlock(&heap_lock);
+}
+
+static void heap_stats_snapshot(void *unused)
+{
+	if (heap_stats == NULL)
+		return;
+
+	spin_lock(&heap_lock);
+	heap_fill_stats(heap_stats);
+	spin_unlock(&heap_lock);
+
+	printk(BIOS_DEBUG, "Heap: %u of %u bytes in use, peak %u, "
+	       "%u allocs, %u frees, largest free block %u\n",
+	       heap_stats->in_use, heap_stats->heap_size,
+	       heap_stats->peak_in_use, heap_stats->num_allocs,
+	       heap_stats->num_frees, heap_stats->largest_free);
+}
+
+static void heap_stats_init(int is_recovery)
+{
+	heap_stats = cbmem_add(CBMEM_ID_HEAP_STATS, sizeof(*heap_stats));
+	if (heap_stats == NULL)
+		printk(BIOS_ERR, "ERROR: No heap statistics allocated\n");
+}
+
+RAMSTAGE_CBMEM_INIT_HOOK(heap_stats_init)
+
+BOOT_STATE_INIT_ENTRY(BS_PAYLOAD_BOOT, BS_ON_ENTRY, heap_stats_snapshot, NULL);
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME, BS_ON_ENTRY, heap_stats_snapshot, NULL);
+
+#endif
+
 void *malloc(size_t size)
 {
 	return memalign(sizeof(u64), size);
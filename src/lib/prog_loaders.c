@@ -168,16 +168,25 @@ void __attribute__((weak)) mirror_payload(struct prog *payload)
 {
 }
 
+static int payload_prefetched;
+
 void payload_load(void)
 {
 	struct prog *payload = &global_payload;
 
 	timestamp_add_now(TS_LOAD_PAYLOAD);
 
+	/*
+	 * Locate the payload again even if it was prefetched: a mirror made
+	 * for the prefetch may have been overwritten since, and selfload()
+	 * reads the boot media if the staged copy can't be used.
+	 */
 	if (prog_locate(payload))
 		goto out;
 
-	mirror_payload(payload);
+	/* A prefetched payload is already staged. */
+	if (!payload_prefetched)
+		mirror_payload(payload);
 
 	/* Pass cbtables to payload if architecture desires it. */
 	prog_set_entry(payload, selfload(payload, true),
@@ -188,6 +197,43 @@ out:
 		die("Payload not loaded.\n");
 }
 
+#if IS_ENABLED(CONFIG_PAYLOAD_PREFETCH)
+#include <arch/acpi.h>
+#include <bootstate.h>
+#include <thread.h>
+
+static void payload_prefetch(void *arg)
+{
+	struct prog *payload = arg;
+
+	timestamp_add_now(TS_START_PAYLOAD_PREFETCH);
+
+	if (!prog_locate(payload))
+		payload_prefetched = !selfload_prefetch(payload);
+
+	timestamp_add_now(TS_END_PAYLOAD_PREFETCH);
+
+	if (!payload_prefetched)
+		printk(BIOS_INFO, "Payload prefetch failed.\n");
+}
+
+/* Decompress the payload in a thread that runs whenever device init waits
+ * in udelay(). The memory map is only known once resources are assigned, and
+ * the staging buffer must not be written while CBMEM grows for the tables. */
+static void payload_prefetch_start(void *unused)
+{
+	if (acpi_is_wakeup_s3())
+		return;
+
+	if (thread_run_until(payload_prefetch, &global_payload,
+			     BS_WRITE_TABLES, BS_ON_ENTRY))
+		printk(BIOS_INFO, "Payload prefetch thread not started.\n");
+}
+
+BOOT_STATE_INIT_ENTRY(BS_DEV_ENABLE, BS_ON_ENTRY, payload_prefetch_start,
+		      NULL);
+#endif
+
 void payload_run(void)
 {
 	struct prog *payload = &global_payload;
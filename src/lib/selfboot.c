@@ -24,6 +24,7 @@
 #include <string.h>
 #include <symbols.h>
 #include <cbfs.h>
+#include <cbmem.h>
 #include <lib.h>
 #include <bootmem.h>
 #include <program_loading.h>
@@ -441,6 +442,18 @@ static int load_self_segments(struct segment *head, struct prog *payload,
 				return 0;
 			break;
 		}
+		case CBFS_COMPRESS_ZSTD: {
+			/* The decoder is only built in for ZSTD payloads. */
+			if (!IS_ENABLED(CONFIG_COMPRESSED_PAYLOAD_ZSTD))
+				return 0;
+			printk(BIOS_DEBUG, "using ZSTD\n");
+			timestamp_add_now(TS_START_UZSTD);
+			len = uzstdn(src, len, dest, memsz);
+			timestamp_add_now(TS_END_UZSTD);
+			if (!len) /* Decompression Error. */
+				return 0;
+			break;
+		}
 		case CBFS_COMPRESS_NONE: {
 			printk(BIOS_DEBUG, "it's not compressed!\n");
 			memcpy(dest, src, len);
@@ -512,12 +525,203 @@ static int load_self_segments(struct segment *head, struct prog *payload,
 	return 1;
 }
 
+/* Segment list of a payload decompressed by selfload_prefetch(). */
+static struct segment prefetch_head;
+static uintptr_t prefetch_entry;
+static uintptr_t prefetch_buf;
+static size_t prefetch_size;
+static uintptr_t prefetch_guard;
+static int prefetch_done;
+
+/*
+ * CBMEM keeps growing down from its current bottom until the tables are
+ * written. Nothing gets staged in the headroom left below it, and the
+ * prefetch is abandoned once CBMEM grows past that.
+ */
+#define PREFETCH_CBMEM_HEADROOM (4 * MiB)
+
+/* The payload is read in chunks of this size, see selfload_prefetch(). */
+static uint8_t prefetch_chunk[4 * KiB];
+
+/*
+ * Whether CBMEM grew into the headroom since selfload_prefetch() started. The
+ * thread only gives up the CPU in udelay(), so CBMEM can't grow between this
+ * check and the writes following it as long as they don't wait on anything.
+ */
+static int prefetch_overrun(void)
+{
+	uintptr_t cbmem_base;
+	size_t cbmem_size;
+
+	cbmem_region_used(&cbmem_base, &cbmem_size);
+	return cbmem_base < prefetch_guard;
+}
+
+int selfload_prefetch(struct prog *payload)
+{
+	const struct region_device *rdev = prog_rdev(payload);
+	const size_t file_size = region_device_sz(rdev);
+	struct segment *ptr;
+	uintptr_t cbmem_base;
+	size_t cbmem_size;
+	size_t offset, len;
+	size_t size = 0;
+	unsigned char *buf;
+	unsigned char *data;
+
+	/*
+	 * Build an early memory map to find room for the staging buffers.
+	 * It is replaced when the tables are written, so the buffers go
+	 * back to the OS and nothing needs to be released on error.
+	 */
+	bootmem_init();
+	cbmem_region_used(&cbmem_base, &cbmem_size);
+	if (cbmem_base < PREFETCH_CBMEM_HEADROOM)
+		return -1;
+	prefetch_guard = cbmem_base - PREFETCH_CBMEM_HEADROOM;
+	bootmem_add_range(prefetch_guard, PREFETCH_CBMEM_HEADROOM,
+			  LB_MEM_UNUSABLE);
+
+	/* Any mirror of the payload has to come from the same map. */
+	mirror_payload(payload);
+	rdev = prog_rdev(payload);
+
+	data = bootmem_allocate_buffer(file_size);
+	if (data == NULL)
+		return -1;
+
+	/*
+	 * Reading may wait on the boot media and let device init run, which
+	 * can grow CBMEM. Read into a static chunk and only copy it to data
+	 * once CBMEM is known to have stayed clear. This also means no
+	 * mapping of the boot media is held while the thread yields.
+	 */
+	for (offset = 0; offset < file_size; offset += len) {
+		len = MIN(file_size - offset, sizeof(prefetch_chunk));
+		if (rdev_readat(rdev, prefetch_chunk, offset, len) != len)
+			return -1;
+		if (prefetch_overrun())
+			return -1;
+		memcpy(&data[offset], prefetch_chunk, len);
+	}
+
+	if (build_self_segment_list(&prefetch_head, (void *)data,
+				    &prefetch_entry) != 1)
+		return -1;
+
+	for (ptr = prefetch_head.next; ptr != &prefetch_head; ptr = ptr->next) {
+		if (ptr->s_filesz)
+			size += ALIGN_UP(ptr->s_memsz, 16);
+	}
+
+	buf = size ? bootmem_allocate_buffer(size) : NULL;
+
+	if (size && buf == NULL)
+		return -1;
+
+	prefetch_buf = (uintptr_t)buf;
+	prefetch_size = size;
+
+	/* Stage the contents of all segments, so that decompression is not
+	 * needed any more when loading the payload. */
+	for (ptr = prefetch_head.next; ptr != &prefetch_head; ptr = ptr->next) {
+		const void *src = (const void *)ptr->s_srcaddr;
+
+		len = ptr->s_filesz;
+		if (len == 0)
+			continue;
+
+		if (prefetch_overrun())
+			return -1;
+
+		switch (ptr->compression) {
+		case CBFS_COMPRESS_LZMA:
+			len = ulzman(src, len, buf, ptr->s_memsz);
+			break;
+		case CBFS_COMPRESS_LZ4:
+			len = ulz4fn(src, len, buf, ptr->s_memsz);
+			break;
+		case CBFS_COMPRESS_ZSTD:
+			if (IS_ENABLED(CONFIG_COMPRESSED_PAYLOAD_ZSTD))
+				len = uzstdn(src, len, buf, ptr->s_memsz);
+			else
+				len = 0;
+			break;
+		case CBFS_COMPRESS_NONE:
+			memcpy(buf, src, len);
+			break;
+		default:
+			len = 0;
+			break;
+		}
+
+		if (len == 0)
+			return -1;
+
+		ptr->s_srcaddr = (uintptr_t)buf;
+		ptr->s_filesz = len;
+		ptr->compression = CBFS_COMPRESS_NONE;
+		buf += ALIGN_UP(ptr->s_memsz, 16);
+	}
+
+	prefetch_done = 1;
+
+	return 0;
+}
+
+/*
+ * The staging buffer is only usable if neither CBMEM nor the payload itself
+ * ended up on top of it. Reserve it in the final memory map until the
+ * segments are loaded; the table handed to the OS is already written.
+ */
+static int prefetch_usable(void)
+{
+	struct segment *ptr;
+	const uintptr_t end = prefetch_buf + prefetch_size;
+
+	if (prefetch_size == 0)
+		return 1;
+
+	if (prefetch_overrun())
+		return 0;
+
+	for (ptr = prefetch_head.next; ptr != &prefetch_head; ptr = ptr->next) {
+		if (ptr->s_dstaddr < end &&
+		    ptr->s_dstaddr + ptr->s_memsz > prefetch_buf)
+			return 0;
+	}
+
+	bootmem_add_range(prefetch_buf, prefetch_size, LB_MEM_UNUSABLE);
+
+	return 1;
+}
+
 void *selfload(struct prog *payload, bool check_regions)
 {
 	uintptr_t entry = 0;
 	struct segment head;
 	void *data;
 
+	if (prefetch_done && prefetch_usable()) {
+		prefetch_done = 0;
+
+		if (!load_self_segments(&prefetch_head, payload, check_regions))
+			return NULL;
+
+		printk(BIOS_SPEW, "Loaded prefetched segments\n");
+
+		prog_set_area(payload, (void *)(uintptr_t)bounce_buffer,
+			      bounce_size);
+
+		return (void *)prefetch_entry;
+	}
+
+	if (prefetch_done) {
+		prefetch_done = 0;
+		printk(BIOS_INFO, "Prefetched payload is overlapped, "
+		       "loading it again.\n");
+	}
+
 	data = rdev_mmap_full(prog_rdev(payload));
 
 	if (data == NULL)
@@ -17,8 +17,13 @@
 #include <stdlib.h>
 #include <arch/cpu.h>
 #include <bootstate.h>
+#include <commonlib/region.h>
 #include <console/console.h>
+#include <smp/spinlock.h>
 #include <thread.h>
+#if IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK)
+#include <cpu/x86/mp.h>
+#endif
 
 static void idle_thread_init(void);
 
@@ -29,9 +34,12 @@ static void idle_thread_init(void);
 static struct thread all_threads[TOTAL_NUM_THREADS];
 
 /* All runnable (but not running) and free threads are kept on their
- * respective lists. */
-static struct thread *runnable_threads;
+ * respective lists. Each CPU has its own list of runnable threads. The lists
+ * are only shared with the APs when PARALLEL_MP_AP_WORK lets threads run
+ * there, thread_lock protects them in that case. */
+static struct thread *runnable_threads[CONFIG_MAX_CPUS];
 static struct thread *free_threads;
+DECLARE_SPIN_LOCK(thread_lock)
 
 static inline struct cpu_info *thread_cpu_info(const struct thread *t)
 {
@@ -77,24 +85,35 @@ static inline void push_thread(struct thread **list, struct thread *t)
 
 static inline void push_runnable(struct thread *t)
 {
-	push_thread(&runnable_threads, t);
+	spin_lock(&thread_lock);
+	push_thread(&runnable_threads[t->cpu], t);
+	spin_unlock(&thread_lock);
 }
 
-static inline struct thread *pop_runnable(void)
+static inline struct thread *pop_runnable(int cpu)
 {
-	return pop_thread(&runnable_threads);
+	struct thread *t = NULL;
+
+	spin_lock(&thread_lock);
+	if (!thread_list_empty(&runnable_threads[cpu]))
+		t = pop_thread(&runnable_threads[cpu]);
+	spin_unlock(&thread_lock);
+	return t;
 }
 
 static inline struct thread *get_free_thread(void)
 {
-	struct thread *t;
+	struct thread *t = NULL;
 	struct cpu_info *ci;
 	struct cpu_info *new_ci;
 
-	if (thread_list_empty(&free_threads))
-		return NULL;
+	spin_lock(&thread_lock);
+	if (!thread_list_empty(&free_threads))
+		t = pop_thread(&free_threads);
+	spin_unlock(&thread_lock);
 
-	t = pop_thread(&free_threads);
+	if (t == NULL)
+		return NULL;
 
 	ci = cpu_info();
 
@@ -106,12 +125,18 @@ static inline struct thread *get_free_thread(void)
 	/* Reset the current stack value to the original. */
 	t->stack_current = t->stack_orig;
 
+	/* Threads run on the BSP unless they are bound to an AP. */
+	t->cpu = 0;
+	t->handle = NULL;
+
 	return t;
 }
 
 static inline void free_thread(struct thread *t)
 {
+	spin_lock(&thread_lock);
 	push_thread(&free_threads, t);
+	spin_unlock(&thread_lock);
 }
 
 /* The idle thread is ran whenever there isn't anything else that is runnable.
@@ -131,9 +156,9 @@ static void schedule(struct thread *t)
 
 	/* If t is NULL need to find new runnable thread. */
 	if (t == NULL) {
-		if (thread_list_empty(&runnable_threads))
+		t = pop_runnable(current->cpu);
+		if (t == NULL)
 			die("Runnable thread list is empty!\n");
-		t = pop_runnable();
 	} else {
 		/* current is still runnable. */
 		push_runnable(current);
@@ -141,8 +166,114 @@ static void schedule(struct thread *t)
 	switch_to_thread(t->stack_current, &current->stack_current);
 }
 
+#if IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK)
+/* The context each AP entered ap_run_threads() with. */
+static struct thread ap_idle_threads[CONFIG_MAX_CPUS];
+/* Whether an AP is in ap_run_threads(), protected by thread_lock. */
+static int ap_running[CONFIG_MAX_CPUS];
+
+/* Called on an AP through mp_run_on_ap(). The threads bound to the AP run one
+ * after the other to completion, after which the AP goes back to waiting for
+ * other work. */
+static void ap_run_threads(void)
+{
+	struct cpu_info *ci = cpu_info();
+	const int cpu = ci->index;
+	struct thread *idle = &ap_idle_threads[cpu];
+	struct thread *t;
+	struct cpu_info *new_ci;
+
+	idle->stack_orig = (uintptr_t)ci;
+	idle->cpu = cpu;
+	idle->can_yield = 0;
+	ci->thread = idle;
+
+	while (1) {
+		spin_lock(&thread_lock);
+		if (thread_list_empty(&runnable_threads[cpu])) {
+			ap_running[cpu] = 0;
+			spin_unlock(&thread_lock);
+			break;
+		}
+		t = pop_thread(&runnable_threads[cpu]);
+		spin_unlock(&thread_lock);
+
+		/* The thread was set up on the BSP, make it this CPU's. */
+		new_ci = thread_cpu_info(t);
+		*new_ci = *ci;
+		new_ci->thread = t;
+
+		switch_to_thread(t->stack_current, &idle->stack_current);
+
+		/* Only free the thread now that its stack is no longer used. */
+		free_thread(t);
+	}
+
+	ci->thread = NULL;
+}
+
+static void unlink_thread(struct thread **list, struct thread *t)
+{
+	for (; *list != NULL; list = &(*list)->next) {
+		if (*list == t) {
+			*list = t->next;
+			t->next = NULL;
+			return;
+		}
+	}
+}
+
+static int ap_thread_start(struct thread *t)
+{
+	int start;
+
+	spin_lock(&thread_lock);
+	push_thread(&runnable_threads[t->cpu], t);
+	start = !ap_running[t->cpu];
+	ap_running[t->cpu] = 1;
+	spin_unlock(&thread_lock);
+
+	if (!start)
+		return 0;
+
+	if (mp_run_on_ap(t->cpu, ap_run_threads, 100 * USECS_PER_MSEC) == 0)
+		return 0;
+
+	/* ap_run_threads() will never run, so nothing else touches t. */
+	spin_lock(&thread_lock);
+	unlink_thread(&runnable_threads[t->cpu], t);
+	ap_running[t->cpu] = 0;
+	spin_unlock(&thread_lock);
+	free_thread(t);
+
+	return -1;
+}
+
+static void ap_thread_exit(struct thread *t)
+{
+	/* ap_run_threads() frees the thread. */
+	switch_to_thread(ap_idle_threads[t->cpu].stack_current,
+			 &t->stack_current);
+}
+#else
+static int ap_thread_start(struct thread *t)
+{
+	return -1;
+}
+
+static void ap_thread_exit(struct thread *t)
+{
+}
+#endif
+
 static void terminate_thread(struct thread *t)
 {
+	if (t->handle != NULL)
+		t->handle->state = THREAD_DONE;
+
+	if (t->cpu != 0)
+		ap_thread_exit(t);
+
 	free_thread(t);
 	schedule(NULL);
 }
@@ -336,6 +467,90 @@ int thread_run_until(void (*func)(void *), void *arg,
 	return 0;
 }
 
+int thread_run_on_cpu(struct thread_handle *handle, unsigned int cpu,
+		      void (*func)(void *), void *arg)
+{
+	struct thread *current;
+	struct thread *t;
+
+	current = current_thread();
+
+	if (cpu >= CONFIG_MAX_CPUS || (cpu != 0 &&
+	    !IS_ENABLED(CONFIG_PARALLEL_MP_AP_WORK))) {
+		printk(BIOS_ERR, "thread_run_on_cpu() CPU %u unavailable!\n",
+		       cpu);
+		return -1;
+	}
+
+	if (current == NULL || current->cpu != 0 ||
+	    (cpu == 0 && !thread_can_yield(current))) {
+		printk(BIOS_ERR,
+		       "thread_run_on_cpu() called from wrong context!\n");
+		return -1;
+	}
+
+	t = get_free_thread();
+
+	if (t == NULL) {
+		printk(BIOS_ERR, "thread_run_on_cpu() No more threads!\n");
+		return -1;
+	}
+
+	if (handle != NULL) {
+		handle->state = THREAD_STARTED;
+		handle->cpu = cpu;
+	}
+
+	if (cpu == 0) {
+		prepare_thread(t, func, arg, call_wrapper_block_current, NULL);
+		t->handle = handle;
+		schedule(t);
+		return 0;
+	}
+
+	/* Threads on an AP neither yield nor block any boot state. */
+	prepare_thread(t, func, arg, call_wrapper, NULL);
+	t->can_yield = 0;
+	t->cpu = cpu;
+	t->handle = handle;
+
+	if (ap_thread_start(t) < 0) {
+		if (handle != NULL)
+			handle->state = THREAD_FAILED;
+		printk(BIOS_ERR, "thread_run_on_cpu() CPU %u not responding!\n",
+		       cpu);
+		return -1;
+	}
+
+	return 0;
+}
+
+int thread_join(struct thread_handle *handle, long expire_us)
+{
+	struct stopwatch sw;
+
+	stopwatch_init_usecs_expire(&sw, expire_us);
+	while (handle->state == THREAD_STARTED) {
+		if (stopwatch_expired(&sw)) {
+			printk(BIOS_ERR, "thread_join() timed out!\n");
+			return -1;
+		}
+
+		if (thread_yield_microseconds(10) == 0)
+			continue;
+
+		/* Without yielding only threads on an AP make progress. */
+		if (handle->cpu == 0) {
+			printk(BIOS_ERR,
+			       "thread_join() called from non-yielding context!\n");
+			return -1;
+		}
+		cpu_relax();
+	}
+
+	return handle->state == THREAD_DONE ? 0 : -1;
+}
+
 int thread_yield_microseconds(unsigned int microsecs)
 {
 	struct thread *current;
@@ -352,6 +567,13 @@ int thread_yield_microseconds(unsigned int microsecs)
 	return 0;
 }
 
+/* Let other threads run while waiting for an asynchronous region device
+ * read to finish. */
+void rdev_async_idle(void)
+{
+	thread_yield_microseconds(10);
+}
+
 void thread_cooperate(void)
 {
 	struct thread *current;
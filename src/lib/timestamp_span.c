@@ -0,0 +1,108 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/cpu.h>
+#include <cbmem.h>
+#include <console/console.h>
+#include <smp/spinlock.h>
+#include <string.h>
+#include <timestamp.h>
+
+static struct timestamp_span_table *span_table;
+/* Index + 1 of the innermost open span on each CPU. */
+static uint16_t current_span[CONFIG_MAX_CPUS];
+
+DECLARE_SPIN_LOCK(span_lock)
+
+static unsigned int span_cpu(void)
+{
+#if IS_ENABLED(CONFIG_ARCH_X86)
+	return cpu_index();
+#else
+	return 0;
+#endif
+}
+
+int timestamp_span_begin(enum timestamp_id id, const char *label)
+{
+	struct timestamp_span_table *table = span_table;
+	struct timestamp_span *span;
+	unsigned int cpu = span_cpu();
+	int index = -1;
+
+	if (table == NULL || cpu >= CONFIG_MAX_CPUS)
+		return -1;
+
+	spin_lock(&span_lock);
+	if (table->num_entries < table->max_entries)
+		index = table->num_entries++;
+	spin_unlock(&span_lock);
+
+	if (index < 0)
+		return -1;
+
+	span = &table->entries[index];
+	span->id = id;
+	span->parent = current_span[cpu];
+	span->cpu = cpu;
+	span->end = 0;
+	memset(span->label, 0, sizeof(span->label));
+	if (label)
+		strncpy(span->label, label, sizeof(span->label) - 1);
+
+	current_span[cpu] = index + 1;
+	span->start = timestamp_get() - table->base_time;
+
+	return index;
+}
+
+void timestamp_span_end(int index)
+{
+	struct timestamp_span_table *table = span_table;
+	struct timestamp_span *span;
+
+	if (table == NULL || index < 0 || index >= table->num_entries)
+		return;
+
+	span = &table->entries[index];
+	span->end = timestamp_get() - table->base_time;
+	current_span[span->cpu] = span->parent;
+}
+
+static void timestamp_span_init(int is_recovery)
+{
+	const size_t size = sizeof(struct timestamp_span_table) +
+		CONFIG_TIMESTAMP_SPANS_MAX * sizeof(struct timestamp_span);
+	struct timestamp_span_table *table;
+	struct timestamp_table *ts_table;
+
+	table = cbmem_add(CBMEM_ID_TIMESTAMP_SPANS, size);
+	if (table == NULL) {
+		printk(BIOS_ERR, "ERROR: No timestamp span table allocated\n");
+		return;
+	}
+
+	/* Use the same time base as the flat timestamps. */
+	ts_table = cbmem_find(CBMEM_ID_TIMESTAMP);
+
+	table->version = TIMESTAMP_SPAN_VERSION;
+	table->tick_freq_mhz = timestamp_tick_freq_mhz();
+	table->reserved = 0;
+	table->base_time = ts_table ? ts_table->base_time : 0;
+	table->max_entries = CONFIG_TIMESTAMP_SPANS_MAX;
+	table->num_entries = 0;
+
+	span_table = table;
+}
+
+RAMSTAGE_CBMEM_INIT_HOOK(timestamp_span_init)
@@ -13,23 +13,120 @@
  * GNU General Public License for more details.
  */
 
-#include <types.h>
+#include <cbmem.h>
+#include <commonlib/func_trace_serialized.h>
 #include <console/console.h>
+#include <string.h>
+#include <symbols.h>
+#include <timestamp.h>
 #include <trace.h>
+#include <types.h>
+#if IS_ENABLED(CONFIG_ARCH_X86)
+#include <arch/cpu.h>
+#endif
+
+/*
+ * Every function entry and exit is written as a fixed size record into a ring
+ * in CBMEM. Nothing called from the hooks may be instrumented itself, so on
+ * x86 the time stamp and the CPU are read inline. Elsewhere timestamp_get()
+ * is called with tracing disabled.
+ */
+
+#define NOTRACE	__attribute__((no_instrument_function))
 
 int volatile trace_dis = 0;
 
-void __cyg_profile_func_enter(void *func, void *callsite)
+static struct func_trace_buffer *trace_buffer;
+
+#if IS_ENABLED(CONFIG_ARCH_X86)
+static inline NOTRACE uint64_t trace_time(void)
+{
+	uint32_t lo, hi;
+
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * cpu_index() without calling cpu_info(), which would be instrumented. The
+ * struct cpu_info sits at the top of every stack, see cpu_info().
+ */
+static inline NOTRACE uint16_t trace_cpu(void)
+{
+	uintptr_t ci;
+
+#ifdef __x86_64__
+	asm ("and %%rsp, %0" : "=r" (ci) : "0" (~(CONFIG_STACK_SIZE - 1UL)));
+#else
+	asm ("andl %%esp, %0" : "=r" (ci) : "0" (~(CONFIG_STACK_SIZE - 1)));
+#endif
+	ci += CONFIG_STACK_SIZE - sizeof(struct cpu_info);
+	return ((struct cpu_info *)ci)->index;
+}
+#else
+static inline NOTRACE uint64_t trace_time(void)
+{
+	uint64_t t;
+
+	trace_dis = 1;
+	t = timestamp_get();
+	trace_dis = 0;
+	return t;
+}
+
+static inline NOTRACE uint16_t trace_cpu(void)
 {
+	return 0;
+}
+#endif
 
-	if (trace_dis)
+static inline NOTRACE void trace_record(void *func, void *call_site,
+					uint16_t flags)
+{
+	struct func_trace_buffer *buf = trace_buffer;
+	struct func_trace_record *r;
+	uint32_t n;
+
+	if (buf == NULL || trace_dis)
 		return;
 
-	DISABLE_TRACE
-	printk(BIOS_INFO, "~0x%p(0x%p)\n", func, callsite);
-	ENABLE_TRACE
+	n = __sync_fetch_and_add(&buf->head, 1);
+	r = &buf->records[n % buf->max_records];
+	r->tsc = trace_time();
+	r->func = (uintptr_t)func - (uintptr_t)_program;
+	r->call_site = (uintptr_t)call_site - (uintptr_t)_program;
+	r->cpu = trace_cpu();
+	r->flags = flags;
+}
+
+void __cyg_profile_func_enter(void *func, void *callsite)
+{
+	trace_record(func, callsite, 0);
 }
 
 void __cyg_profile_func_exit(void *func, void *callsite)
 {
+	trace_record(func, callsite, FUNC_TRACE_EXIT);
 }
+
+static void trace_init(int is_recovery)
+{
+	const size_t size = sizeof(struct func_trace_buffer) +
+		CONFIG_TRACE_BUFFER_RECORDS * sizeof(struct func_trace_record);
+	struct func_trace_buffer *buf;
+
+	buf = cbmem_add(CBMEM_ID_FUNC_TRACE, size);
+	if (buf == NULL) {
+		printk(BIOS_ERR, "ERROR: No function trace buffer allocated\n");
+		return;
+	}
+
+	memset(buf, 0, sizeof(*buf));
+	buf->program_base = (uintptr_t)_program;
+	buf->tick_freq_mhz = timestamp_tick_freq_mhz();
+	buf->max_records = CONFIG_TRACE_BUFFER_RECORDS;
+
+	trace_buffer = buf;
+}
+
+RAMSTAGE_CBMEM_INIT_HOOK(trace_init)
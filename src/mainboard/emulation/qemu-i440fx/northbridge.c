@@ -1,6 +1,7 @@
 #include <console/console.h>
 #include <cpu/cpu.h>
 #include <cpu/x86/lapic_def.h>
+#include <cpu/x86/mp.h>
 #include <arch/io.h>
 #include <arch/ioapic.h>
 #include <stdint.h>
@@ -236,9 +237,27 @@ static struct device_operations pci_domain_ops = {
 #endif
 };
 
+static int qemu_get_cpu_count(void)
+{
+	int max_cpus = fw_cfg_max_cpus();
+
+	if (max_cpus < 1)
+		return 1;
+	return MIN(max_cpus, CONFIG_MAX_CPUS);
+}
+
+static const struct mp_ops mp_ops = {
+	.get_cpu_count = qemu_get_cpu_count,
+};
+
 static void cpu_bus_init(device_t dev)
 {
-	initialize_cpus(dev->link_list);
+	if (IS_ENABLED(CONFIG_PARALLEL_MP)) {
+		if (mp_init_with_smm(dev->link_list, &mp_ops))
+			printk(BIOS_ERR, "MP initialization failure.\n");
+	} else {
+		initialize_cpus(dev->link_list);
+	}
 }
 
 static void cpu_bus_scan(device_t bus)
@@ -135,6 +135,21 @@ struct cbfs_file_attr_align {
 	uint32_t alignment;
 } __packed;
 
+/* Sorted name hash index, see cbfs_update_index(). */
+#define CBFS_INDEX_MAGIC 0x58494243 /* CBIX */
+
+struct cbfs_index_entry {
+	uint32_t name_hash;
+	/* offset of the cbfs_file header relative to the start of the CBFS */
+	uint32_t offset;
+} __packed;
+
+struct cbfs_index {
+	uint32_t magic;
+	uint32_t num_entries;
+	struct cbfs_index_entry entries[];
+} __packed;
+
 struct cbfs_stage {
 	uint32_t compression;
 	uint64_t entry;
@@ -169,6 +184,7 @@ struct cbfs_payload {
 
 #define CBFS_COMPONENT_BOOTBLOCK  0x01
 #define CBFS_COMPONENT_CBFSHEADER 0x02
+#define CBFS_COMPONENT_INDEX      0x03
 #define CBFS_COMPONENT_STAGE      0x10
 #define CBFS_COMPONENT_PAYLOAD    0x20
 #define CBFS_COMPONENT_OPTIONROM  0x30
@@ -202,6 +218,7 @@ struct cbfs_payload {
 static struct typedesc_t filetypes[] unused = {
 	{CBFS_COMPONENT_BOOTBLOCK, "bootblock"},
 	{CBFS_COMPONENT_CBFSHEADER, "cbfs header"},
+	{CBFS_COMPONENT_INDEX, "cbfs index"},
 	{CBFS_COMPONENT_STAGE, "stage"},
 	{CBFS_COMPONENT_PAYLOAD, "payload"},
 	{CBFS_COMPONENT_OPTIONROM, "optionrom"},
@@ -246,6 +263,9 @@ static size_t widths_cbfs_hash[] unused = {
 uint32_t get_cbfs_entry_type(const char *name, uint32_t default_value);
 uint32_t get_cbfs_compression(const char *name, uint32_t unknown);
 
+/* src/commonlib/cbfs.c */
+uint32_t cbfs_index_hash(const char *name);
+
 /* cbfs-mkpayload.c */
 void xdr_segs(struct buffer *output,
 	      struct cbfs_payload_segment *segs, int nseg);
@@ -560,7 +560,7 @@ int cbfs_compact_instance(struct cbfs_image *image)
 		prev = cur;
 	}
 
-	return 0;
+	return cbfs_update_index(image);
 }
 
 int cbfs_image_delete(struct cbfs_image *image)
@@ -733,7 +733,7 @@ int cbfs_add_entry(struct cbfs_image *image, struct buffer *buffer,
 
 		if (cbfs_add_entry_at(image, entry, buffer->data,
 				      content_offset, header) == 0) {
-			return 0;
+			return cbfs_update_index(image);
 		}
 		break;
 	}
@@ -743,6 +743,114 @@ int cbfs_add_entry(struct cbfs_image *image, struct buffer *buffer,
 	return -1;
 }
 
+static int cbfs_index_entry_cmp(const void *a, const void *b)
+{
+	const struct cbfs_index_entry *ea = a;
+	const struct cbfs_index_entry *eb = b;
+
+	if (ea->name_hash != eb->name_hash)
+		return ea->name_hash < eb->name_hash ? -1 : 1;
+	if (ea->offset != eb->offset)
+		return ea->offset < eb->offset ? -1 : 1;
+	return 0;
+}
+
+int cbfs_update_index(struct cbfs_image *image)
+{
+	struct cbfs_file *first, *entry;
+	struct cbfs_index *index;
+	struct cbfs_index_entry *entries;
+	size_t capacity, num = 0;
+
+	first = cbfs_find_first_entry(image);
+	if (!first || !cbfs_is_valid_entry(image, first) ||
+	    ntohl(first->type) != CBFS_COMPONENT_INDEX)
+		return 0;
+
+	index = CBFS_SUBHEADER(first);
+	if (ntohl(first->len) < sizeof(*index)) {
+		ERROR("CBFS index is too small.\n");
+		return -1;
+	}
+	capacity = (ntohl(first->len) - sizeof(*index)) /
+						sizeof(*index->entries);
+
+	entries = calloc(capacity + 1, sizeof(*entries));
+	if (!entries)
+		return -1;
+
+	for (entry = first;
+	     entry && cbfs_is_valid_entry(image, entry);
+	     entry = cbfs_find_next_entry(image, entry)) {
+		uint32_t type = ntohl(entry->type);
+		uint32_t offset = (char *)entry - (char *)first;
+
+		if (type == CBFS_COMPONENT_NULL ||
+		    type == CBFS_COMPONENT_DELETED)
+			continue;
+
+		if (num == capacity) {
+			ERROR("CBFS index is full (%zu entries).\n", capacity);
+			free(entries);
+			return -1;
+		}
+		entries[num].name_hash = cbfs_index_hash(entry->filename);
+		entries[num].offset = offset;
+		num++;
+	}
+
+	qsort(entries, num, sizeof(*entries), cbfs_index_entry_cmp);
+
+	memset(index, CBFS_CONTENT_DEFAULT_VALUE, ntohl(first->len));
+	index->magic = htonl(CBFS_INDEX_MAGIC);
+	index->num_entries = htonl(num);
+	for (size_t i = 0; i < num; i++) {
+		index->entries[i].name_hash = htonl(entries[i].name_hash);
+		index->entries[i].offset = htonl(entries[i].offset);
+	}
+
+	DEBUG("cbfs_update_index: %zu of %zu entries used\n", num, capacity);
+	free(entries);
+	return 0;
+}
+
+int cbfs_add_index(struct cbfs_image *image, size_t max_entries)
+{
+	const char * const name = "cbfs index";
+	struct cbfs_file *header;
+	struct buffer buffer;
+	int ret = -1;
+
+	if (cbfs_get_entry(image, name)) {
+		ERROR("'%s' already in ROM image.\n", name);
+		return -1;
+	}
+
+	if (buffer_create(&buffer, sizeof(struct cbfs_index) +
+			max_entries * sizeof(struct cbfs_index_entry),
+			name) != 0)
+		return -1;
+	memset(buffer.data, CBFS_CONTENT_DEFAULT_VALUE, buffer.size);
+
+	header = cbfs_create_file_header(CBFS_COMPONENT_INDEX, buffer.size,
+					 name);
+	if (cbfs_add_entry(image, &buffer, 0, header) != 0)
+		goto done;
+
+	/* The index is only found at the very beginning of the CBFS. */
+	if (cbfs_get_entry(image, name) != cbfs_find_first_entry(image)) {
+		ERROR("'%s' needs to be the first file in the CBFS.\n", name);
+		goto done;
+	}
+
+	ret = cbfs_update_index(image);
+
+done:
+	free(header);
+	buffer_delete(&buffer);
+	return ret;
+}
+
 struct cbfs_file *cbfs_get_entry(struct cbfs_image *image, const char *name)
 {
 	struct cbfs_file *entry;
@@ -1283,7 +1391,7 @@ int cbfs_remove_entry(struct cbfs_image *image, const char *name)
 	      entry->filename, cbfs_get_entry_addr(image, entry));
 	entry->type = htonl(CBFS_COMPONENT_DELETED);
 	cbfs_walk(image, cbfs_merge_empty_entry, NULL);
-	return 0;
+	return cbfs_update_index(image);
 }
 
 int cbfs_print_header_info(struct cbfs_image *image)
@@ -98,6 +98,15 @@ int cbfs_export_entry(struct cbfs_image *image, const char *entry_name,
 int cbfs_add_entry(struct cbfs_image *image, struct buffer *buffer,
 		   uint32_t content_offset, struct cbfs_file *header);
 
+/* Adds an index with room for max_entries files as the first entry of the
+ * CBFS image. Once present, it is kept up to date by all operations adding,
+ * removing or moving entries. Returns 0 on success, otherwise non-zero. */
+int cbfs_add_index(struct cbfs_image *image, size_t max_entries);
+
+/* Regenerates the index of the CBFS image, if it has one.
+ * Returns 0 on success, otherwise non-zero. */
+int cbfs_update_index(struct cbfs_image *image);
+
 /* Removes an entry from CBFS image. Returns 0 on success, otherwise non-zero. */
 int cbfs_remove_entry(struct cbfs_image *image, const char *name);
 
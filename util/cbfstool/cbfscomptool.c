@@ -13,19 +13,29 @@
  * GNU General Public License for more details.
  */
 
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "common.h"
+#include "cbfs.h"
+#include "elfparsing.h"
+#include <commonlib/endian.h>
 
 void usage(void);
-int benchmark(void);
+int benchmark(int argc, char **argv);
 int compress(char *infile, char *outfile, char *algoname);
 
-const char *usage_text = "cbfs-compression-tool benchmark\n"
-	"  runs benchmarks for all implemented algorithms\n"
+const char *usage_text = "cbfs-compression-tool benchmark [-n runs] "
+		"[-f text|csv|json] [FILE|DIR]...\n"
+	"  runs benchmarks for all implemented algorithms, either on\n"
+	"  synthetic data or on the given files. ELF files contribute\n"
+	"  their loadable segments, CBFS images every file they contain\n"
+	"  (decompressed), directories each regular file in them.\n"
 	"cbfs-compression-tool compress inFile outFile algo\n"
 	"  compresses inFile with algo and stores in outFile\n"
 	"\n"
@@ -39,53 +49,580 @@ void usage()
 	puts(usage_text);
 }
 
-int benchmark()
+/* A piece of uncompressed data to run the algorithms on. */
+struct sample {
+	char *name;
+	char *data;
+	size_t size;
+};
+
+static struct sample *samples;
+static size_t num_samples;
+
+enum output_format {
+	OUTPUT_TEXT,
+	OUTPUT_CSV,
+	OUTPUT_JSON,
+};
+
+/* Statistics over all runs, in nanoseconds. */
+struct timing {
+	uint64_t min;
+	uint64_t median;
+	uint64_t p99;
+};
+
+struct result {
+	const struct sample *sample;
+	const char *algo;
+	size_t compressed_size;
+	/* The output did not fit in the input size, so the data would be
+	 * stored uncompressed. */
+	bool stored;
+	struct timing comp;
+	struct timing decomp;
+};
+
+static int add_sample(const char *name, const char *data, size_t size)
 {
-	const int bufsize = 10*1024*1024;
-	char *data = malloc(bufsize);
-	if (!data) {
+	struct sample *s;
+
+	if (size == 0)
+		return 0;
+
+	s = realloc(samples, (num_samples + 1) * sizeof(*samples));
+	if (!s) {
 		fprintf(stderr, "out of memory\n");
 		return 1;
 	}
-	char *compressed_data = malloc(bufsize);
-	if (!compressed_data) {
-		free(data);
+	samples = s;
+	s = &samples[num_samples];
+
+	s->name = strdup(name);
+	s->data = malloc(size);
+	if (!s->name || !s->data) {
+		fprintf(stderr, "out of memory\n");
+		free(s->name);
+		free(s->data);
+		return 1;
+	}
+	memcpy(s->data, data, size);
+	s->size = size;
+	num_samples++;
+	return 0;
+}
+
+/* Add the contents of all loadable segments as one sample. */
+static int add_elf_sample(const char *name, const struct buffer *file)
+{
+	struct parsed_elf pelf;
+	struct buffer loadable;
+	size_t size = 0;
+	int i, ret;
+
+	if (parse_elf(file, &pelf, ELF_PARSE_PHDR)) {
+		fprintf(stderr, "could not parse ELF '%s'\n", name);
+		return 1;
+	}
+
+	for (i = 0; i < pelf.ehdr.e_phnum; i++) {
+		if (pelf.phdr[i].p_type == PT_LOAD)
+			size += pelf.phdr[i].p_filesz;
+	}
+
+	if (buffer_create(&loadable, size, name)) {
+		parsed_elf_destroy(&pelf);
+		return 1;
+	}
+
+	size = 0;
+	for (i = 0; i < pelf.ehdr.e_phnum; i++) {
+		Elf64_Phdr *phdr = &pelf.phdr[i];
+
+		if (phdr->p_type != PT_LOAD)
+			continue;
+		if (phdr->p_offset + phdr->p_filesz > buffer_size(file)) {
+			fprintf(stderr, "truncated ELF '%s'\n", name);
+			buffer_delete(&loadable);
+			parsed_elf_destroy(&pelf);
+			return 1;
+		}
+		memcpy(loadable.data + size, file->data + phdr->p_offset,
+		       phdr->p_filesz);
+		size += phdr->p_filesz;
+	}
+
+	ret = add_sample(name, loadable.data, size);
+	buffer_delete(&loadable);
+	parsed_elf_destroy(&pelf);
+	return ret;
+}
+
+/* Decompress data of the given CBFS algorithm and append it to out. */
+static int cbfs_unpack(uint32_t algo, char *in, size_t in_len,
+		       size_t out_len, struct buffer *out)
+{
+	decomp_func_ptr decomp = decompression_function(algo);
+	size_t actual;
+	char *data;
+
+	if (!decomp)
+		return 1;
+
+	data = realloc(out->data, out->size + out_len);
+	if (!data)
+		return 1;
+	out->data = data;
+
+	if (decomp(in, in_len, out->data + out->size, out_len,
+		   &actual))
+		return 1;
+
+	out->size += actual;
+	return 0;
+}
+
+static int cbfs_unpack_file(const struct cbfs_file *file, char *data,
+			    size_t len, struct buffer *out)
+{
+	uint32_t type = ntohl(file->type);
+
+	if (type == CBFS_COMPONENT_STAGE) {
+		const struct cbfs_stage *stage = (const void *)data;
+
+		if (len < sizeof(*stage))
+			return 1;
+		return cbfs_unpack(read_le32(&stage->compression),
+				   data + sizeof(*stage),
+				   len - sizeof(*stage),
+				   read_le32(&stage->memlen), out);
+	}
+
+	if (type == CBFS_COMPONENT_PAYLOAD) {
+		const struct cbfs_payload_segment *seg = (const void *)data;
+
+		for (; (const char *)(seg + 1) <= data + len; seg++) {
+			uint32_t seg_type = ntohl(seg->type);
+			uint32_t offset = ntohl(seg->offset);
+			uint32_t seg_len = ntohl(seg->len);
+
+			if (seg_type == PAYLOAD_SEGMENT_ENTRY)
+				break;
+			if (seg_type != PAYLOAD_SEGMENT_CODE &&
+			    seg_type != PAYLOAD_SEGMENT_DATA)
+				continue;
+			if (offset + seg_len > len)
+				return 1;
+			if (cbfs_unpack(ntohl(seg->compression),
+					data + offset, seg_len,
+					ntohl(seg->mem_len), out))
+				return 1;
+		}
+		return 0;
+	}
+
+	if (file->attributes_offset) {
+		uint32_t offset = ntohl(file->attributes_offset);
+		uint32_t end = ntohl(file->offset);
+
+		while (offset + sizeof(struct cbfs_file_attribute) <= end) {
+			const struct cbfs_file_attr_compression *attr =
+				(const void *)((const char *)file + offset);
+			uint32_t attr_len = ntohl(attr->len);
+
+			if (attr_len < sizeof(struct cbfs_file_attribute))
+				break;
+			if (ntohl(attr->tag) == CBFS_FILE_ATTR_TAG_COMPRESSION)
+				return cbfs_unpack(ntohl(attr->compression),
+					data, len,
+					ntohl(attr->decompressed_size), out);
+			offset += attr_len;
+		}
+	}
+
+	return cbfs_unpack(CBFS_COMPRESS_NONE, data, len, len, out);
+}
+
+/* Add every file of all CBFSes found in an image. Files with the same name
+ * (e.g. in the RW copies) are only added once. */
+static int add_cbfs_samples(const char *name, const struct buffer *image)
+{
+	size_t offset, first = num_samples;
+	int ret = 0;
+
+	for (offset = 0; offset + sizeof(struct cbfs_file) <= image->size;
+	     offset += CBFS_ALIGNMENT) {
+		const struct cbfs_file *file =
+			(const void *)(image->data + offset);
+		uint32_t type = ntohl(file->type);
+		uint32_t data_offset = ntohl(file->offset);
+		uint32_t len = ntohl(file->len);
+		struct buffer out = { 0 };
+		char sample_name[256];
+		size_t i;
+
+		if (memcmp(file->magic, CBFS_FILE_MAGIC,
+			   sizeof(file->magic)))
+			continue;
+		if (type == CBFS_COMPONENT_NULL ||
+		    type == CBFS_COMPONENT_DELETED)
+			continue;
+		if (data_offset < sizeof(*file) ||
+		    offset + data_offset + len > image->size)
+			continue;
+
+		snprintf(sample_name, sizeof(sample_name), "%s:%.*s", name,
+			 (int)(data_offset - sizeof(*file)), file->filename);
+
+		for (i = first; i < num_samples; i++) {
+			if (!strcmp(samples[i].name, sample_name))
+				break;
+		}
+		if (i < num_samples)
+			continue;
+
+		if (cbfs_unpack_file(file, image->data + offset + data_offset,
+				     len, &out)) {
+			fprintf(stderr, "could not unpack '%s'\n",
+				sample_name);
+			ret = 1;
+		} else {
+			ret = add_sample(sample_name, out.data, out.size);
+		}
+		free(out.data);
+		if (ret)
+			break;
+	}
+
+	return ret;
+}
+
+static bool is_cbfs_image(const struct buffer *file)
+{
+	size_t offset;
+
+	for (offset = 0; offset + strlen(CBFS_FILE_MAGIC) <= file->size;
+	     offset += CBFS_ALIGNMENT) {
+		if (!memcmp(file->data + offset, CBFS_FILE_MAGIC,
+			    strlen(CBFS_FILE_MAGIC)))
+			return true;
+	}
+	return false;
+}
+
+static int add_file_samples(const char *name)
+{
+	struct buffer file;
+	int ret;
+
+	if (buffer_from_file(&file, name))
+		return 1;
+
+	if (file.size >= 4 && !memcmp(file.data, ELFMAG, 4))
+		ret = add_elf_sample(name, &file);
+	else if (is_cbfs_image(&file))
+		ret = add_cbfs_samples(name, &file);
+	else
+		ret = add_sample(name, file.data, file.size);
+
+	buffer_delete(&file);
+	return ret;
+}
+
+static int add_samples(const char *name)
+{
+	struct dirent **entries;
+	struct stat st;
+	int i, n, ret = 0;
+
+	if (stat(name, &st)) {
+		perror(name);
+		return 1;
+	}
+
+	if (!S_ISDIR(st.st_mode))
+		return add_file_samples(name);
+
+	n = scandir(name, &entries, NULL, alphasort);
+	if (n < 0) {
+		perror(name);
+		return 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		size_t len = strlen(name) + strlen(entries[i]->d_name) + 2;
+		char *path = malloc(len);
+
+		if (!ret && path) {
+			snprintf(path, len, "%s/%s", name,
+				 entries[i]->d_name);
+			if (!stat(path, &st) && S_ISREG(st.st_mode))
+				ret = add_file_samples(path);
+		} else if (!path) {
+			ret = 1;
+		}
+		free(path);
+		free(entries[i]);
+	}
+	free(entries);
+	return ret;
+}
+
+static int add_synthetic_sample(void)
+{
+	const int bufsize = 10*1024*1024;
+	char *data = malloc(bufsize);
+	int i, l = strlen(usage_text) + 1, ret;
+
+	if (!data) {
 		fprintf(stderr, "out of memory\n");
 		return 1;
 	}
-	int i, l = strlen(usage_text) + 1;
 	for (i = 0; i + l < bufsize; i += l) {
 		memcpy(data + i, usage_text, l);
 	}
 	memset(data + i, 0, bufsize - i);
-	const struct typedesc_t *algo;
-	for (algo = &types_cbfs_compression[0]; algo->name != NULL; algo++) {
-		int outsize = bufsize;
-		printf("measuring '%s'\n", algo->name);
-		comp_func_ptr comp = compression_function(algo->type);
-		if (comp == NULL) {
-			printf("no handler associated with algorithm\n");
-			free(data);
-			free(compressed_data);
-			return 1;
+	ret = add_sample("synthetic", data, bufsize);
+	free(data);
+	return ret;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void get_timing(struct timing *t, uint64_t *runs, int num_runs)
+{
+	qsort(runs, num_runs, sizeof(*runs), compare_u64);
+	t->min = runs[0];
+	t->median = runs[num_runs / 2];
+	t->p99 = runs[(num_runs * 99 + 99) / 100 - 1];
+}
+
+static int measure(struct result *r, comp_func_ptr comp,
+		   decomp_func_ptr decomp, int num_runs)
+{
+	const struct sample *s = r->sample;
+	uint64_t *comp_runs = calloc(num_runs, sizeof(uint64_t));
+	uint64_t *decomp_runs = calloc(num_runs, sizeof(uint64_t));
+	char *compressed = malloc(s->size);
+	char *decompressed = malloc(s->size);
+	int ret = 1, run, outsize = 0;
+
+	if (!comp_runs || !decomp_runs || !compressed || !decompressed) {
+		fprintf(stderr, "out of memory\n");
+		goto out;
+	}
+
+	for (run = 0; run < num_runs; run++) {
+		uint64_t start = now_ns();
+		if (comp(s->data, s->size, compressed, &outsize)) {
+			r->stored = true;
+			ret = 0;
+			goto out;
+		}
+		comp_runs[run] = now_ns() - start;
+	}
+	r->compressed_size = outsize;
+	get_timing(&r->comp, comp_runs, num_runs);
+
+	for (run = 0; run < num_runs; run++) {
+		size_t actual;
+		uint64_t start = now_ns();
+		if (decomp(compressed, outsize, decompressed, s->size,
+			   &actual) || actual != s->size) {
+			fprintf(stderr, "'%s' failed to decompress '%s'\n",
+				r->algo, s->name);
+			goto out;
 		}
+		decomp_runs[run] = now_ns() - start;
+	}
+	get_timing(&r->decomp, decomp_runs, num_runs);
+
+	if (memcmp(s->data, decompressed, s->size)) {
+		fprintf(stderr, "'%s' corrupted '%s'\n", r->algo, s->name);
+		goto out;
+	}
+	ret = 0;
+out:
+	free(comp_runs);
+	free(decomp_runs);
+	free(compressed);
+	free(decompressed);
+	return ret;
+}
+
+/* MB/s for size bytes processed in ns nanoseconds. */
+static double mbps(size_t size, uint64_t ns)
+{
+	return ns ? (double)size * 1000 / ns : 0;
+}
+
+static void print_json_string(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			printf("\\u%04x", *str);
+		else
+			putchar(*str);
+	}
+	putchar('"');
+}
+
+static void print_result(const struct result *r, enum output_format format,
+			 bool first)
+{
+	const struct sample *s = r->sample;
+	size_t compressed = r->stored ? s->size : r->compressed_size;
+	double ratio = (double)compressed / s->size;
+
+	switch (format) {
+	case OUTPUT_TEXT:
+		if (first)
+			printf("%-32s %-6s %10s %10s %6s %9s %11s %9s %11s\n",
+			       "sample", "algo", "size", "compressed", "ratio",
+			       "comp MB/s", "comp p99 us", "dec MB/s",
+			       "dec p99 us");
+		printf("%-32s %-6s %10zu %10zu %6.3f", s->name, r->algo,
+		       s->size, compressed, ratio);
+		if (r->stored)
+			printf(" %9s\n", "stored");
+		else
+			printf(" %9.1f %11.1f %9.1f %11.1f\n",
+			       mbps(s->size, r->comp.median),
+			       r->comp.p99 / 1000.0,
+			       mbps(s->size, r->decomp.median),
+			       r->decomp.p99 / 1000.0);
+		break;
+	case OUTPUT_CSV:
+		if (first)
+			printf("sample,algo,size,compressed_size,ratio,"
+			       "comp_ns_min,comp_ns_median,comp_ns_p99,"
+			       "decomp_ns_min,decomp_ns_median,decomp_ns_p99,"
+			       "comp_mbps,decomp_mbps\n");
+		printf("\"%s\",%s,%zu,%zu,%.4f,%llu,%llu,%llu,%llu,%llu,%llu,"
+		       "%.2f,%.2f\n", s->name, r->algo, s->size, compressed,
+		       ratio, (unsigned long long)r->comp.min,
+		       (unsigned long long)r->comp.median,
+		       (unsigned long long)r->comp.p99,
+		       (unsigned long long)r->decomp.min,
+		       (unsigned long long)r->decomp.median,
+		       (unsigned long long)r->decomp.p99,
+		       mbps(s->size, r->comp.median),
+		       mbps(s->size, r->decomp.median));
+		break;
+	case OUTPUT_JSON:
+		printf("%s\n  { \"sample\": ", first ? "[" : ",");
+		print_json_string(s->name);
+		printf(", \"algo\": \"%s\", \"size\": %zu, "
+		       "\"compressed_size\": %zu, \"ratio\": %.4f, "
+		       "\"stored\": %s,\n"
+		       "    \"comp_ns\": { \"min\": %llu, \"median\": %llu, "
+		       "\"p99\": %llu },\n"
+		       "    \"decomp_ns\": { \"min\": %llu, \"median\": %llu, "
+		       "\"p99\": %llu } }", r->algo, s->size, compressed,
+		       ratio, r->stored ? "true" : "false",
+		       (unsigned long long)r->comp.min,
+		       (unsigned long long)r->comp.median,
+		       (unsigned long long)r->comp.p99,
+		       (unsigned long long)r->decomp.min,
+		       (unsigned long long)r->decomp.median,
+		       (unsigned long long)r->decomp.p99);
+		break;
+	}
+}
+
+int benchmark(int argc, char **argv)
+{
+	enum output_format format = OUTPUT_TEXT;
+	int num_runs = 1, c, ret = 0;
+	bool first = true;
+	size_t i;
 
-		struct timespec t_s, t_e;
-		clock_gettime(CLOCK_MONOTONIC, &t_s);
+	optind = 2;
+	while ((c = getopt(argc, argv, "n:f:")) != -1) {
+		switch (c) {
+		case 'n':
+			num_runs = atoi(optarg);
+			if (num_runs <= 0) {
+				fprintf(stderr, "invalid number of runs\n");
+				return 1;
+			}
+			break;
+		case 'f':
+			if (strcmp(optarg, "text") == 0)
+				format = OUTPUT_TEXT;
+			else if (strcmp(optarg, "csv") == 0)
+				format = OUTPUT_CSV;
+			else if (strcmp(optarg, "json") == 0)
+				format = OUTPUT_JSON;
+			else {
+				fprintf(stderr, "unknown format '%s'\n",
+					optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
 
-		if (comp(data, bufsize, compressed_data, &outsize)) {
-			printf("compression failed");
+	for (; optind < argc; optind++) {
+		if (add_samples(argv[optind]))
 			return 1;
+	}
+	if (num_samples == 0 && add_synthetic_sample())
+		return 1;
+
+	for (i = 0; i < num_samples && !ret; i++) {
+		const struct typedesc_t *algo;
+		for (algo = &types_cbfs_compression[0]; algo->name != NULL;
+		     algo++) {
+			struct result r = {
+				.sample = &samples[i],
+				.algo = algo->name,
+			};
+			comp_func_ptr comp = compression_function(algo->type);
+			decomp_func_ptr decomp =
+				decompression_function(algo->type);
+			if (comp == NULL || decomp == NULL) {
+				printf("no handler associated with algorithm\n");
+				ret = 1;
+				break;
+			}
+			if (measure(&r, comp, decomp, num_runs)) {
+				ret = 1;
+				break;
+			}
+			print_result(&r, format, first);
+			first = false;
 		}
+	}
+
+	if (format == OUTPUT_JSON)
+		printf("%s]\n", first ? "[" : "\n");
 
-		clock_gettime(CLOCK_MONOTONIC, &t_e);
-		printf("compressing %d bytes to %d took %ld seconds\n",
-			bufsize, outsize,
-			(long)(t_e.tv_sec - t_s.tv_sec));
+	for (i = 0; i < num_samples; i++) {
+		free(samples[i].name);
+		free(samples[i].data);
 	}
-	free(data);
-	free(compressed_data);
-	return 0;
+	free(samples);
+	return ret;
 }
 
 int compress(char *infile, char *outfile, char *algoname)
@@ -190,8 +727,8 @@ out:
 
 int main(int argc, char **argv)
 {
-	if ((argc == 2) && (strcmp(argv[1], "benchmark") == 0))
-		return benchmark();
+	if ((argc >= 2) && (strcmp(argv[1], "benchmark") == 0))
+		return benchmark(argc, argv);
 	if ((argc == 5) && (strcmp(argv[1], "compress") == 0))
 		return compress(argv[2], argv[3], argv[4]);
 	usage();
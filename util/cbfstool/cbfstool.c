@@ -23,6 +23,7 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <pthread.h>
 #include "common.h"
 #include "cbfs.h"
 #include "cbfs_image.h"
@@ -33,6 +34,7 @@
 #include <commonlib/endian.h>
 
 #define SECTION_WITH_FIT_TABLE	"BOOTBLOCK"
+#define CBFS_INDEX_DEFAULT_ENTRIES	128
 
 struct command {
 	const char *name;
@@ -79,6 +81,7 @@ static struct param {
 	bool autogen_attr;
 	bool machine_parseable;
 	int fit_empty_entries;
+	int jobs;
 	enum comp_algo compression;
 	int precompression;
 	enum vb2_hash_algorithm hash;
@@ -331,6 +334,28 @@ done:
 	return ret;
 }
 
+static int cbfs_add_cbfs_index(void)
+{
+	struct cbfs_image image;
+	size_t max_entries = CBFS_INDEX_DEFAULT_ENTRIES;
+
+	if (param.u64val_assigned)
+		max_entries = param.u64val;
+
+	if (cbfs_image_from_buffer(&image, param.image_region,
+		param.headeroffset)) {
+		ERROR("Selected image region is not a CBFS.\n");
+		return 1;
+	}
+
+	if (cbfs_add_index(&image, max_entries)) {
+		ERROR("Failed to add cbfs index into ROM image.\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 static int cbfs_add_component(const char *filename,
 			      const char *name,
 			      uint32_t type,
@@ -736,6 +761,358 @@ static int cbfs_add_flat_binary(void)
 				  cbfstool_convert_mkflatpayload);
 }
 
+/* One line of an add-batch manifest. */
+struct batch_entry {
+	const char *filename;
+	const char *name;
+	uint32_t type;
+	enum comp_algo compression;
+	/* Filled in by the worker threads. */
+	struct buffer buffer;
+	struct cbfs_file *header;
+	int result;
+};
+
+static struct batch_entry *batch_entries;
+static size_t batch_count;
+static size_t batch_next;
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Parse a manifest with one file per line:
+ *   FILE NAME TYPE [COMPRESSION]
+ * Empty lines and lines starting with '#' are ignored.
+ */
+static int batch_parse_manifest(const char *filename)
+{
+	struct buffer manifest;
+	char *text, *line, *saveptr;
+	size_t size, lines = 1, i;
+
+	if (buffer_from_file(&manifest, filename) != 0) {
+		ERROR("Could not load manifest '%s'.\n", filename);
+		return 1;
+	}
+
+	/* The entries point into the text, so it is never freed. */
+	size = buffer_size(&manifest);
+	text = malloc(size + 1);
+	if (!text) {
+		buffer_delete(&manifest);
+		return 1;
+	}
+	memcpy(text, buffer_get(&manifest), size);
+	text[size] = '\0';
+	buffer_delete(&manifest);
+
+	for (i = 0; i < size; i++)
+		if (text[i] == '\n')
+			lines++;
+
+	batch_entries = calloc(lines, sizeof(*batch_entries));
+	if (!batch_entries)
+		return 1;
+
+	for (line = strtok_r(text, "\n", &saveptr); line;
+	     line = strtok_r(NULL, "\n", &saveptr)) {
+		struct batch_entry *e = &batch_entries[batch_count];
+		char *field[4] = { NULL };
+		char *fsave;
+		size_t n = 0;
+
+		for (char *f = strtok_r(line, " \t\r", &fsave); f;
+		     f = strtok_r(NULL, " \t\r", &fsave)) {
+			if (n == 0 && f[0] == '#')
+				break;
+			if (n == ARRAY_SIZE(field)) {
+				ERROR("Too many fields in manifest line for '%s'.\n",
+				      field[0]);
+				return 1;
+			}
+			field[n++] = f;
+		}
+
+		if (n == 0)
+			continue;
+
+		if (n < 3) {
+			ERROR("Manifest line for '%s' needs FILE NAME TYPE.\n",
+			      field[0]);
+			return 1;
+		}
+
+		e->filename = field[0];
+		e->name = field[1];
+		if (intfiletype(field[2]) != ((uint64_t) - 1))
+			e->type = intfiletype(field[2]);
+		else
+			e->type = strtoul(field[2], NULL, 0);
+		if (e->type == 0) {
+			ERROR("Unknown type '%s' for '%s'.\n", field[2],
+			      e->name);
+			return 1;
+		}
+
+		e->compression = param.compression;
+		if (field[3]) {
+			int algo = cbfs_parse_comp_algo(field[3]);
+			if (algo < 0) {
+				ERROR("Unknown compression '%s' for '%s'.\n",
+				      field[3], e->name);
+				return 1;
+			}
+			e->compression = algo;
+		}
+
+		batch_count++;
+	}
+
+	return 0;
+}
+
+/* Same as cbfstool_convert_raw(), without touching the global params. */
+static int batch_convert_raw(struct batch_entry *e)
+{
+	comp_func_ptr compress;
+	char *compressed;
+	int compressed_size;
+
+	compress = compression_function(e->compression);
+	if (!compress)
+		return -1;
+	compressed = calloc(e->buffer.size, 1);
+	if (!compressed)
+		return -1;
+
+	if (compress(e->buffer.data, e->buffer.size,
+		     compressed, &compressed_size)) {
+		WARN("Compression of '%s' failed - disabled\n", e->name);
+		free(compressed);
+		return 0;
+	}
+
+	struct cbfs_file_attr_compression *attrs =
+		(struct cbfs_file_attr_compression *)
+		cbfs_add_file_attr(e->header,
+			CBFS_FILE_ATTR_TAG_COMPRESSION,
+			sizeof(struct cbfs_file_attr_compression));
+	if (attrs == NULL) {
+		free(compressed);
+		return -1;
+	}
+	attrs->compression = htonl(e->compression);
+	attrs->decompressed_size = htonl(e->buffer.size);
+
+	free(e->buffer.data);
+	e->buffer.data = compressed;
+	e->buffer.size = compressed_size;
+
+	e->header->len = htonl(e->buffer.size);
+	return 0;
+}
+
+static int batch_convert(struct batch_entry *e)
+{
+	struct buffer output;
+	uint32_t offset = 0;
+	int ret;
+
+	/* FSP blobs are relocated to where they end up, so they are only
+	 * converted once their place is known in cbfs_add_batch(). */
+	if (e->type == CBFS_COMPONENT_FSP)
+		return 0;
+
+	if (buffer_from_file(&e->buffer, e->filename) != 0) {
+		ERROR("Could not load file '%s'.\n", e->filename);
+		return -1;
+	}
+
+	e->header = cbfs_create_file_header(e->type, e->buffer.size, e->name);
+	if (!e->header)
+		return -1;
+
+	switch (e->type) {
+	case CBFS_COMPONENT_STAGE:
+		ret = parse_elf_to_stage(&e->buffer, &output, e->compression,
+					 &offset, param.ignore_section);
+		break;
+	case CBFS_COMPONENT_PAYLOAD:
+		/* Same order as cbfstool_convert_mkpayload(). */
+		ret = parse_elf_to_payload(&e->buffer, &output,
+					   e->compression);
+		if (ret != 0)
+			ret = parse_fv_to_payload(&e->buffer, &output,
+						  e->compression);
+		if (ret != 0)
+			ret = parse_bzImage_to_payload(&e->buffer, &output,
+					param.initrd, param.cmdline,
+					e->compression);
+		if (ret != 0) {
+			ERROR("Not a supported payload type (ELF / FV).\n");
+			return -1;
+		}
+		break;
+	default:
+		return batch_convert_raw(e);
+	}
+
+	if (ret != 0) {
+		ERROR("Failed to parse file '%s'.\n", e->filename);
+		return -1;
+	}
+
+	buffer_delete(&e->buffer);
+	// direct assign, no dupe.
+	memcpy(&e->buffer, &output, sizeof(output));
+	e->header->len = htonl(output.size);
+	return 0;
+}
+
+static void *batch_worker(unused void *arg)
+{
+	while (1) {
+		struct batch_entry *e;
+
+		pthread_mutex_lock(&batch_lock);
+		e = batch_next < batch_count ? &batch_entries[batch_next++] :
+			NULL;
+		pthread_mutex_unlock(&batch_lock);
+
+		if (!e)
+			return NULL;
+
+		e->result = batch_convert(e);
+	}
+}
+
+/* Load and compress all files of the manifest, using param.jobs threads. */
+static int batch_prepare(void)
+{
+	long jobs = param.jobs;
+	pthread_t *threads;
+	long i, started;
+
+	if (batch_parse_manifest(param.filename))
+		return 1;
+
+	if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0)
+		jobs = 1;
+	if ((size_t)jobs > batch_count)
+		jobs = batch_count;
+
+	threads = calloc(jobs, sizeof(*threads));
+	if (!threads && jobs)
+		return 1;
+
+	for (started = 0; started < jobs; started++)
+		if (pthread_create(&threads[started], NULL, batch_worker, NULL))
+			break;
+
+	/* Whatever the threads did not pick up is done here. */
+	batch_worker(NULL);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	for (i = 0; (size_t)i < batch_count; i++) {
+		if (batch_entries[i].result)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Add an FSP blob exactly like 'add -t fsp' would, that is 4KiB aligned and
+ * relocated to its place in the image. */
+static int batch_add_fsp(struct batch_entry *e)
+{
+	const char *filename = param.filename;
+	const char *name = param.name;
+	uint32_t type = param.type;
+	enum comp_algo compression = param.compression;
+	uint32_t alignment = param.alignment;
+	int ret;
+
+	param.filename = e->filename;
+	param.name = e->name;
+	param.type = e->type;
+	param.compression = e->compression;
+
+	ret = cbfs_add();
+
+	param.filename = filename;
+	param.name = name;
+	param.type = type;
+	param.compression = compression;
+	param.alignment = alignment;
+
+	return ret;
+}
+
+static int cbfs_add_batch(void)
+{
+	struct cbfs_image image;
+	size_t i;
+
+	if (!param.filename) {
+		ERROR("You need to specify -f/--filename.\n");
+		return 1;
+	}
+
+	/* The files are only compressed once, even when adding to several
+	 * regions. */
+	if (!batch_entries && batch_prepare())
+		return 1;
+
+	if (cbfs_image_from_buffer(&image, param.image_region,
+				   param.headeroffset))
+		return 1;
+
+	for (i = 0; i < batch_count; i++) {
+		struct batch_entry *e = &batch_entries[i];
+		struct cbfs_file *header;
+
+		if (e->type == CBFS_COMPONENT_FSP) {
+			if (batch_add_fsp(e))
+				return 1;
+			continue;
+		}
+
+		if (cbfs_get_entry(&image, e->name)) {
+			ERROR("'%s' already in ROM image.\n", e->name);
+			return 1;
+		}
+
+		/* Adding a hash grows the header, so work on a copy that can
+		 * be thrown away after each region. */
+		header = malloc(MAX_CBFS_FILE_HEADER_BUFFER);
+		if (!header)
+			return 1;
+		memcpy(header, e->header, MAX_CBFS_FILE_HEADER_BUFFER);
+
+		if (param.hash != VB2_HASH_INVALID &&
+		    cbfs_add_file_hash(header, &e->buffer, param.hash) == -1) {
+			ERROR("couldn't add hash for '%s'\n", e->name);
+			free(header);
+			return 1;
+		}
+
+		if (cbfs_add_entry(&image, &e->buffer, 0, header) != 0) {
+			ERROR("Failed to add '%s' into ROM image.\n",
+			      e->filename);
+			free(header);
+			return 1;
+		}
+
+		free(header);
+	}
+
+	return 0;
+}
+
 static int cbfs_add_integer(void)
 {
 	if (!param.u64val_assigned) {
@@ -1094,7 +1471,15 @@ static int cbfs_copy(void)
 	if (cbfs_image_from_buffer(&src_image, &src_buf, param.headeroffset))
 		return 1;
 
-	return cbfs_copy_instance(&src_image, param.image_region);
+	if (cbfs_copy_instance(&src_image, param.image_region))
+		return 1;
+
+	/* Files move while being copied, so an index needs to be redone. */
+	struct cbfs_image dst_image;
+	if (cbfs_image_from_buffer(&dst_image, param.image_region, ~0u))
+		return 1;
+
+	return cbfs_update_index(&dst_image);
 }
 
 static int cbfs_compact(void)
@@ -1113,10 +1498,12 @@ static const struct command commands[] = {
 				true, true},
 	{"add-payload", "H:r:f:n:t:c:b:C:I:vA:gh?", cbfs_add_payload,
 				true, true},
-	{"add-stage", "a:H:r:f:n:t:c:b:P:S:yvA:gh?", cbfs_add_stage,
+	{"add-stage", "a:H:r:f:n:t:c:b:L:P:S:yvA:gh?", cbfs_add_stage,
 				true, true},
+	{"add-batch", "H:r:f:c:j:A:vh?", cbfs_add_batch, true, true},
 	{"add-int", "H:r:i:n:b:vgh?", cbfs_add_integer, true, true},
 	{"add-master-header", "H:r:vh?", cbfs_add_master_header, true, true},
+	{"add-index", "H:r:i:vh?", cbfs_add_cbfs_index, true, true},
 	{"compact", "r:h?", cbfs_compact, true, true},
 	{"copy", "r:R:h?", cbfs_copy, true, true},
 	{"create", "M:r:s:B:b:H:o:m:vh?", cbfs_create, true, true},
@@ -1150,7 +1537,9 @@ static struct option long_options[] = {
 	{"ignore-sec",    required_argument, 0, 'S' },
 	{"initrd",        required_argument, 0, 'I' },
 	{"int",           required_argument, 0, 'i' },
+	{"jobs",          required_argument, 0, 'j' },
 	{"load-address",  required_argument, 0, 'l' },
+	{"lz4-block-size",required_argument, 0, 'L' },
 	{"machine",       required_argument, 0, 'm' },
 	{"name",          required_argument, 0, 'n' },
 	{"offset",        required_argument, 0, 'o' },
@@ -1242,16 +1631,22 @@ static void usage(char *name)
 			"Add a payload to the ROM\n"
 	     " add-stage [-r image,regions] -f FILE -n NAME [-A hash] \\\n"
 	     "        [-c compression] [-b base] [-S section-to-ignore] \\\n"
-	     "        [-a alignment] [-y|--xip] [-P page-size]             "
+	     "        [-a alignment] [-y|--xip] [-P page-size] \\\n"
+	     "        [-L lz4-block-size]                                  "
 			"Add a stage to the ROM\n"
 	     " add-flat-binary [-r image,regions] -f FILE -n NAME \\\n"
 	     "        [-A hash] -l load-address -e entry-point \\\n"
 	     "        [-c compression] [-b base]                           "
 			"Add a 32bit flat mode binary\n"
+	     " add-batch [-r image,regions] -f MANIFEST [-A hash] \\\n"
+	     "        [-c compression] [-j jobs]                           "
+			"Add files listed as FILE NAME TYPE [COMPRESSION]\n"
 	     " add-int [-r image,regions] -i INTEGER -n NAME [-b base]     "
 			"Add a raw 64-bit integer value\n"
 	     " add-master-header [-r image,regions]                        "
 			"Add a legacy CBFS master header\n"
+	     " add-index [-r image,regions] [-i max-entries]               "
+			"Add an index for faster file lookups\n"
 	     " remove [-r image,regions] -n NAME                           "
 			"Remove a component\n"
 	     " compact -r image,regions                                    "
@@ -1468,6 +1863,23 @@ int main(int argc, char **argv)
 					return 1;
 				}
 				break;
+			case 'j':
+				param.jobs = strtol(optarg, &suffix, 0);
+				if (!*optarg || (suffix && *suffix)) {
+					ERROR("Invalid number of jobs '%s'.\n",
+						optarg);
+					return 1;
+				}
+				break;
+			case 'L':
+				if (compression_set_lz4_block_size(
+					strtoul(optarg, &suffix, 0)) ||
+				    !*optarg || (suffix && *suffix)) {
+					ERROR("Invalid LZ4 block size '%s'.\n",
+						optarg);
+					return 1;
+				}
+				break;
 			case 'P':
 				param.pagesize = strtoul(optarg, &suffix, 0);
 				if (!*optarg || (suffix && *suffix)) {
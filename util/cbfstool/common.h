@@ -164,6 +164,7 @@ enum comp_algo {
 	CBFS_COMPRESS_NONE = 0,
 	CBFS_COMPRESS_LZMA = 1,
 	CBFS_COMPRESS_LZ4 = 2,
+	CBFS_COMPRESS_ZSTD = 3,
 };
 
 struct typedesc_t {
@@ -175,11 +176,15 @@ static const struct typedesc_t types_cbfs_compression[] = {
 	{CBFS_COMPRESS_NONE, "none"},
 	{CBFS_COMPRESS_LZMA, "LZMA"},
 	{CBFS_COMPRESS_LZ4, "LZ4"},
+	{CBFS_COMPRESS_ZSTD, "ZSTD"},
 	{0, NULL},
 };
 
 comp_func_ptr compression_function(enum comp_algo algo);
 decomp_func_ptr decompression_function(enum comp_algo algo);
+/* Set the maximum size of the independent blocks LZ4 data is split into. Only
+ * 64KiB, 256KiB, 1MiB and 4MiB (the default) are valid. Returns 0 on success. */
+int compression_set_lz4_block_size(size_t size);
 
 uint64_t intfiletype(const char *name);
 
@@ -23,14 +23,38 @@
 #include <stdlib.h>
 #include "common.h"
 #include "lz4/lib/lz4frame.h"
+#include "zstd/lib/zstd.h"
 #include <commonlib/compression.h>
 
+static LZ4F_blockSizeID_t lz4_block_size = max4MB;
+
+int compression_set_lz4_block_size(size_t size)
+{
+	switch (size) {
+	case 64 * KiB:
+		lz4_block_size = max64KB;
+		break;
+	case 256 * KiB:
+		lz4_block_size = max256KB;
+		break;
+	case 1 * MiB:
+		lz4_block_size = max1MB;
+		break;
+	case 4 * MiB:
+		lz4_block_size = max4MB;
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
 static int lz4_compress(char *in, int in_len, char *out, int *out_len)
 {
 	LZ4F_preferences_t prefs = {
 		.compressionLevel = 20,
 		.frameInfo = {
-			.blockSizeID = max4MB,
+			.blockSizeID = lz4_block_size,
 			.blockMode = blockIndependent,
 			.contentChecksumFlag = noContentChecksum,
 		},
@@ -67,6 +91,55 @@ static int lzma_decompress(char *in, int in_len, char *out, unused int out_len,
 {
 	return do_lzma_uncompress(out, out_len, in, in_len, actual_size);
 }
+static int zstd_compress(char *in, int in_len, char *out, int *out_len)
+{
+	size_t worst_size = ZSTD_compressBound(in_len);
+	ZSTD_CCtx *cctx;
+	size_t result;
+	void *bounce;
+
+	cctx = ZSTD_createCCtx();
+	bounce = malloc(worst_size);
+	if (!cctx || !bounce) {
+		ZSTD_freeCCtx(cctx);
+		free(bounce);
+		return -1;
+	}
+
+	/* Images are compressed once and decompressed on every boot, so spend
+	 * the time on the highest level. The content size lets the decoder
+	 * check the output, a checksum would only slow it down. */
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+			       ZSTD_maxCLevel());
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 1);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 0);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_dictIDFlag, 0);
+
+	result = ZSTD_compress2(cctx, bounce, worst_size, in, in_len);
+	ZSTD_freeCCtx(cctx);
+
+	if (ZSTD_isError(result) || result >= (size_t)in_len) {
+		free(bounce);
+		return -1;
+	}
+
+	memcpy(out, bounce, result);
+	*out_len = result;
+	free(bounce);
+	return 0;
+}
+
+static int zstd_decompress(char *in, int in_len, char *out, int out_len,
+			   size_t *actual_size)
+{
+	size_t result = uzstdn(in, in_len, out, out_len);
+	if (result == 0)
+		return -1;
+	if (actual_size != NULL)
+		*actual_size = result;
+	return 0;
+}
+
 static int none_compress(char *in, int in_len, char *out, int *out_len)
 {
 	memcpy(out, in, in_len);
@@ -96,6 +169,9 @@ comp_func_ptr compression_function(enum comp_algo algo)
 	case CBFS_COMPRESS_LZ4:
 		compress = lz4_compress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		compress = zstd_compress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
@@ -116,6 +192,9 @@ decomp_func_ptr decompression_function(enum comp_algo algo)
 	case CBFS_COMPRESS_LZ4:
 		decompress = lz4_decompress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		decompress = zstd_decompress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
@@ -45,35 +45,46 @@ static struct ISzAlloc LZMAalloc = { SzAlloc, SzFree };
 
 /* Streaming API */
 
+/* The streams are kept per call so that several buffers can be compressed
+ * from different threads at the same time. */
 struct vector_t {
 	char *p;
 	size_t pos;
 	size_t size;
 };
 
-static struct vector_t instream, outstream;
+struct vector_instream {
+	struct ISeqInStream is;
+	struct vector_t v;
+};
+
+struct vector_outstream {
+	struct ISeqOutStream os;
+	struct vector_t v;
+};
 
-static SRes Read(unused void *u, void *buf, size_t *size)
+static SRes Read(void *u, void *buf, size_t *size)
 {
-	if ((instream.size - instream.pos) < *size)
-		*size = instream.size - instream.pos;
-	memcpy(buf, instream.p + instream.pos, *size);
-	instream.pos += *size;
+	struct vector_t *instream = &((struct vector_instream *)u)->v;
+
+	if ((instream->size - instream->pos) < *size)
+		*size = instream->size - instream->pos;
+	memcpy(buf, instream->p + instream->pos, *size);
+	instream->pos += *size;
 	return SZ_OK;
 }
 
-static size_t Write(unused void *u, const void *buf, size_t size)
+static size_t Write(void *u, const void *buf, size_t size)
 {
-	if(outstream.size - outstream.pos < size)
-		size = outstream.size - outstream.pos;
-	memcpy(outstream.p + outstream.pos, buf, size);
-	outstream.pos += size;
+	struct vector_t *outstream = &((struct vector_outstream *)u)->v;
+
+	if(outstream->size - outstream->pos < size)
+		size = outstream->size - outstream->pos;
+	memcpy(outstream->p + outstream->pos, buf, size);
+	outstream->pos += size;
 	return size;
 }
 
-static struct ISeqInStream is = { Read };
-static struct ISeqOutStream os = { Write };
-
 /**
  * Compress a buffer with lzma
  * Don't copy the result back if it is too large.
@@ -130,25 +141,32 @@ int do_lzma_compress(char *in, int in_len, char *out, int *out_len)
 		return -1;
 	}
 
-	instream.p = in;
-	instream.pos = 0;
-	instream.size = in_len;
-
-	outstream.p = out;
-	outstream.pos = 0;
-	outstream.size = in_len;
+	struct vector_instream is = {
+		.is = { Read },
+		.v = { .p = in, .pos = 0, .size = in_len },
+	};
+	struct vector_outstream os = {
+		.os = { Write },
+		.v = { .p = out, .pos = 0, .size = in_len },
+	};
 
 	put_64(propsEncoded + LZMA_PROPS_SIZE, in_len);
 	Write(&os, propsEncoded, LZMA_PROPS_SIZE+8);
 
-	res = LzmaEnc_Encode(p, &os, &is, 0, &LZMAalloc, &LZMAalloc);
+	res = LzmaEnc_Encode(p, &os.os, &is.is, 0, &LZMAalloc, &LZMAalloc);
 	LzmaEnc_Destroy(p, &LZMAalloc, &LZMAalloc);
+	/* Output larger than the input is not an error, the caller just
+	 * stores the data uncompressed. */
+	if (res == SZ_ERROR_WRITE) {
+		DEBUG("LZMA: Output does not fit, input is incompressible.\n");
+		return -1;
+	}
 	if (res != SZ_OK) {
 		ERROR("LZMA: LzmaEnc_Encode failed %d.\n", res);
 		return -1;
 	}
 
-	*out_len = outstream.pos;
+	*out_len = os.v.pos;
 	return 0;
 }
 
@@ -21,10 +21,24 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#define HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* Granularity at which modified parts of a mapped image are written back. */
+#define WRITE_BACK_CHUNK_SIZE 4096
+
 struct partitioned_file {
 	struct fmap *fmap;
 	struct buffer buffer;
 	FILE *stream;
+	/* When reopening an existing image, buffer is a private (copy-on-write)
+	 * mapping of the file and on_disk a shared read-only one. Comparing
+	 * the two tells which parts were modified. NULL if buffer is on the
+	 * heap. */
+	char *on_disk;
 };
 
 static bool fill_ones_through(struct partitioned_file *file)
@@ -49,6 +63,56 @@ static unsigned count_selected_fmap_entries(const struct fmap *fmap,
 	return count;
 }
 
+/*
+ * Map the image instead of reading it, so that only the pages that actually
+ * get modified take up memory of their own.
+ * @return Whether file->buffer now holds a mapping of the file.
+ */
+static bool map_flat_file(struct partitioned_file *file, const char *filename)
+{
+#ifdef HAVE_MMAP
+	int fd = fileno(file->stream);
+	struct stat st;
+	void *data, *on_disk;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return false;
+
+	data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+								fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+
+	on_disk = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (on_disk == MAP_FAILED) {
+		munmap(data, st.st_size);
+		return false;
+	}
+
+	file->buffer.name = strdup(filename);
+	file->buffer.data = data;
+	file->buffer.offset = 0;
+	file->buffer.size = st.st_size;
+	file->on_disk = on_disk;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void unmap_flat_file(struct partitioned_file *file)
+{
+#ifdef HAVE_MMAP
+	if (!file->on_disk)
+		return;
+
+	munmap(file->buffer.data, file->buffer.size);
+	munmap(file->on_disk, file->buffer.size);
+	file->buffer.data = NULL;
+	file->on_disk = NULL;
+#endif
+}
+
 static partitioned_file_t *reopen_flat_file(const char *filename,
 					    bool write_access)
 {
@@ -61,16 +125,17 @@ static partitioned_file_t *reopen_flat_file(const char *filename,
 		return NULL;
 	}
 
-	if (buffer_from_file(&file->buffer, filename)) {
-		free(file);
-		return NULL;
-	}
-
 	access_mode = write_access ?  "rb+" : "rb";
 	file->stream = fopen(filename, access_mode);
 
 	if (!file->stream) {
 		perror(filename);
+		free(file);
+		return NULL;
+	}
+
+	if (!map_flat_file(file, filename) &&
+				buffer_from_file(&file->buffer, filename)) {
 		partitioned_file_close(file);
 		return NULL;
 	}
@@ -206,6 +271,60 @@ partitioned_file_t *partitioned_file_reopen(const char *filename,
 	return file;
 }
 
+static bool write_range(partitioned_file_t *file, size_t offset,
+						const char *data, size_t size)
+{
+	if (fseek(file->stream, offset, SEEK_SET)) {
+		ERROR("Failed to seek within image file\n");
+		return false;
+	}
+	if (!fwrite(data, size, 1, file->stream)) {
+		ERROR("Failed to write to image file\n");
+		return false;
+	}
+	return true;
+}
+
+/* Only write the chunks of a mapped image that differ from the file. */
+static bool write_back_modified(partitioned_file_t *file,
+						const struct buffer *buffer)
+{
+	size_t end = buffer->offset + buffer->size;
+	size_t dirty_start = end;
+	size_t offset = buffer->offset;
+
+	while (offset < end) {
+		size_t chunk = WRITE_BACK_CHUNK_SIZE -
+					offset % WRITE_BACK_CHUNK_SIZE;
+		if (chunk > end - offset)
+			chunk = end - offset;
+
+		if (memcmp(file->buffer.data + offset, file->on_disk + offset,
+								chunk)) {
+			if (dirty_start == end)
+				dirty_start = offset;
+		} else if (dirty_start != end) {
+			if (!write_range(file, dirty_start,
+					file->buffer.data + dirty_start,
+					offset - dirty_start))
+				return false;
+			dirty_start = end;
+		}
+		offset += chunk;
+	}
+
+	if (dirty_start != end && !write_range(file, dirty_start,
+			file->buffer.data + dirty_start, end - dirty_start))
+		return false;
+
+	/* Keep on_disk up to date for later comparisons. */
+	if (fflush(file->stream)) {
+		ERROR("Failed to write to image file\n");
+		return false;
+	}
+	return true;
+}
+
 bool partitioned_file_write_region(partitioned_file_t *file,
 						const struct buffer *buffer)
 {
@@ -223,15 +342,10 @@ bool partitioned_file_write_region(partitioned_file_t *file,
 		return false;
 	}
 
-	if (fseek(file->stream, buffer->offset, SEEK_SET)) {
-		ERROR("Failed to seek within image file\n");
-		return false;
-	}
-	if (!fwrite(buffer->data, buffer->size, 1, file->stream)) {
-		ERROR("Failed to write to image file\n");
-		return false;
-	}
-	return true;
+	if (file->on_disk)
+		return write_back_modified(file, buffer);
+
+	return write_range(file, buffer->offset, buffer->data, buffer->size);
 }
 
 bool partitioned_file_read_region(struct buffer *dest,
@@ -272,6 +386,7 @@ void partitioned_file_close(partitioned_file_t *file)
 		return;
 
 	file->fmap = NULL;
+	unmap_flat_file(file);
 	buffer_delete(&file->buffer);
 	if (file->stream) {
 		fclose(file->stream);
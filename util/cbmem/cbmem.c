@@ -32,7 +32,15 @@
 #include <libgen.h>
 #include <assert.h>
 #include <regex.h>
+#include <elf.h>
+#include <commonlib/binlog_serialized.h>
+#include <commonlib/cbfs_lookup_serialized.h>
 #include <commonlib/cbmem_id.h>
+#include <commonlib/coverage_serialized.h>
+#include <commonlib/device_timing_serialized.h>
+#include <commonlib/func_trace_serialized.h>
+#include <commonlib/heap_stats_serialized.h>
+#include <commonlib/lapic_profile_serialized.h>
 #include <commonlib/timestamp_serialized.h>
 #include <commonlib/coreboot_tables.h>
 
@@ -55,7 +63,7 @@ typedef uint64_t u64;
 static int verbose = 0;
 #define debug(x...) if(verbose) printf(x)
 
-/* File handle used to access /dev/mem */
+/* File handle used to access /dev/mem, or the memory image */
 static int mem_fd;
 
 static uint64_t lbtable_address;
@@ -110,6 +118,213 @@ static u16 ipchcksum(const void *addr, unsigned size)
 	return (u16) sum;
 }
 
+/*
+ * Offline mode: instead of /dev/mem, physical memory is read from an image
+ * file. A raw image covers the physical range starting at a base address given
+ * on the command line, an ELF core file (e.g. from QEMU's dump-guest-memory)
+ * describes its ranges in PT_LOAD program headers.
+ */
+struct image_range {
+	u64 physical;
+	u64 offset;
+	u64 size;
+};
+
+static const char *image_file;
+static struct image_range *image_ranges;
+static size_t image_num_ranges;
+
+static void image_add_range(u64 physical, u64 offset, u64 size)
+{
+	struct image_range *r;
+
+	if (!size)
+		return;
+
+	image_ranges = realloc(image_ranges,
+			       (image_num_ranges + 1) * sizeof(*image_ranges));
+	if (!image_ranges) {
+		fprintf(stderr, "Failed to allocate image ranges\n");
+		exit(1);
+	}
+	r = &image_ranges[image_num_ranges++];
+	r->physical = physical;
+	r->offset = offset;
+	r->size = size;
+	debug("Image range 0x%" PRIx64 "-0x%" PRIx64 " at file offset 0x%"
+	      PRIx64 "\n", physical, physical + size - 1, offset);
+}
+
+static int image_read(u64 offset, void *buf, size_t len, u64 file_size)
+{
+	if (offset > file_size || len > file_size - offset)
+		return -1;
+	return pread(mem_fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+/* Collect the PT_LOAD segments of an ELF core. Returns 0 if not an ELF file. */
+static int image_parse_elf(u64 file_size)
+{
+	unsigned char ident[EI_NIDENT];
+	int i;
+
+	if (image_read(0, ident, sizeof(ident), file_size) ||
+	    memcmp(ident, ELFMAG, SELFMAG))
+		return 0;
+
+	if (ident[EI_DATA] != ELFDATA2LSB) {
+		fprintf(stderr, "%s: only little endian ELF files are supported\n",
+			image_file);
+		exit(1);
+	}
+
+	if (ident[EI_CLASS] == ELFCLASS64) {
+		Elf64_Ehdr ehdr;
+		Elf64_Phdr phdr;
+
+		if (image_read(0, &ehdr, sizeof(ehdr), file_size))
+			goto truncated;
+		for (i = 0; i < ehdr.e_phnum; i++) {
+			if (image_read(ehdr.e_phoff + (u64)i * ehdr.e_phentsize,
+				       &phdr, sizeof(phdr), file_size))
+				goto truncated;
+			if (phdr.p_type == PT_LOAD)
+				image_add_range(phdr.p_paddr, phdr.p_offset,
+						phdr.p_filesz);
+		}
+	} else if (ident[EI_CLASS] == ELFCLASS32) {
+		Elf32_Ehdr ehdr;
+		Elf32_Phdr phdr;
+
+		if (image_read(0, &ehdr, sizeof(ehdr), file_size))
+			goto truncated;
+		for (i = 0; i < ehdr.e_phnum; i++) {
+			if (image_read(ehdr.e_phoff + (u64)i * ehdr.e_phentsize,
+				       &phdr, sizeof(phdr), file_size))
+				goto truncated;
+			if (phdr.p_type == PT_LOAD)
+				image_add_range(phdr.p_paddr, phdr.p_offset,
+						phdr.p_filesz);
+		}
+	} else {
+		fprintf(stderr, "%s: unknown ELF class\n", image_file);
+		exit(1);
+	}
+
+	for (i = 0; i < image_num_ranges; i++) {
+		if (image_ranges[i].offset > file_size ||
+		    image_ranges[i].size > file_size - image_ranges[i].offset)
+			goto truncated;
+	}
+
+	return 1;
+
+truncated:
+	fprintf(stderr, "%s: truncated ELF file\n", image_file);
+	exit(1);
+}
+
+/* have_base is set when -a was given, which only makes sense for raw images. */
+static int open_image(const char *file, u64 base, int have_base)
+{
+	struct stat st;
+
+	image_file = file;
+	mem_fd = open(file, O_RDONLY, 0);
+	if (mem_fd < 0 || fstat(mem_fd, &st)) {
+		fprintf(stderr, "Failed to open %s: %s\n", file,
+			strerror(errno));
+		return -1;
+	}
+
+	if (image_parse_elf(st.st_size)) {
+		if (have_base) {
+			fprintf(stderr, "%s: -a can't be used with ELF core "
+				"images, their addresses are in the file\n",
+				file);
+			return -1;
+		}
+	} else {
+		image_add_range(base, 0, st.st_size);
+	}
+
+	if (!image_num_ranges) {
+		fprintf(stderr, "%s: image contains no memory\n", file);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Translate a physical address into an image file offset. *size is clipped
+ * to the end of the range containing the address so that we never map past
+ * the end of the file.
+ */
+static int image_offset(u64 physical, size_t *size, off_t *offset)
+{
+	size_t i;
+
+	for (i = 0; i < image_num_ranges; i++) {
+		const struct image_range *r = &image_ranges[i];
+
+		if (physical < r->physical ||
+		    physical - r->physical >= r->size)
+			continue;
+
+		*offset = r->offset + (physical - r->physical);
+		if (*size > r->size - (physical - r->physical))
+			*size = r->size - (physical - r->physical);
+		return 0;
+	}
+
+	return -1;
+}
+
+/*
+ * There is no /proc/iomem or device tree describing the dumped system, so
+ * scan the image for a coreboot table header. Returns its physical address or
+ * 0 when none was found.
+ */
+static u64 image_find_cbtable(void)
+{
+	size_t i;
+	u64 off;
+
+	for (i = 0; i < image_num_ranges; i++) {
+		const struct image_range *r = &image_ranges[i];
+		u64 page = getpagesize();
+		u64 skew = r->offset & (page - 1);
+		u8 *buf;
+
+		buf = mmap(NULL, r->size + skew, PROT_READ, MAP_SHARED, mem_fd,
+			   r->offset - skew);
+		if (buf == MAP_FAILED)
+			continue;
+
+		/* Headers are 16 byte aligned in physical memory. */
+		for (off = (16 - (r->physical & 15)) & 15;
+		     off + sizeof(struct lb_header) <= r->size; off += 16) {
+			struct lb_header *lbh = (void *)(buf + skew + off);
+
+			if (memcmp(lbh->signature, "LBIO",
+				   sizeof(lbh->signature)) ||
+			    !lbh->header_bytes ||
+			    ipchcksum(lbh, sizeof(*lbh)))
+				continue;
+
+			munmap(buf, r->size + skew);
+			debug("Found coreboot table header at 0x%" PRIx64 "\n",
+			      r->physical + off);
+			return r->physical + off;
+		}
+
+		munmap(buf, r->size + skew);
+	}
+
+	return 0;
+}
+
 /*
  * Functions to map / unmap physical memory into virtual address space. These
  * functions always maps 1MB at a time and can only map one area at once.
@@ -140,19 +355,36 @@ static void unmap_memory(void)
 	mapped_size = 0;
 }
 
-static void *map_memory_size(u64 physical, size_t size, uint8_t abort_on_failure)
+/*
+ * Map up to *sizep bytes. With an image, the mapping stops at the end of the
+ * image range containing the address and *sizep is updated to the length
+ * that was actually mapped.
+ */
+static void *map_memory_clipped(u64 physical, size_t *sizep,
+				uint8_t abort_on_failure)
 {
 	void *v;
-	off_t p;
+	off_t p = physical;
 	u64 page = getpagesize();
+	size_t size = *sizep;
 	size_t padding;
 
 	if (mapped_virtual != NULL)
 		unmap_memory();
 
+	if (image_file && image_offset(physical, &size, &p)) {
+		if (abort_on_failure) {
+			fprintf(stderr, "Address 0x%" PRIx64 " is not in %s\n",
+				physical, image_file);
+			exit(1);
+		}
+		return 0;
+	}
+	*sizep = size;
+
 	/* Mapped memory must be aligned to page size */
-	p = physical & ~(page - 1);
-	padding = physical & (page-1);
+	padding = p & (page - 1);
+	p &= ~(page - 1);
 	size += padding;
 
 	if (size_to_mib(size) == 0) {
@@ -182,7 +414,8 @@ static void *map_memory_size(u64 physical, size_t size, uint8_t abort_on_failure
 
 	if (v == MAP_FAILED) {
 		if (abort_on_failure) {
-			fprintf(stderr, "Failed to mmap /dev/mem: %s\n",
+			fprintf(stderr, "Failed to mmap %s: %s\n",
+				image_file ? image_file : "/dev/mem",
 				strerror(errno));
 			exit(1);
 		} else {
@@ -203,6 +436,26 @@ static void *map_memory_size(u64 physical, size_t size, uint8_t abort_on_failure
 	return v;
 }
 
+/* Map all of the requested range, or fail. */
+static void *map_memory_size(u64 physical, size_t size, uint8_t abort_on_failure)
+{
+	size_t mapped = size;
+	void *v;
+
+	v = map_memory_clipped(physical, &mapped, abort_on_failure);
+	if (!v || mapped == size)
+		return v;
+
+	unmap_memory();
+	if (abort_on_failure) {
+		fprintf(stderr, "Range 0x%" PRIx64 "-0x%" PRIx64
+			" is not entirely in %s\n", physical,
+			physical + size - 1, image_file);
+		exit(1);
+	}
+	return 0;
+}
+
 static void *map_lbtable(void)
 {
 	if (lbtable_address == 0 || lbtable_size == 0) {
@@ -297,13 +550,15 @@ static int parse_cbtable(u64 address, size_t table_size, uint8_t abort_on_failur
 
 	debug("Looking for coreboot table at %" PRIx64 " %zd bytes.\n",
 		address, table_size);
-	buf = map_memory_size(address, table_size, abort_on_failure);
+	/* An image range may end before table_size, only scan what's there. */
+	buf = map_memory_clipped(address, &table_size, abort_on_failure);
 	if (!buf)
 		return -2;
 
 	/* look at every 16 bytes within 4K of the base */
 
-	for (i = 0; i < 0x1000; i += 0x10) {
+	for (i = 0; i < 0x1000 && i + sizeof(struct lb_header) <= table_size;
+	     i += 0x10) {
 		struct lb_header *lbh;
 		struct lb_record* lbr_p;
 		void *lbtable;
@@ -317,6 +572,12 @@ static int parse_cbtable(u64 address, size_t table_size, uint8_t abort_on_failur
 		}
 		lbtable = buf + i + lbh->header_bytes;
 
+		if (lbh->header_bytes > table_size - i ||
+		    lbh->table_bytes > table_size - i - lbh->header_bytes) {
+			debug("Signature found, but table is not mapped.\n");
+			continue;
+		}
+
 		if (ipchcksum(lbtable, lbh->table_bytes) !=
 		    lbh->table_checksum) {
 			debug("Signature found, but wrong checksum.\n");
@@ -464,6 +725,11 @@ static void timestamp_set_tick_freq(unsigned long table_tick_freq_mhz)
 	if (tick_freq_mhz)
 		return;
 
+	/* The host running cbmem is not the machine that recorded an image. */
+	if (image_file)
+		fprintf(stderr, "Warning: timestamp table has no tick frequency, "
+			"assuming the one of this machine.\n");
+
 	tick_freq_mhz = arch_tick_frequency();
 
 	if (!tick_freq_mhz) {
@@ -543,6 +809,186 @@ uint64_t timestamp_print_entry(uint32_t id, uint64_t stamp, uint64_t prev_stamp)
 	return step_time;
 }
 
+static uint64_t span_total(const struct timestamp_span *span)
+{
+	return span->end > span->start ? span->end - span->start : 0;
+}
+
+/* Child lists and child time of every span, built once from the parent
+ * links. Indices are index + 1, 0 ends a list. */
+struct span_tree {
+	uint32_t *first_child;
+	uint32_t *next_sibling;
+	uint64_t *children;
+};
+
+static void print_span(const struct timestamp_span_table *tst,
+		       const struct span_tree *tree, uint32_t index, int depth)
+{
+	const struct timestamp_span *span = &tst->entries[index];
+	uint64_t total = span_total(span);
+	uint64_t children = tree->children[index];
+	uint32_t child;
+
+	if (span->end) {
+		printf("%12llu %12llu ",
+		       (unsigned long long)arch_convert_raw_ts_entry(total),
+		       (unsigned long long)arch_convert_raw_ts_entry(
+			       total > children ? total - children : 0));
+	} else {
+		printf("%12s %12s ", "(open)", "");
+	}
+	printf("%3u %*s", span->cpu, depth * 2, "");
+	if (span->id)
+		printf("%s%s", timestamp_name(span->id),
+		       span->label[0] ? ": " : "");
+	printf("%.*s\n", (int)sizeof(span->label), span->label);
+
+	for (child = tree->first_child[index]; child;
+	     child = tree->next_sibling[child - 1])
+		print_span(tst, tree, child - 1, depth + 1);
+}
+
+static int span_same_name(const struct timestamp_span *a,
+			  const struct timestamp_span *b)
+{
+	return a->id == b->id && !strcmp(a->label, b->label);
+}
+
+/* Sums up top-level spans of the same name, e.g. "AP init" on every CPU. */
+static void print_span_rollup(const struct timestamp_span_table *tst)
+{
+	uint32_t i, j, count;
+	uint64_t total, max;
+
+	printf("\n%8s %12s %12s %s\n", "count", "total (us)", "max (us)",
+	       "top-level span");
+	for (i = 0; i < tst->num_entries; i++) {
+		const struct timestamp_span *span = &tst->entries[i];
+
+		if (span->parent)
+			continue;
+
+		/* Only print a name at its first occurrence. */
+		for (j = 0; j < i; j++)
+			if (!tst->entries[j].parent &&
+			    span_same_name(&tst->entries[j], span))
+				break;
+		if (j < i)
+			continue;
+
+		count = 0;
+		total = 0;
+		max = 0;
+		for (j = i; j < tst->num_entries; j++) {
+			const struct timestamp_span *other = &tst->entries[j];
+
+			if (other->parent || !span_same_name(other, span))
+				continue;
+			count++;
+			total += span_total(other);
+			if (span_total(other) > max)
+				max = span_total(other);
+		}
+
+		printf("%8u %12llu %12llu ", count,
+		       (unsigned long long)arch_convert_raw_ts_entry(total),
+		       (unsigned long long)arch_convert_raw_ts_entry(max));
+		if (span->id)
+			printf("%s%s", timestamp_name(span->id),
+			       span->label[0] ? ": " : "");
+		printf("%.*s\n", (int)sizeof(span->label), span->label);
+	}
+}
+
+/* Returns a copy of the timestamp span table, or NULL if there is none. */
+static struct timestamp_span_table *read_timestamp_spans(void)
+{
+	struct timestamp_span_table *tst;
+	uint64_t start;
+	size_t size;
+	uint32_t i;
+
+	if (find_cbmem_entry(CBMEM_ID_TIMESTAMP_SPANS, &start, &size) ||
+	    size < sizeof(*tst))
+		return NULL;
+
+	tst = malloc(size);
+	if (!tst) {
+		fprintf(stderr, "Could not allocate memory for spans\n");
+		exit(1);
+	}
+	aligned_memcpy(tst, map_memory_size(start, size, 1), size);
+	unmap_memory();
+
+	if (tst->version != TIMESTAMP_SPAN_VERSION) {
+		fprintf(stderr, "Unknown timestamp span version %u\n",
+			tst->version);
+		free(tst);
+		return NULL;
+	}
+
+	if (tst->num_entries > (size - sizeof(*tst)) / sizeof(tst->entries[0]))
+		tst->num_entries = (size - sizeof(*tst)) /
+			sizeof(tst->entries[0]);
+
+	/* Children always come after their parent, so any bad link is one
+	 * that points forward. Treat those spans as roots. */
+	for (i = 0; i < tst->num_entries; i++) {
+		if (tst->entries[i].parent > i)
+			tst->entries[i].parent = 0;
+		tst->entries[i].label[TIMESTAMP_SPAN_LABEL_LEN - 1] = '\0';
+	}
+
+	return tst;
+}
+
+/* dump the timestamp span tree */
+static void dump_timestamp_spans(void)
+{
+	struct timestamp_span_table *tst;
+	struct span_tree tree;
+	uint32_t i;
+
+	tst = read_timestamp_spans();
+	if (!tst)
+		return;
+
+	timestamp_set_tick_freq(tst->tick_freq_mhz);
+
+	tree.first_child = calloc(tst->num_entries + 1, sizeof(uint32_t));
+	tree.next_sibling = calloc(tst->num_entries + 1, sizeof(uint32_t));
+	tree.children = calloc(tst->num_entries + 1, sizeof(uint64_t));
+	if (!tree.first_child || !tree.next_sibling || !tree.children) {
+		fprintf(stderr, "Could not allocate memory for spans\n");
+		exit(1);
+	}
+
+	/* Walk backwards so every child list ends up in table order. */
+	for (i = tst->num_entries; i-- > 0;) {
+		const struct timestamp_span *span = &tst->entries[i];
+
+		if (!span->parent)
+			continue;
+		tree.next_sibling[i] = tree.first_child[span->parent - 1];
+		tree.first_child[span->parent - 1] = i + 1;
+		tree.children[span->parent - 1] += span_total(span);
+	}
+
+	printf("\n%u spans:\n\n", tst->num_entries);
+	printf("%12s %12s %3s %s\n", "total (us)", "self (us)", "cpu", "span");
+	for (i = 0; i < tst->num_entries; i++)
+		if (!tst->entries[i].parent)
+			print_span(tst, &tree, i, 0);
+
+	print_span_rollup(tst);
+
+	free(tree.first_child);
+	free(tree.next_sibling);
+	free(tree.children);
+	free(tst);
+}
+
 /* dump the timestamp table */
 static void dump_timestamps(int mach_readable)
 {
@@ -602,6 +1048,9 @@ static void dump_timestamps(int mach_readable)
 	}
 
 	unmap_memory();
+
+	if (!mach_readable)
+		dump_timestamp_spans();
 }
 
 struct cbmem_console {
@@ -613,8 +1062,12 @@ struct cbmem_console {
 #define CBMC_CURSOR_MASK ((1 << 28) - 1)
 #define CBMC_OVERFLOW (1 << 31)
 
-/* dump the cbmem console */
-static void dump_console(int one_boot_only)
+/*
+ * Read the cbmem console into a NUL terminated buffer. *start is set to the
+ * beginning of the last boot's output if one_boot_only is set, 0 otherwise.
+ * Returns NULL if there is no console. The caller frees the buffer.
+ */
+static char *read_console(int one_boot_only, size_t *start)
 {
 	struct cbmem_console *console_p;
 	char *console_c;
@@ -622,7 +1075,7 @@ static void dump_console(int one_boot_only)
 
 	if (console.tag != LB_TAG_CBMEM_CONSOLE) {
 		fprintf(stderr, "No console found in coreboot table.\n");
-		return;
+		return NULL;
 	}
 
 	size = sizeof(*console_p);
@@ -690,261 +1143,1692 @@ static void dump_console(int one_boot_only)
 		}
 	}
 
-	puts(console_c + cursor);
-	free(console_c);
 	unmap_memory();
+	*start = cursor;
+	return console_c;
 }
 
-static void hexdump(unsigned long memory, int length)
+/* dump the cbmem console */
+static void dump_console(int one_boot_only)
 {
-	int i;
-	uint8_t *m;
-	int all_zero = 0;
+	size_t start;
+	char *console_c = read_console(one_boot_only, &start);
 
-	m = map_memory_size((intptr_t)memory, length, 1);
+	if (!console_c)
+		return;
 
-	if (length > MAP_BYTES) {
-		printf("Truncating hex dump from %d to %d bytes\n\n",
-			length, MAP_BYTES);
-		length = MAP_BYTES;
-	}
+	puts(console_c + start);
+	free(console_c);
+}
 
-	for (i = 0; i < length; i += 16) {
-		int j;
+/*
+ * Chrome Trace Event export. Every stage is a process lane. Matching
+ * start/end timestamps and timestamp spans become duration events, other
+ * timestamps and console lines become instant events. Console lines carry
+ * no time of their own: each one is placed at the latest preceding line that
+ * can be tied to a timestamp, like a stage banner or a device init message.
+ */
 
-		all_zero++;
-		for (j = 0; j < 16; j++) {
-			if(m[i+j] != 0) {
-				all_zero = 0;
-				break;
-			}
-		}
+enum trace_lane {
+	TRACE_LANE_BOOTBLOCK = 1,
+	TRACE_LANE_ROMSTAGE,
+	TRACE_LANE_RAMSTAGE,
+	TRACE_LANE_PAYLOAD,
+};
 
-		if (all_zero < 2) {
-			printf("%08lx:", memory + i);
-			for (j = 0; j < 16; j++)
-				printf(" %02x", m[i+j]);
-			printf("  ");
-			for (j = 0; j < 16; j++)
-				printf("%c", isprint(m[i+j]) ? m[i+j] : '.');
-			printf("\n");
-		} else if (all_zero == 2) {
-			printf("...\n");
-		}
-	}
+static const char *const trace_lane_names[] = {
+	[TRACE_LANE_BOOTBLOCK] = "bootblock",
+	[TRACE_LANE_ROMSTAGE] = "romstage",
+	[TRACE_LANE_RAMSTAGE] = "ramstage",
+	[TRACE_LANE_PAYLOAD] = "payload",
+};
 
-	unmap_memory();
-}
+#define TRACE_TID_TIMESTAMPS	0
+#define TRACE_TID_CONSOLE	1
+#define TRACE_TID_CPU(cpu)	(100 + (cpu))
+
+static const struct {
+	uint32_t start;
+	uint32_t end;
+} trace_pairs[] = {
+	{ TS_START_BOOTBLOCK, TS_END_BOOTBLOCK },
+	{ TS_START_ROMSTAGE, TS_END_ROMSTAGE },
+	{ TS_BEFORE_INITRAM, TS_AFTER_INITRAM },
+	{ TS_START_VBOOT, TS_END_VBOOT },
+	{ TS_START_COPYRAM, TS_END_COPYRAM },
+	{ TS_START_COPYROM, TS_END_COPYROM },
+	{ TS_START_ULZMA, TS_END_ULZMA },
+	{ TS_START_ULZ4F, TS_END_ULZ4F },
+	{ TS_START_UZSTD, TS_END_UZSTD },
+	{ TS_START_PAYLOAD_PREFETCH, TS_END_PAYLOAD_PREFETCH },
+	{ TS_START_COPYVER, TS_END_COPYVER },
+	{ TS_START_TPMINIT, TS_END_TPMINIT },
+	{ TS_START_VERIFY_SLOT, TS_END_VERIFY_SLOT },
+	{ TS_START_HASH_BODY, TS_END_HASH_BODY },
+	{ TS_START_COPYVPD, TS_END_COPYVPD_RO },
+	{ TS_FSP_MEMORY_INIT_START, TS_FSP_MEMORY_INIT_END },
+	{ TS_FSP_TEMP_RAM_EXIT_START, TS_FSP_TEMP_RAM_EXIT_END },
+	{ TS_FSP_SILICON_INIT_START, TS_FSP_SILICON_INIT_END },
+	{ TS_FSP_BEFORE_ENUMERATE, TS_FSP_AFTER_ENUMERATE },
+	{ TS_FSP_BEFORE_FINALIZE, TS_FSP_AFTER_FINALIZE },
+	{ TS_FSP_BEFORE_END_OF_FIRMWARE, TS_FSP_AFTER_END_OF_FIRMWARE },
+};
 
-static void dump_cbmem_hex(void)
+static int trace_first_event;
+
+static void trace_json_string(const char *str, size_t len)
 {
-	if (cbmem.type != LB_MEM_TABLE) {
-		fprintf(stderr, "No coreboot CBMEM area found!\n");
-		return;
+	size_t i;
+
+	putchar('"');
+	for (i = 0; i < len && str[i]; i++) {
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			printf("\\u%04x", c);
+		else
+			putchar(c);
 	}
+	putchar('"');
+}
 
-	hexdump(unpack_lb64(cbmem.start), unpack_lb64(cbmem.size));
+/* Start a trace event, the caller adds any further fields and the '}'. */
+static void trace_event(const char *ph, const char *name, size_t name_len,
+			int pid, int tid, uint64_t ts)
+{
+	printf("%s\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%llu,"
+	       "\"name\":", trace_first_event ? "" : ",", ph, pid, tid,
+	       (unsigned long long)ts);
+	trace_first_event = 0;
+	trace_json_string(name, name_len);
 }
 
-void rawdump(uint64_t base, uint64_t size)
+static void trace_metadata(const char *what, int pid, int tid,
+			   const char *name)
 {
-	int i;
-	uint8_t *m;
+	trace_event("M", what, strlen(what), pid, tid, 0);
+	printf(",\"args\":{\"name\":");
+	trace_json_string(name, strlen(name));
+	printf("}}");
+}
 
-	m = map_memory_size((intptr_t)base, size, 1);
-	if (!m) {
-		fprintf(stderr, "Failed to map memory");
-		return;
+static int trace_lane_of(uint32_t id, int lane)
+{
+	switch (id) {
+	case TS_START_BOOTBLOCK:
+		return TRACE_LANE_BOOTBLOCK;
+	case TS_START_ROMSTAGE:
+		return TRACE_LANE_ROMSTAGE;
+	case TS_START_RAMSTAGE:
+		return TRACE_LANE_RAMSTAGE;
+	default:
+		return lane;
 	}
-
-	for (i = 0 ; i < size; i++)
-		printf("%c", m[i]);
-	unmap_memory();
 }
 
-static void dump_cbmem_raw(unsigned int id)
+static int trace_pair_end(uint32_t id)
 {
-	uint8_t *table;
-	size_t offset;
-	uint64_t base = 0;
-	uint64_t size = 0;
+	int i;
 
-	table = map_lbtable();
+	for (i = 0; i < ARRAY_SIZE(trace_pairs); i++)
+		if (trace_pairs[i].start == id)
+			return trace_pairs[i].end;
+	return -1;
+}
 
-	if (table == NULL)
-		return;
+/* Finds the time a console line can be tied to, or returns 0. */
+static int trace_anchor_line(const char *line, size_t len,
+			     const struct timestamp_table *tst,
+			     const struct timestamp_span_table *spans,
+			     uint64_t *ts, int *lane)
+{
+	static const struct {
+		const char *banner;
+		uint32_t id;
+	} banners[] = {
+		{ " bootblock starting...", TS_START_BOOTBLOCK },
+		{ " romstage starting...", TS_START_ROMSTAGE },
+		{ " ramstage starting...", TS_START_RAMSTAGE },
+		{ "Jumping to boot code", TS_SELFBOOT_JUMP },
+	};
+	char text[256];
+	uint32_t i, j;
 
-	offset = 0;
+	if (len >= sizeof(text))
+		len = sizeof(text) - 1;
+	memcpy(text, line, len);
+	text[len] = '\0';
 
-	while (offset < lbtable_size) {
-		struct lb_record *lbr;
-		struct lb_cbmem_entry *lbe;
+	for (i = 0; i < ARRAY_SIZE(banners); i++) {
+		if (!strstr(text, banners[i].banner))
+			continue;
+		for (j = 0; j < tst->num_entries; j++) {
+			if (tst->entries[j].entry_id != banners[i].id)
+				continue;
+			*ts = tst->entries[j].entry_stamp;
+			*lane = trace_lane_of(banners[i].id, *lane);
+			return 1;
+		}
+		return 0;
+	}
+
+	if (!spans)
+		return 0;
+
+	/* "<device path> init ..." starts the device's init span and
+	   "BS: <state> times (us): ..." ends a boot state span. */
+	for (i = 0; i < spans->num_entries; i++) {
+		const struct timestamp_span *span = &spans->entries[i];
+		size_t label_len = strlen(span->label);
+
+		if (!label_len)
+			continue;
+
+		if (span->start >= *ts &&
+		    !strncmp(text, span->label, label_len) &&
+		    !strcmp(text + label_len, " init ...")) {
+			*ts = span->start;
+			return 1;
+		}
+
+		if (span->end >= *ts && !strncmp(text, "BS: ", 4) &&
+		    !strncmp(text + 4, span->label, label_len) &&
+		    !strncmp(text + 4 + label_len, " times", 6)) {
+			*ts = span->end;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void dump_trace_json(void)
+{
+	struct timestamp_table *tst_p;
+	struct timestamp_span_table *spans;
+	char *console_c, *line, *end;
+	uint8_t *used;
+	uint64_t ts, console_ts;
+	size_t size, start;
+	uint32_t i, j;
+	int lane, console_lane, pair;
+
+	if (timestamps.tag != LB_TAG_TIMESTAMPS) {
+		fprintf(stderr, "No timestamps found in coreboot table.\n");
+		return;
+	}
+
+	size = sizeof(*tst_p);
+	tst_p = map_memory_size((unsigned long)timestamps.cbmem_addr, size, 1);
+	size += tst_p->num_entries * sizeof(tst_p->entries[0]);
+	unmap_memory();
+
+	tst_p = malloc(size);
+	if (!tst_p) {
+		fprintf(stderr, "Could not allocate memory for timestamps\n");
+		exit(1);
+	}
+	aligned_memcpy(tst_p, map_memory_size(
+		(unsigned long)timestamps.cbmem_addr, size, 1), size);
+	unmap_memory();
+
+	timestamp_set_tick_freq(tst_p->tick_freq_mhz);
+	spans = read_timestamp_spans();
+
+	used = calloc(tst_p->num_entries + 1, 1);
+	if (!used) {
+		fprintf(stderr, "Could not allocate memory for timestamps\n");
+		exit(1);
+	}
+
+	trace_first_event = 1;
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	for (i = TRACE_LANE_BOOTBLOCK; i < ARRAY_SIZE(trace_lane_names); i++) {
+		trace_metadata("process_name", i, 0, trace_lane_names[i]);
+		trace_metadata("thread_name", i, TRACE_TID_TIMESTAMPS,
+			       "timestamps");
+		trace_metadata("thread_name", i, TRACE_TID_CONSOLE, "console");
+	}
+
+	lane = TRACE_LANE_BOOTBLOCK;
+	for (i = 0; i < tst_p->num_entries; i++) {
+		const struct timestamp_entry *tse = &tst_p->entries[i];
+		const char *name = timestamp_name(tse->entry_id);
+
+		lane = trace_lane_of(tse->entry_id, lane);
+		ts = arch_convert_raw_ts_entry(tse->entry_stamp +
+					       tst_p->base_time);
+
+		if (used[i])
+			continue;
+
+		pair = trace_pair_end(tse->entry_id);
+		for (j = i + 1; pair >= 0 && j < tst_p->num_entries; j++) {
+			if (tst_p->entries[j].entry_id != pair || used[j])
+				continue;
+			used[j] = 1;
+			trace_event("X", name, strlen(name), lane,
+				    TRACE_TID_TIMESTAMPS, ts);
+			printf(",\"dur\":%llu}", (unsigned long long)
+			       arch_convert_raw_ts_entry(
+				       tst_p->entries[j].entry_stamp -
+				       tse->entry_stamp));
+			break;
+		}
+
+		if (pair >= 0 && j < tst_p->num_entries)
+			continue;
+
+		trace_event("i", name, strlen(name), lane,
+			    TRACE_TID_TIMESTAMPS, ts);
+		printf(",\"s\":\"p\"}");
+
+		/* Everything after the handoff belongs to the payload. */
+		if (tse->entry_id == TS_SELFBOOT_JUMP)
+			lane = TRACE_LANE_PAYLOAD;
+	}
+
+	if (spans) {
+		for (i = 0; i < spans->num_entries; i++) {
+			const struct timestamp_span *span = &spans->entries[i];
+			const char *name = span->label;
+
+			if (!span->end)
+				continue;
+			if (!name[0])
+				name = timestamp_name(span->id);
+			ts = arch_convert_raw_ts_entry(span->start +
+						       spans->base_time);
+			trace_event("X", name, strlen(name),
+				    TRACE_LANE_RAMSTAGE,
+				    TRACE_TID_CPU(span->cpu), ts);
+			printf(",\"dur\":%llu}", (unsigned long long)
+			       arch_convert_raw_ts_entry(span->end -
+							 span->start));
+		}
+	}
+
+	console_c = read_console(1, &start);
+	console_ts = 0;
+	console_lane = TRACE_LANE_BOOTBLOCK;
+	for (line = console_c ? console_c + start : NULL; line && *line;
+	     line = *end ? end + 1 : end) {
+		end = strchr(line, '\n');
+		if (!end)
+			end = line + strlen(line);
+		if (end == line)
+			continue;
+
+		/* Stamps from the flat table and from spans share the same
+		   base, so the anchor can be kept relative to it. */
+		ts = console_ts;
+		if (trace_anchor_line(line, end - line, tst_p, spans, &ts,
+				      &console_lane) && ts >= console_ts)
+			console_ts = ts;
+
+		trace_event("i", line, end - line, console_lane,
+			    TRACE_TID_CONSOLE, arch_convert_raw_ts_entry(
+				    console_ts + tst_p->base_time));
+		printf(",\"s\":\"t\",\"cat\":\"console\"}");
+	}
+
+	printf("\n]}\n");
+
+	free(console_c);
+	free(spans);
+	free(used);
+	free(tst_p);
+}
+
+static void hexdump(unsigned long memory, int length)
+{
+	int i;
+	uint8_t *m;
+	int all_zero = 0;
+
+	m = map_memory_size((intptr_t)memory, length, 1);
+
+	if (length > MAP_BYTES) {
+		printf("Truncating hex dump from %d to %d bytes\n\n",
+			length, MAP_BYTES);
+		length = MAP_BYTES;
+	}
+
+	for (i = 0; i < length; i += 16) {
+		int j;
+
+		all_zero++;
+		for (j = 0; j < 16; j++) {
+			if(m[i+j] != 0) {
+				all_zero = 0;
+				break;
+			}
+		}
+
+		if (all_zero < 2) {
+			printf("%08lx:", memory + i);
+			for (j = 0; j < 16; j++)
+				printf(" %02x", m[i+j]);
+			printf("  ");
+			for (j = 0; j < 16; j++)
+				printf("%c", isprint(m[i+j]) ? m[i+j] : '.');
+			printf("\n");
+		} else if (all_zero == 2) {
+			printf("...\n");
+		}
+	}
+
+	unmap_memory();
+}
+
+static void dump_cbmem_hex(void)
+{
+	if (cbmem.type != LB_MEM_TABLE) {
+		fprintf(stderr, "No coreboot CBMEM area found!\n");
+		return;
+	}
+
+	hexdump(unpack_lb64(cbmem.start), unpack_lb64(cbmem.size));
+}
+
+void rawdump(uint64_t base, uint64_t size)
+{
+	int i;
+	uint8_t *m;
+
+	m = map_memory_size((intptr_t)base, size, 1);
+	if (!m) {
+		fprintf(stderr, "Failed to map memory");
+		return;
+	}
+
+	for (i = 0 ; i < size; i++)
+		printf("%c", m[i]);
+	unmap_memory();
+}
+
+static void dump_cbmem_raw(unsigned int id)
+{
+	uint8_t *table;
+	size_t offset;
+	uint64_t base = 0;
+	uint64_t size = 0;
+
+	table = map_lbtable();
+
+	if (table == NULL)
+		return;
+
+	offset = 0;
+
+	while (offset < lbtable_size) {
+		struct lb_record *lbr;
+		struct lb_cbmem_entry *lbe;
+
+		lbr = (void *)(table + offset);
+		offset += lbr->size;
+
+		if (lbr->tag != LB_TAG_CBMEM_ENTRY)
+			continue;
+
+		lbe = (void *)lbr;
+		if (lbe->id == id) {
+			debug("found id for raw dump %0x", lbe->id);
+			base = lbe->address;
+			size = lbe->entry_size;
+			break;
+		}
+	}
+
+	unmap_lbtable();
+
+	if (!base)
+		fprintf(stderr, "id %0x not found in cbtable\n", id);
+	else
+		rawdump(base, size);
+}
+
+struct cbmem_id_to_name {
+	uint32_t id;
+	const char *name;
+};
+static const struct cbmem_id_to_name cbmem_ids[] = { CBMEM_ID_TO_NAME_TABLE };
+
+void cbmem_print_entry(int n, uint32_t id, uint64_t base, uint64_t size)
+{
+	int i;
+	const char *name;
+
+	name = NULL;
+	for (i = 0; i < ARRAY_SIZE(cbmem_ids); i++) {
+		if (cbmem_ids[i].id == id) {
+			name = cbmem_ids[i].name;
+			break;
+		}
+	}
+
+	printf("%2d. ", n);
+	if (name == NULL)
+		printf("%08x ", id);
+	else
+		printf("%s\t%08x", name, id);
+	printf("  %08" PRIx64 " ", base);
+	printf("  %08" PRIx64 "\n", size);
+}
+
+static void dump_cbmem_toc(void)
+{
+	int i;
+	uint8_t *table;
+	size_t offset;
+
+	table = map_lbtable();
+
+	if (table == NULL)
+		return;
+
+	printf("CBMEM table of contents:\n");
+	printf("    NAME          ID           START      LENGTH\n");
+
+	i = 0;
+	offset = 0;
+
+	while (offset < lbtable_size) {
+		struct lb_record *lbr;
+		struct lb_cbmem_entry *lbe;
+
+		lbr = (void *)(table + offset);
+		offset += lbr->size;
+
+		if (lbr->tag != LB_TAG_CBMEM_ENTRY)
+			continue;
+
+		lbe = (void *)lbr;
+		cbmem_print_entry(i, lbe->id, lbe->address, lbe->entry_size);
+		i++;
+	}
+
+	unmap_lbtable();
+}
+
+static int mkpath(char *path, mode_t mode)
+{
+	assert (path && *path);
+	char *p;
+	for (p = strchr(path+1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		if (mkdir(path, mode) == -1) {
+			if (errno != EEXIST) {
+				*p = '/';
+				return -1;
+			}
+		}
+		*p = '/';
+	}
+	return 0;
+}
+
+static void dump_coverage(void)
+{
+	uint64_t start;
+	size_t size, offset;
+	uint8_t *coverage;
+	struct coverage_header *header;
+	uint32_t i;
+
+	if (find_cbmem_entry(CBMEM_ID_COVERAGE, &start, &size) ||
+	    size < sizeof(*header)) {
+		fprintf(stderr, "No coverage information found\n");
+		return;
+	}
+
+	/* Map coverage area */
+	coverage = map_memory_size(start, size, 1);
+	header = (struct coverage_header *)coverage;
+	if (header->magic != COVERAGE_MAGIC) {
+		fprintf(stderr, "Coverage data has an unknown format\n");
+		unmap_memory();
+		return;
+	}
+	if (header->size < size)
+		size = header->size;
+
+	printf("Dumping coverage data...\n");
+
+	offset = sizeof(*header);
+	for (i = 0; i < header->num_files; i++) {
+		struct coverage_file *file;
+		char *filename;
+		FILE *f;
+
+		file = (struct coverage_file *)(coverage + offset);
+		if (size - offset < sizeof(*file) ||
+		    size - offset - sizeof(*file) < file->name_len ||
+		    size - offset - sizeof(*file) - file->name_len <
+		    file->data_len || file->name_len == 0) {
+			fprintf(stderr, "Coverage data truncated at file %u\n",
+				i);
+			break;
+		}
+
+		filename = strndup((char *)&file[1], file->name_len - 1);
+		debug(" -> %s (%u bytes)\n", filename, file->data_len);
+		if (mkpath(filename, 0755) == -1) {
+			perror("Directory for coverage data could "
+				"not be created");
+			exit(1);
+		}
+		f = fopen(filename, "wb");
+		if (!f) {
+			printf("Could not open %s: %s\n",
+				filename, strerror(errno));
+			exit(1);
+		}
+		if (file->data_len && fwrite((char *)&file[1] + file->name_len,
+					     file->data_len, 1, f) != 1) {
+			printf("Could not write to %s: %s\n",
+				filename, strerror(errno));
+			exit(1);
+		}
+		fclose(f);
+		free(filename);
+
+		offset += sizeof(*file) + file->name_len + file->data_len;
+	}
+	unmap_memory();
+}
+
+static void dump_cbfs_lookup(void)
+{
+	uint64_t start;
+	size_t size;
+	struct cbfs_lookup_cache *cache;
+	uint32_t i, num_entries;
+
+	if (find_cbmem_entry(CBMEM_ID_CBFS_LOOKUP, &start, &size) ||
+	    size < sizeof(*cache)) {
+		fprintf(stderr, "No CBFS lookup cache found\n");
+		return;
+	}
+
+	cache = map_memory_size(start, size, 1);
+
+	num_entries = cache->num_entries;
+	if (num_entries > (size - sizeof(*cache)) / sizeof(cache->entries[0]))
+		num_entries = (size - sizeof(*cache)) / sizeof(cache->entries[0]);
+
+	printf("CBFS lookup cache: %u hits, %u misses, %u/%u entries\n",
+	       cache->hits, cache->misses, cache->num_entries,
+	       cache->max_entries);
+
+	if (num_entries)
+		printf("  %-10s %-10s %-10s %-10s %s\n", "hash", "type",
+		       "cbfs", "offset", "size");
+
+	for (i = 0; i < num_entries; i++) {
+		struct cbfs_lookup_entry *e = &cache->entries[i];
+
+		printf("  0x%08x 0x%08x 0x%08x 0x%08x %u\n", e->name_hash,
+		       e->type, e->cbfs_offset, e->file_offset, e->data_size);
+	}
+
+	unmap_memory();
+}
+
+static void dump_heap_stats(void)
+{
+	uint64_t start;
+	size_t size;
+	struct heap_stats *stats;
+	uint32_t free_bytes;
+
+	if (find_cbmem_entry(CBMEM_ID_HEAP_STATS, &start, &size) ||
+	    size < sizeof(*stats)) {
+		fprintf(stderr, "No heap statistics found\n");
+		return;
+	}
+
+	stats = map_memory_size(start, size, 1);
+
+	free_bytes = stats->heap_size - stats->in_use;
+	printf("Heap: %u bytes\n", stats->heap_size);
+	printf("  in use:        %u bytes, peak %u bytes\n", stats->in_use,
+	       stats->peak_in_use);
+	printf("  allocations:   %u, %u freed\n", stats->num_allocs,
+	       stats->num_frees);
+	printf("  free:          %u bytes in %u blocks, largest %u bytes\n",
+	       free_bytes, stats->free_blocks, stats->largest_free);
+	if (free_bytes)
+		printf("  fragmentation: %u%%\n", (uint32_t)(100 -
+		       (uint64_t)stats->largest_free * 100 / free_bytes));
+
+	unmap_memory();
+}
+
+/* Argument reader for one binary log record. */
+struct binlog_args {
+	const u8 *pos;
+	const u8 *end;
+	int missing;
+};
+
+static int binlog_get(struct binlog_args *a, void *dst, size_t len)
+{
+	if (a->missing || (size_t)(a->end - a->pos) < len) {
+		a->missing = 1;
+		return -1;
+	}
+	memcpy(dst, a->pos, len);
+	a->pos += len;
+	return 0;
+}
+
+static int binlog_get_int(struct binlog_args *a, u32 *v)
+{
+	return binlog_get(a, v, sizeof(*v));
+}
+
+/* Reads a little endian integer of len (4 or 8) bytes. */
+static int binlog_get_num(struct binlog_args *a, size_t len, u64 *v)
+{
+	u32 lo, hi = 0;
+
+	if (binlog_get_int(a, &lo))
+		return -1;
+	if (len == sizeof(u64) && binlog_get_int(a, &hi))
+		return -1;
+	*v = ((u64)hi << 32) | lo;
+	return 0;
+}
+
+static const char *binlog_get_string(struct binlog_args *a)
+{
+	const char *s = (const char *)a->pos;
+	size_t len;
+
+	if (a->missing)
+		return NULL;
+	len = strnlen(s, a->end - a->pos);
+	if (len == (size_t)(a->end - a->pos)) {
+		a->missing = 1;
+		return NULL;
+	}
+	a->pos += len + 1;
+	return s;
+}
+
+#define BINLOG_ZEROPAD	1
+#define BINLOG_SIGN	2
+#define BINLOG_PLUS	4
+#define BINLOG_SPACE	8
+#define BINLOG_LEFT	16
+#define BINLOG_SPECIAL	32
+#define BINLOG_LARGE	64
+
+/* Same output as number() in src/console/vtxprintf.c. */
+static void binlog_number(u64 num, int base, int size, int precision,
+			  int type)
+{
+	const char *digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+	char c, sign, tmp[66];
+	int i;
+
+	if (type & BINLOG_LARGE)
+		digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	if (type & BINLOG_LEFT)
+		type &= ~BINLOG_ZEROPAD;
+	c = (type & BINLOG_ZEROPAD) ? '0' : ' ';
+	sign = 0;
+	if (type & BINLOG_SIGN) {
+		if ((int64_t)num < 0) {
+			sign = '-';
+			num = -num;
+			size--;
+		} else if (type & BINLOG_PLUS) {
+			sign = '+';
+			size--;
+		} else if (type & BINLOG_SPACE) {
+			sign = ' ';
+			size--;
+		}
+	}
+	if (type & BINLOG_SPECIAL) {
+		if (base == 16)
+			size -= 2;
+		else if (base == 8)
+			size--;
+	}
+	i = 0;
+	if (num == 0)
+		tmp[i++] = '0';
+	else while (num != 0) {
+		tmp[i++] = digits[num % base];
+		num /= base;
+	}
+	if (i > precision)
+		precision = i;
+	size -= precision;
+	if (!(type & (BINLOG_ZEROPAD | BINLOG_LEFT)))
+		while (size-- > 0)
+			putchar(' ');
+	if (sign)
+		putchar(sign);
+	if (type & BINLOG_SPECIAL) {
+		if (base == 8) {
+			putchar('0');
+		} else if (base == 16) {
+			putchar('0');
+			putchar(digits[33]);
+		}
+	}
+	if (!(type & BINLOG_LEFT))
+		while (size-- > 0)
+			putchar(c);
+	while (i < precision--)
+		putchar('0');
+	while (i-- > 0)
+		putchar(tmp[i]);
+	while (size-- > 0)
+		putchar(' ');
+}
+
+/* Formats one record the way vtxprintf() would have. */
+static void binlog_format(const char *fmt, struct binlog_args *a,
+			  int long_size)
+{
+	int flags, field_width, precision, qualifier, base, len;
+	const char *s;
+	u32 v;
+	u64 num;
+
+	for (; *fmt; ++fmt) {
+		if (*fmt != '%') {
+			putchar(*fmt);
+			continue;
+		}
+
+		flags = 0;
+repeat:
+		++fmt;
+		switch (*fmt) {
+		case '-': flags |= BINLOG_LEFT; goto repeat;
+		case '+': flags |= BINLOG_PLUS; goto repeat;
+		case ' ': flags |= BINLOG_SPACE; goto repeat;
+		case '#': flags |= BINLOG_SPECIAL; goto repeat;
+		case '0': flags |= BINLOG_ZEROPAD; goto repeat;
+		}
+
+		field_width = -1;
+		if (isdigit(*fmt)) {
+			field_width = strtol(fmt, (char **)&fmt, 10);
+		} else if (*fmt == '*') {
+			++fmt;
+			v = 0;
+			binlog_get_int(a, &v);
+			field_width = (int)v;
+			if (field_width < 0) {
+				field_width = -field_width;
+				flags |= BINLOG_LEFT;
+			}
+		}
+
+		precision = -1;
+		if (*fmt == '.') {
+			++fmt;
+			if (isdigit(*fmt)) {
+				precision = strtol(fmt, (char **)&fmt, 10);
+			} else if (*fmt == '*') {
+				++fmt;
+				v = 0;
+				binlog_get_int(a, &v);
+				precision = (int)v;
+			}
+			if (precision < 0)
+				precision = 0;
+		}
+
+		qualifier = -1;
+		if (*fmt == 'h' || *fmt == 'l' || *fmt == 'L' || *fmt == 'z') {
+			qualifier = *fmt;
+			++fmt;
+			if (*fmt == 'l') {
+				qualifier = 'L';
+				++fmt;
+			}
+			if (*fmt == 'h') {
+				qualifier = 'H';
+				++fmt;
+			}
+		}
+
+		base = 10;
+
+		switch (*fmt) {
+		case 'c':
+			if (binlog_get_int(a, &v)) {
+				printf("<?>");
+				continue;
+			}
+			if (!(flags & BINLOG_LEFT))
+				while (--field_width > 0)
+					putchar(' ');
+			putchar((unsigned char)v);
+			while (--field_width > 0)
+				putchar(' ');
+			continue;
+
+		case 's':
+			s = binlog_get_string(a);
+			if (!s) {
+				printf("<?>");
+				continue;
+			}
+			len = strnlen(s, (size_t)precision);
+			if (!(flags & BINLOG_LEFT))
+				while (len < field_width--)
+					putchar(' ');
+			fwrite(s, 1, len, stdout);
+			while (len < field_width--)
+				putchar(' ');
+			continue;
+
+		case 'p':
+			if (binlog_get_num(a, long_size, &num)) {
+				printf("<?>");
+				continue;
+			}
+			if (field_width == -1) {
+				field_width = 2 * long_size;
+				flags |= BINLOG_ZEROPAD;
+			}
+			binlog_number(num, 16, field_width, precision, flags);
+			continue;
+
+		case 'n':
+			continue;
+
+		case '%':
+			putchar('%');
+			continue;
+
+		case 'o':
+			base = 8;
+			break;
+
+		case 'X':
+			flags |= BINLOG_LARGE;
+		case 'x':
+			base = 16;
+			break;
+
+		case 'd':
+		case 'i':
+			flags |= BINLOG_SIGN;
+		case 'u':
+			break;
+
+		default:
+			putchar('%');
+			if (*fmt)
+				putchar(*fmt);
+			else
+				--fmt;
+			continue;
+		}
+
+		if (qualifier == 'L') {
+			len = sizeof(u64);
+		} else if (qualifier == 'l' || qualifier == 'z') {
+			len = long_size;
+		} else {
+			len = sizeof(u32);
+		}
+		if (binlog_get_num(a, len, &num)) {
+			printf("<?>");
+			continue;
+		}
+
+		if (qualifier == 'h') {
+			num = (unsigned short)num;
+			if (flags & BINLOG_SIGN)
+				num = (short)num;
+		} else if (qualifier == 'H') {
+			num = (unsigned char)num;
+			if (flags & BINLOG_SIGN)
+				num = (signed char)num;
+		} else if (qualifier == -1 && (flags & BINLOG_SIGN)) {
+			num = (int32_t)num;
+		}
+		binlog_number(num, base, field_width, precision, flags);
+	}
+}
+
+static void dump_binlog(void)
+{
+	uint64_t start;
+	size_t size;
+	struct binlog_header *log;
+	const u8 *ring;
+	const char *strings;
+	u8 *buf;
+	u32 pos;
+	u16 rec_size;
+
+	if (find_cbmem_entry(CBMEM_ID_BINLOG, &start, &size) ||
+	    size < sizeof(*log)) {
+		fprintf(stderr, "No binary log found\n");
+		return;
+	}
+
+	buf = malloc(size + UINT16_MAX);
+	if (!buf) {
+		fprintf(stderr, "Could not allocate memory for binary log\n");
+		exit(1);
+	}
+	aligned_memcpy(buf, map_memory_size(start, size, 1), size);
+	unmap_memory();
+
+	log = (struct binlog_header *)buf;
+	if (log->magic != BINLOG_MAGIC ||
+	    (log->long_size != 4 && log->long_size != 8) ||
+	    log->strings_offset > size ||
+	    log->strings_used > log->strings_size ||
+	    log->strings_size > size - log->strings_offset ||
+	    log->ring_offset > size ||
+	    log->ring_size > size - log->ring_offset ||
+	    log->used > log->ring_size ||
+	    (log->ring_size && log->head >= log->ring_size)) {
+		fprintf(stderr, "Binary log is corrupted\n");
+		free(buf);
+		return;
+	}
+
+	strings = (const char *)buf + log->strings_offset;
+	ring = buf + log->ring_offset;
+
+	if (log->dropped)
+		printf("*** %u older messages dropped ***\n", log->dropped);
+
+	/* Records are linearised into the space past the end of the copy. */
+	for (pos = 0; pos + sizeof(struct binlog_record) <= log->used;
+	     pos += rec_size) {
+		u8 *rec_buf = buf + size;
+		struct binlog_record *rec = (struct binlog_record *)rec_buf;
+		struct binlog_args args;
+		const char *fmt;
+		u32 i, offset = (log->head + pos) % log->ring_size;
+
+		rec_buf[0] = ring[offset];
+		rec_buf[1] = ring[(offset + 1) % log->ring_size];
+		rec_size = rec->size;
+		if (rec_size < sizeof(*rec) || rec_size > log->used - pos) {
+			fprintf(stderr, "Binary log is corrupted\n");
+			break;
+		}
+		for (i = 0; i < rec_size; i++)
+			rec_buf[i] = ring[(offset + i) % log->ring_size];
+
+		args.pos = rec_buf + sizeof(*rec);
+		args.end = rec_buf + rec_size;
+		args.missing = 0;
+
+		if (rec->flags & BINLOG_RECORD_INLINE) {
+			fmt = binlog_get_string(&args);
+		} else if (rec->fmt < log->strings_used &&
+			   memchr(strings + rec->fmt, '\0',
+				  log->strings_used - rec->fmt)) {
+			fmt = strings + rec->fmt;
+		} else {
+			fmt = NULL;
+		}
+
+		if (!fmt) {
+			printf("<bad format string>\n");
+			continue;
+		}
+
+		binlog_format(fmt, &args, log->long_size);
+		if (rec->flags & BINLOG_RECORD_TRUNCATED)
+			printf("<truncated>\n");
+	}
+
+	free(buf);
+}
+
+static const char *device_timing_op_name(uint32_t op)
+{
+	switch (op) {
+	case DEVICE_TIMING_READ_RESOURCES:
+		return "read_resources";
+	case DEVICE_TIMING_SET_RESOURCES:
+		return "set_resources";
+	case DEVICE_TIMING_ENABLE_RESOURCES:
+		return "enable_resources";
+	case DEVICE_TIMING_INIT:
+		return "init";
+	case DEVICE_TIMING_FINAL:
+		return "final";
+	default:
+		return "<unknown>";
+	}
+}
+
+static int device_timing_compare(const void *a, const void *b)
+{
+	const struct device_timing_entry *ea = a, *eb = b;
+
+	if (ea->usecs != eb->usecs)
+		return ea->usecs < eb->usecs ? 1 : -1;
+	return 0;
+}
+
+static void dump_device_timing(unsigned int top)
+{
+	struct device_timing_table *table;
+	uint64_t start, total = 0;
+	size_t size;
+	uint32_t i, num_entries;
+
+	if (find_cbmem_entry(CBMEM_ID_DEVICE_TIMING, &start, &size) ||
+	    size < sizeof(*table)) {
+		fprintf(stderr, "No device timing table found\n");
+		return;
+	}
+
+	table = malloc(size);
+	if (!table) {
+		fprintf(stderr, "Could not allocate memory for device timing\n");
+		exit(1);
+	}
+	aligned_memcpy(table, map_memory_size(start, size, 1), size);
+	unmap_memory();
 
-		lbr = (void *)(table + offset);
-		offset += lbr->size;
+	num_entries = table->num_entries;
+	if (num_entries > (size - sizeof(*table)) / sizeof(table->entries[0]))
+		num_entries = (size - sizeof(*table)) /
+			sizeof(table->entries[0]);
 
-		if (lbr->tag != LB_TAG_CBMEM_ENTRY)
-			continue;
+	for (i = 0; i < num_entries; i++) {
+		table->entries[i].path[DEVICE_TIMING_PATH_LEN - 1] = '\0';
+		total += table->entries[i].usecs;
+	}
 
-		lbe = (void *)lbr;
-		if (lbe->id == id) {
-			debug("found id for raw dump %0x", lbe->id);
-			base = lbe->address;
-			size = lbe->entry_size;
-			break;
-		}
+	qsort(table->entries, num_entries, sizeof(table->entries[0]),
+	      device_timing_compare);
+
+	if (top > num_entries)
+		top = num_entries;
+
+	printf("%u slowest of %u device callbacks, %u not recorded:\n\n",
+	       top, num_entries, table->dropped);
+	printf("%12s  %-16s %s\n", "usecs", "callback", "device");
+	for (i = 0; i < top; i++) {
+		const struct device_timing_entry *e = &table->entries[i];
+
+		printf("%12u  %-16s %s\n", e->usecs,
+		       device_timing_op_name(e->op), e->path);
 	}
 
-	unmap_lbtable();
+	printf("\nTotal time in device callbacks: ");
+	print_norm(total);
+	printf(" usecs\n");
 
-	if (!base)
-		fprintf(stderr, "id %0x not found in cbtable\n", id);
-	else
-		rawdump(base, size);
+	free(table);
 }
 
-struct cbmem_id_to_name {
-	uint32_t id;
+struct profile_symbol {
+	uint64_t start;
+	uint64_t size;
 	const char *name;
+	uint32_t count;
 };
-static const struct cbmem_id_to_name cbmem_ids[] = { CBMEM_ID_TO_NAME_TABLE };
 
-void cbmem_print_entry(int n, uint32_t id, uint64_t base, uint64_t size)
+static int profile_symbol_compare(const void *a, const void *b)
+{
+	const struct profile_symbol *sa = a, *sb = b;
+
+	if (sa->start != sb->start)
+		return sa->start < sb->start ? -1 : 1;
+	return 0;
+}
+
+static int profile_count_compare(const void *a, const void *b)
 {
+	const struct profile_symbol *sa = a, *sb = b;
+
+	if (sa->count != sb->count)
+		return sa->count < sb->count ? 1 : -1;
+	return 0;
+}
+
+/* Section header i of an ELF32 or ELF64 file, widened to ELF64. */
+static int profile_elf_shdr(const char *elf, size_t elf_size, int i,
+			    Elf64_Shdr *shdr)
+{
+	if (elf[EI_CLASS] == ELFCLASS64) {
+		const Elf64_Ehdr *ehdr = (const void *)elf;
+
+		if (i >= ehdr->e_shnum || ehdr->e_shoff +
+		    (uint64_t)(i + 1) * sizeof(*shdr) > elf_size)
+			return -1;
+		memcpy(shdr, elf + ehdr->e_shoff + i * sizeof(*shdr),
+		       sizeof(*shdr));
+	} else {
+		const Elf32_Ehdr *ehdr = (const void *)elf;
+		Elf32_Shdr s;
+
+		if (i >= ehdr->e_shnum || ehdr->e_shoff +
+		    (uint64_t)(i + 1) * sizeof(s) > elf_size)
+			return -1;
+		memcpy(&s, elf + ehdr->e_shoff + i * sizeof(s), sizeof(s));
+		shdr->sh_type = s.sh_type;
+		shdr->sh_link = s.sh_link;
+		shdr->sh_offset = s.sh_offset;
+		shdr->sh_size = s.sh_size;
+		shdr->sh_entsize = s.sh_entsize;
+	}
+
+	if (shdr->sh_type != SHT_NOBITS && (shdr->sh_offset > elf_size ||
+	    shdr->sh_size > elf_size - shdr->sh_offset))
+		return -1;
+	return 0;
+}
+
+/* Symbol j of a symbol table section, widened to ELF64. */
+static void profile_elf_sym(const char *elf, const Elf64_Shdr *symtab,
+			    size_t j, Elf64_Sym *sym)
+{
+	if (elf[EI_CLASS] == ELFCLASS64) {
+		memcpy(sym, elf + symtab->sh_offset + j * sizeof(*sym),
+		       sizeof(*sym));
+	} else {
+		Elf32_Sym s;
+
+		memcpy(&s, elf + symtab->sh_offset + j * sizeof(s), sizeof(s));
+		sym->st_name = s.st_name;
+		sym->st_info = s.st_info;
+		sym->st_value = s.st_value;
+		sym->st_size = s.st_size;
+	}
+}
+
+/* Returns the name of function symbol j, or NULL if it isn't one. */
+static const char *profile_elf_func(const char *elf, const Elf64_Shdr *symtab,
+				    const Elf64_Shdr *strtab, size_t j,
+				    Elf64_Sym *sym)
+{
+	profile_elf_sym(elf, symtab, j, sym);
+	if (sym->st_name >= strtab->sh_size)
+		return NULL;
+	return elf + strtab->sh_offset + sym->st_name;
+}
+
+/*
+ * Read the function symbols of an ELF file, sorted by address. *program is
+ * set to the link address of _program. The names are stored behind the
+ * symbols, so freeing the returned array frees everything.
+ */
+static struct profile_symbol *profile_read_symbols(const char *file,
+						   size_t *num,
+						   uint64_t *program)
+{
+	struct profile_symbol *syms;
+	Elf64_Shdr symtab, strtab;
+	struct stat st;
+	char *elf, *names;
+	size_t elf_size, sym_size, j, n, num_funcs, names_size;
+	FILE *f;
 	int i;
-	const char *name;
 
-	name = NULL;
-	for (i = 0; i < ARRAY_SIZE(cbmem_ids); i++) {
-		if (cbmem_ids[i].id == id) {
-			name = cbmem_ids[i].name;
+	*num = 0;
+	*program = 0;
+
+	f = fopen(file, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		fprintf(stderr, "Failed to open %s: %s\n", file,
+			strerror(errno));
+		exit(1);
+	}
+	elf_size = st.st_size;
+	elf = malloc(elf_size);
+	if (!elf || fread(elf, 1, elf_size, f) != elf_size) {
+		fprintf(stderr, "Failed to read %s\n", file);
+		exit(1);
+	}
+	fclose(f);
+
+	if (elf_size < sizeof(Elf64_Ehdr) || memcmp(elf, ELFMAG, SELFMAG) ||
+	    (elf[EI_CLASS] != ELFCLASS32 && elf[EI_CLASS] != ELFCLASS64)) {
+		fprintf(stderr, "%s: not an ELF file\n", file);
+		exit(1);
+	}
+	sym_size = elf[EI_CLASS] == ELFCLASS64 ? sizeof(Elf64_Sym) :
+		sizeof(Elf32_Sym);
+
+	for (i = 0; !profile_elf_shdr(elf, elf_size, i, &symtab); i++) {
+		if (symtab.sh_type == SHT_SYMTAB)
 			break;
-		}
+	}
+	if (symtab.sh_type != SHT_SYMTAB ||
+	    profile_elf_shdr(elf, elf_size, symtab.sh_link, &strtab)) {
+		fprintf(stderr, "%s: no symbol table\n", file);
+		exit(1);
 	}
 
-	printf("%2d. ", n);
-	if (name == NULL)
-		printf("%08x ", id);
-	else
-		printf("%s\t%08x", name, id);
-	printf("  %08" PRIx64 " ", base);
-	printf("  %08" PRIx64 "\n", size);
+	n = symtab.sh_size / sym_size;
+	num_funcs = 0;
+	names_size = 0;
+	for (j = 0; j < n; j++) {
+		const char *name;
+		Elf64_Sym sym;
+
+		name = profile_elf_func(elf, &symtab, &strtab, j, &sym);
+		if (!name)
+			continue;
+		if (!strcmp(name, "_program"))
+			*program = sym.st_value;
+		if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || !sym.st_size)
+			continue;
+		num_funcs++;
+		names_size += strlen(name) + 1;
+	}
+
+	syms = malloc(num_funcs * sizeof(*syms) + names_size);
+	if (!syms) {
+		fprintf(stderr, "Could not allocate memory for symbols\n");
+		exit(1);
+	}
+	names = (char *)&syms[num_funcs];
+
+	for (j = 0; j < n; j++) {
+		const char *name;
+		Elf64_Sym sym;
+
+		name = profile_elf_func(elf, &symtab, &strtab, j, &sym);
+		if (!name || ELF64_ST_TYPE(sym.st_info) != STT_FUNC ||
+		    !sym.st_size)
+			continue;
+		syms[*num].start = sym.st_value;
+		syms[*num].size = sym.st_size;
+		syms[*num].name = names;
+		syms[*num].count = 0;
+		names = stpcpy(names, name) + 1;
+		(*num)++;
+	}
+	free(elf);
+
+	qsort(syms, *num, sizeof(*syms), profile_symbol_compare);
+	return syms;
 }
 
-static void dump_cbmem_toc(void)
+static struct profile_symbol *profile_lookup(struct profile_symbol *syms,
+					     size_t num, uint64_t pc)
 {
-	int i;
-	uint8_t *table;
-	size_t offset;
+	size_t lo = 0, hi = num;
 
-	table = map_lbtable();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
 
-	if (table == NULL)
+		if (syms[mid].start <= pc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0 || pc - syms[lo - 1].start >= syms[lo - 1].size)
+		return NULL;
+	return &syms[lo - 1];
+}
+
+/*
+ * Print the samples of the ramstage profiler. With the matching ramstage.debug
+ * the samples are attributed to functions, otherwise the raw addresses are
+ * listed.
+ */
+static void dump_lapic_profile(const char *elf_file)
+{
+	struct lapic_profile_table *table;
+	struct profile_symbol *syms, unknown = { .name = "<unknown>" };
+	uint64_t start, program = 0;
+	size_t size, num_syms = 0, num_rows = 0;
+	uint32_t i, num_buckets, counted = 0;
+
+	if (find_cbmem_entry(CBMEM_ID_LAPIC_PROFILE, &start, &size) ||
+	    size < sizeof(*table)) {
+		fprintf(stderr, "No LAPIC profile found\n");
 		return;
+	}
 
-	printf("CBMEM table of contents:\n");
-	printf("    NAME          ID           START      LENGTH\n");
+	table = malloc(size);
+	if (!table) {
+		fprintf(stderr, "Could not allocate memory for profile\n");
+		exit(1);
+	}
+	aligned_memcpy(table, map_memory_size(start, size, 1), size);
+	unmap_memory();
 
-	i = 0;
-	offset = 0;
+	num_buckets = table->num_buckets;
+	if (num_buckets > (size - sizeof(*table)) / sizeof(table->buckets[0]))
+		num_buckets = (size - sizeof(*table)) /
+			sizeof(table->buckets[0]);
 
-	while (offset < lbtable_size) {
-		struct lb_record *lbr;
-		struct lb_cbmem_entry *lbe;
+	if (elf_file) {
+		syms = profile_read_symbols(elf_file, &num_syms, &program);
+	} else {
+		/* One row per sampled address. */
+		syms = calloc(num_buckets, sizeof(*syms));
+		if (!syms) {
+			fprintf(stderr, "Could not allocate memory for profile\n");
+			exit(1);
+		}
+	}
 
-		lbr = (void *)(table + offset);
-		offset += lbr->size;
+	for (i = 0; i < num_buckets; i++) {
+		const struct lapic_profile_bucket *b = &table->buckets[i];
+		struct profile_symbol *sym;
 
-		if (lbr->tag != LB_TAG_CBMEM_ENTRY)
+		if (!b->count)
 			continue;
+		counted += b->count;
 
-		lbe = (void *)lbr;
-		cbmem_print_entry(i, lbe->id, lbe->address, lbe->entry_size);
-		i++;
+		if (!elf_file) {
+			syms[num_rows].start = b->pc;
+			syms[num_rows++].count = b->count;
+			continue;
+		}
+
+		/* Translate into a link address of ramstage.debug. */
+		sym = profile_lookup(syms, num_syms,
+				     (uint64_t)b->pc - table->program_base +
+				     program);
+		if (!sym)
+			sym = &unknown;
+		sym->count += b->count;
 	}
 
-	unmap_lbtable();
+	if (elf_file)
+		num_rows = num_syms;
+	qsort(syms, num_rows, sizeof(*syms), profile_count_compare);
+
+	printf("%u samples at %u Hz, %u dropped, ramstage at 0x%08x\n\n",
+	       table->samples, table->hz, table->dropped,
+	       table->program_base);
+	printf("%10s %7s  %s\n", "samples", "%", elf_file ? "function" :
+	       "address");
+	for (i = 0; i < num_rows && syms[i].count; i++) {
+		printf("%10u %6.2f%%  ", syms[i].count,
+		       100.0 * syms[i].count / counted);
+		if (elf_file)
+			printf("%s\n", syms[i].name);
+		else
+			printf("0x%08" PRIx64 "\n", syms[i].start);
+	}
+	if (unknown.count)
+		printf("%10u %6.2f%%  %s\n", unknown.count,
+		       100.0 * unknown.count / counted, unknown.name);
+
+	free(syms);
+	free(table);
 }
 
-#define COVERAGE_MAGIC 0x584d4153
-struct file {
-	uint32_t magic;
-	uint32_t next;
-	uint32_t filename;
-	uint32_t data;
-	int offset;
-	int len;
+/*
+ * Function trace: the entry and exit records are replayed per CPU to rebuild
+ * the call tree. Every distinct call path is a node, calls of the same
+ * function from the same parent are merged.
+ */
+struct func_trace_node {
+	uint32_t func;
+	uint32_t parent;
+	uint32_t first_child;
+	uint32_t next_sibling;
+	uint32_t calls;
+	uint64_t inclusive;
+	uint64_t exclusive;
 };
 
-static int mkpath(char *path, mode_t mode)
+struct func_trace_frame {
+	uint32_t node;
+	uint64_t start;
+	uint64_t children;
+};
+
+/* Per function totals, recursive calls only count once for inclusive. */
+struct func_trace_total {
+	uint32_t func;
+	uint32_t used;
+	uint32_t calls;
+	uint64_t inclusive;
+	uint64_t exclusive;
+};
+
+#define FUNC_TRACE_MAX_CPUS	256
+#define FUNC_TRACE_MAX_DEPTH	256
+#define FUNC_TRACE_TREE_MIN_PERCENT	1
+
+static struct func_trace_node *ft_nodes;
+static uint32_t ft_num_nodes;
+static struct func_trace_total *ft_totals;
+static uint32_t ft_totals_size;
+static struct profile_symbol *ft_syms;
+static size_t ft_num_syms;
+static uint64_t ft_program;
+
+static const char *func_trace_name(uint32_t func)
 {
-	assert (path && *path);
-	char *p;
-	for (p = strchr(path+1, '/'); p; p = strchr(p + 1, '/')) {
-		*p = '\0';
-		if (mkdir(path, mode) == -1) {
-			if (errno != EEXIST) {
-				*p = '/';
-				return -1;
-			}
-		}
-		*p = '/';
+	static char buf[32];
+	struct profile_symbol *sym = NULL;
+
+	if (ft_syms)
+		sym = profile_lookup(ft_syms, ft_num_syms,
+				     ft_program + (int32_t)func);
+	if (sym)
+		return sym->name;
+	snprintf(buf, sizeof(buf), "_program+0x%x", func);
+	return buf;
+}
+
+static uint32_t func_trace_child(uint32_t parent, uint32_t func)
+{
+	struct func_trace_node *n;
+	uint32_t i;
+
+	for (i = ft_nodes[parent].first_child; i; i = ft_nodes[i].next_sibling)
+		if (ft_nodes[i].func == func)
+			return i;
+
+	n = &ft_nodes[ft_num_nodes];
+	memset(n, 0, sizeof(*n));
+	n->func = func;
+	n->parent = parent;
+	n->next_sibling = ft_nodes[parent].first_child;
+	ft_nodes[parent].first_child = ft_num_nodes;
+	return ft_num_nodes++;
+}
+
+static struct func_trace_total *func_trace_total(uint32_t func)
+{
+	uint32_t i, mask = ft_totals_size - 1;
+
+	for (i = (func * 0x9e3779b1) & mask; ft_totals[i].used;
+	     i = (i + 1) & mask) {
+		if (ft_totals[i].func == func)
+			return &ft_totals[i];
 	}
+	ft_totals[i].func = func;
+	ft_totals[i].used = 1;
+	return &ft_totals[i];
+}
+
+static int func_trace_total_compare(const void *a, const void *b)
+{
+	const struct func_trace_total *ta = a, *tb = b;
+
+	if (ta->exclusive != tb->exclusive)
+		return ta->exclusive < tb->exclusive ? 1 : -1;
 	return 0;
 }
 
-static void dump_coverage(void)
+static void func_trace_print_tree(uint32_t node, int depth, uint64_t min)
 {
-	uint64_t start;
+	uint32_t i;
+
+	for (i = ft_nodes[node].first_child; i; i = ft_nodes[i].next_sibling) {
+		const struct func_trace_node *n = &ft_nodes[i];
+
+		if (n->inclusive < min)
+			continue;
+		printf("%12" PRIu64 " %12" PRIu64 " %8u  %*s%s\n",
+		       arch_convert_raw_ts_entry(n->inclusive),
+		       arch_convert_raw_ts_entry(n->exclusive), n->calls,
+		       2 * depth, "", func_trace_name(n->func));
+		func_trace_print_tree(i, depth + 1, min);
+	}
+}
+
+static void dump_func_trace(const char *elf_file)
+{
+	static struct func_trace_frame stacks[FUNC_TRACE_MAX_CPUS]
+					     [FUNC_TRACE_MAX_DEPTH];
+	static uint32_t depth[FUNC_TRACE_MAX_CPUS];
+	struct func_trace_buffer *buf;
+	uint64_t start, total = 0;
 	size_t size;
-	void *coverage;
-	unsigned long phys_offset;
-#define phys_to_virt(x) ((void *)(unsigned long)(x) + phys_offset)
+	uint32_t i, n, first, max_records, lost = 0;
 
-	if (find_cbmem_entry(CBMEM_ID_COVERAGE, &start, &size)) {
-		fprintf(stderr, "No coverage information found\n");
+	if (find_cbmem_entry(CBMEM_ID_FUNC_TRACE, &start, &size) ||
+	    size < sizeof(*buf)) {
+		fprintf(stderr, "No function trace found\n");
 		return;
 	}
 
-	/* Map coverage area */
-	coverage = map_memory_size(start, size, 1);
-	phys_offset = (unsigned long)coverage - (unsigned long)start;
+	buf = malloc(size);
+	if (!buf) {
+		fprintf(stderr, "Could not allocate memory for function trace\n");
+		exit(1);
+	}
+	aligned_memcpy(buf, map_memory_size(start, size, 1), size);
+	unmap_memory();
 
-	printf("Dumping coverage data...\n");
+	max_records = buf->max_records;
+	if (max_records > (size - sizeof(*buf)) / sizeof(buf->records[0]))
+		max_records = (size - sizeof(*buf)) / sizeof(buf->records[0]);
+	if (!max_records) {
+		fprintf(stderr, "Empty function trace\n");
+		return;
+	}
+	n = buf->head < max_records ? buf->head : max_records;
+	first = buf->head - n;
+
+	if (elf_file)
+		ft_syms = profile_read_symbols(elf_file, &ft_num_syms,
+					       &ft_program);
+	timestamp_set_tick_freq(buf->tick_freq_mhz);
+
+	/* Node 0 is the root, every record creates at most one node. */
+	ft_nodes = calloc(n + 1, sizeof(*ft_nodes));
+	/* At most one function per record, keep the hash table half empty. */
+	for (ft_totals_size = 1; ft_totals_size < 2 * (n + 1);
+	     ft_totals_size <<= 1)
+		;
+	ft_totals = calloc(ft_totals_size, sizeof(*ft_totals));
+	if (!ft_nodes || !ft_totals) {
+		fprintf(stderr, "Could not allocate memory for function trace\n");
+		exit(1);
+	}
+	ft_num_nodes = 1;
 
-	struct file *file = (struct file *)coverage;
-	while (file && file->magic == COVERAGE_MAGIC) {
-		FILE *f;
-		char *filename;
+	for (i = 0; i < n; i++) {
+		const struct func_trace_record *r =
+			&buf->records[(first + i) % max_records];
+		struct func_trace_frame *stack;
+		uint32_t *d, cpu = r->cpu % FUNC_TRACE_MAX_CPUS;
 
-		debug(" -> %s\n", (char *)phys_to_virt(file->filename));
-		filename = strdup((char *)phys_to_virt(file->filename));
-		if (mkpath(filename, 0755) == -1) {
-			perror("Directory for coverage data could "
-				"not be created");
-			exit(1);
+		stack = stacks[cpu];
+		d = &depth[cpu];
+
+		if (!(r->flags & FUNC_TRACE_EXIT)) {
+			uint32_t parent = *d ? stack[*d - 1].node : 0;
+
+			if (*d == FUNC_TRACE_MAX_DEPTH) {
+				lost++;
+				continue;
+			}
+			stack[*d].node = func_trace_child(parent, r->func);
+			stack[*d].start = r->tsc;
+			stack[*d].children = 0;
+			(*d)++;
+			continue;
 		}
-		f = fopen(filename, "wb");
-		if (!f) {
-			printf("Could not open %s: %s\n",
-				filename, strerror(errno));
-			exit(1);
+
+		/* Unwind to the matching entry, the ring may have lost it. */
+		while (*d && ft_nodes[stack[*d - 1].node].func != r->func) {
+			(*d)--;
+			lost++;
 		}
-		if (fwrite((void *)phys_to_virt(file->data),
-						file->len, 1, f) != 1) {
-			printf("Could not write to %s: %s\n",
-				filename, strerror(errno));
-			exit(1);
+		if (!*d) {
+			lost++;
+			continue;
 		}
-		fclose(f);
-		free(filename);
 
-		if (file->next)
-			file = (struct file *)phys_to_virt(file->next);
-		else
-			file = NULL;
+		{
+			struct func_trace_frame *f = &stack[--(*d)];
+			struct func_trace_node *node = &ft_nodes[f->node];
+			struct func_trace_total *t = func_trace_total(r->func);
+			uint64_t incl = r->tsc - f->start;
+			uint64_t excl = incl > f->children ?
+				incl - f->children : 0;
+			uint32_t j;
+
+			node->calls++;
+			node->inclusive += incl;
+			node->exclusive += excl;
+			t->calls++;
+			t->exclusive += excl;
+			for (j = 0; j < *d; j++)
+				if (ft_nodes[stack[j].node].func == r->func)
+					break;
+			if (j == *d)
+				t->inclusive += incl;
+			if (*d)
+				stack[*d - 1].children += incl;
+			else
+				total += incl;
+		}
 	}
-	unmap_memory();
+
+	printf("%u of %u function trace records, %u unmatched\n\n", n,
+	       buf->head, lost);
+
+	printf("Call tree, paths taking at least %d%% (usecs):\n\n",
+	       FUNC_TRACE_TREE_MIN_PERCENT);
+	printf("%12s %12s %8s  %s\n", "inclusive", "exclusive", "calls",
+	       "function");
+	func_trace_print_tree(0, 0, total * FUNC_TRACE_TREE_MIN_PERCENT / 100);
+
+	qsort(ft_totals, ft_totals_size, sizeof(*ft_totals),
+	      func_trace_total_compare);
+
+	printf("\nFunctions by exclusive time (usecs):\n\n");
+	printf("%12s %12s %8s  %s\n", "inclusive", "exclusive", "calls",
+	       "function");
+	for (i = 0; i < ft_totals_size; i++) {
+		const struct func_trace_total *t = &ft_totals[i];
+
+		if (!t->calls)
+			continue;
+		printf("%12" PRIu64 " %12" PRIu64 " %8u  %s\n",
+		       arch_convert_raw_ts_entry(t->inclusive),
+		       arch_convert_raw_ts_entry(t->exclusive), t->calls,
+		       func_trace_name(t->func));
+	}
+
+	free(ft_totals);
+	free(ft_nodes);
+	free(ft_syms);
+	free(buf);
 }
 
 static void print_version(void)
@@ -963,16 +2847,25 @@ static void print_version(void)
 
 static void print_usage(const char *name, int exit_code)
 {
-	printf("usage: %s [-cCltTxVvh?]\n", name);
+	printf("usage: %s [-cCLHbdpfltTjxVvh?] [-i FILE [-a ADDR]]\n", name);
 	printf("\n"
 	     "   -c | --console:                   print cbmem console\n"
 	     "   -1 | --oneboot:                   print cbmem console for last boot only\n"
 	     "   -C | --coverage:                  dump coverage information\n"
+	     "   -L | --cbfs-lookup:               print CBFS lookup cache statistics\n"
+	     "   -H | --heap:                      print ramstage heap statistics\n"
+	     "   -b | --binlog:                    print binary printk log\n"
+	     "   -d | --device-timing[=N]:         print N (default 20) slowest device callbacks\n"
+	     "   -p | --profile[=ELF]:             print ramstage profile, symbolized with ELF\n"
+	     "   -f | --func-trace[=ELF]:          print function call tree, symbolized with ELF\n"
 	     "   -l | --list:                      print cbmem table of contents\n"
 	     "   -x | --hexdump:                   print hexdump of cbmem area\n"
 	     "   -r | --rawdump ID:                print rawdump of specific ID (in hex) of cbtable\n"
 	     "   -t | --timestamps:                print timestamp information\n"
 	     "   -T | --parseable-timestamps:      print parseable timestamps\n"
+	     "   -j | --trace-json:                print timestamps and console as Chrome trace JSON\n"
+	     "   -i | --image FILE:                read memory from a raw or ELF core image\n"
+	     "   -a | --image-base ADDR:           physical address of a raw image (default 0)\n"
 	     "   -V | --verbose:                   verbose (debugging) output\n"
 	     "   -v | --version:                   print the version\n"
 	     "   -h | --help:                      print this help\n"
@@ -1187,31 +3080,53 @@ int main(int argc, char** argv)
 	int print_defaults = 1;
 	int print_console = 0;
 	int print_coverage = 0;
+	int print_cbfs_lookup = 0;
+	int print_heap = 0;
+	int print_binlog = 0;
+	int print_device_timing = 0;
+	unsigned int device_timing_top = 20;
+	int print_profile = 0;
+	const char *profile_elf = NULL;
+	int print_func_trace = 0;
+	const char *func_trace_elf = NULL;
 	int print_list = 0;
 	int print_hexdump = 0;
 	int print_rawdump = 0;
 	int print_timestamps = 0;
 	int machine_readable_timestamps = 0;
+	int print_trace_json = 0;
 	int one_boot_only = 0;
 	unsigned int rawdump_id = 0;
 	unsigned long long start = 0;
+	const char *image = NULL;
+	u64 image_base = 0;
+	int have_image_base = 0;
 
 	int opt, option_index = 0;
 	static struct option long_options[] = {
 		{"console", 0, 0, 'c'},
 		{"oneboot", 0, 0, '1'},
 		{"coverage", 0, 0, 'C'},
+		{"cbfs-lookup", 0, 0, 'L'},
+		{"heap", 0, 0, 'H'},
+		{"binlog", 0, 0, 'b'},
+		{"device-timing", optional_argument, 0, 'd'},
+		{"profile", optional_argument, 0, 'p'},
+		{"func-trace", optional_argument, 0, 'f'},
 		{"list", 0, 0, 'l'},
 		{"timestamps", 0, 0, 't'},
 		{"parseable-timestamps", 0, 0, 'T'},
+		{"trace-json", 0, 0, 'j'},
 		{"hexdump", 0, 0, 'x'},
 		{"rawdump", required_argument, 0, 'r'},
+		{"image", required_argument, 0, 'i'},
+		{"image-base", required_argument, 0, 'a'},
 		{"verbose", 0, 0, 'V'},
 		{"version", 0, 0, 'v'},
 		{"help", 0, 0, 'h'},
 		{0, 0, 0, 0}
 	};
-	while ((opt = getopt_long(argc, argv, "c1CltTxVvh?r:",
+	while ((opt = getopt_long(argc, argv, "c1CLHbd::p::f::ltTjxVvh?r:i:a:",
 				  long_options, &option_index)) != EOF) {
 		switch (opt) {
 		case 'c':
@@ -1227,6 +3142,34 @@ int main(int argc, char** argv)
 			print_coverage = 1;
 			print_defaults = 0;
 			break;
+		case 'L':
+			print_cbfs_lookup = 1;
+			print_defaults = 0;
+			break;
+		case 'H':
+			print_heap = 1;
+			print_defaults = 0;
+			break;
+		case 'b':
+			print_binlog = 1;
+			print_defaults = 0;
+			break;
+		case 'd':
+			print_device_timing = 1;
+			if (optarg)
+				device_timing_top = strtoul(optarg, NULL, 10);
+			print_defaults = 0;
+			break;
+		case 'p':
+			print_profile = 1;
+			profile_elf = optarg;
+			print_defaults = 0;
+			break;
+		case 'f':
+			print_func_trace = 1;
+			func_trace_elf = optarg;
+			print_defaults = 0;
+			break;
 		case 'l':
 			print_list = 1;
 			print_defaults = 0;
@@ -1249,6 +3192,17 @@ int main(int argc, char** argv)
 			machine_readable_timestamps = 1;
 			print_defaults = 0;
 			break;
+		case 'j':
+			print_trace_json = 1;
+			print_defaults = 0;
+			break;
+		case 'i':
+			image = optarg;
+			break;
+		case 'a':
+			image_base = strtoull(optarg, NULL, 0);
+			have_image_base = 1;
+			break;
 		case 'V':
 			verbose = 1;
 			break;
@@ -1266,6 +3220,26 @@ int main(int argc, char** argv)
 		}
 	}
 
+	if (have_image_base && !image) {
+		fprintf(stderr, "-a requires -i\n");
+		return 1;
+	}
+
+	if (image) {
+		u64 lbtable;
+
+		if (open_image(image, image_base, have_image_base))
+			return 1;
+
+		lbtable = image_find_cbtable();
+		if (!lbtable || parse_cbtable(lbtable, MAP_BYTES, 1) != 1) {
+			fprintf(stderr, "No coreboot table found in %s\n",
+				image);
+			return 1;
+		}
+		goto parsed;
+	}
+
 	mem_fd = open("/dev/mem", O_RDONLY, 0);
 	if (mem_fd < 0) {
 		fprintf(stderr, "Failed to gain memory access: %s\n",
@@ -1337,12 +3311,31 @@ int main(int argc, char** argv)
 	}
 #endif
 
+parsed:
 	if (print_console)
 		dump_console(one_boot_only);
 
 	if (print_coverage)
 		dump_coverage();
 
+	if (print_cbfs_lookup)
+		dump_cbfs_lookup();
+
+	if (print_heap)
+		dump_heap_stats();
+
+	if (print_binlog)
+		dump_binlog();
+
+	if (print_device_timing)
+		dump_device_timing(device_timing_top);
+
+	if (print_profile)
+		dump_lapic_profile(profile_elf);
+
+	if (print_func_trace)
+		dump_func_trace(func_trace_elf);
+
 	if (print_list)
 		dump_cbmem_toc();
 
@@ -1355,6 +3348,9 @@ int main(int argc, char** argv)
 	if (print_defaults || print_timestamps)
 		dump_timestamps(machine_readable_timestamps);
 
+	if (print_trace_json)
+		dump_trace_json();
+
 	close(mem_fd);
 	return 0;
 }